@@ -0,0 +1,425 @@
+//
+//  main.cpp
+//  dlt-sort-bench
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+/* end to end benchmark of dlt-sort.
+ Runs the full pipeline (sort_dlt_files) on generated and/or given corpora
+ for each output mode, input reader and nr of threads. Each run is done in its own
+ (forked) process so that the peak RSS can be measured per run and the
+ runs don't influence each other. The results are written as json. */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+#include "dlt-sort.h"
+#include "thread_pool.h"
+#include "async_read.h"
+#include "dlt_sort_gen.h"
+
+using namespace std;
+
+typedef struct{
+    std::string name;
+    std::vector<std::string> files;
+    int64_t bytes; // sum of the file sizes
+    bool generated; // files will be removed at the end
+} Bench_Corpus;
+
+typedef struct{
+    int64_t nr_msgs;
+    int64_t bytes_written;
+    size_t nr_olcs;
+} Bench_Result; // passed from the child via a pipe
+
+typedef struct{
+    int exit_code;
+    double wall_secs;
+    double user_secs;
+    double sys_secs;
+    int64_t peak_rss_bytes;
+    Bench_Result result;
+} Bench_Run;
+
+enum Bench_Mode{
+    MODE_SINGLE=0, // single output file via ofstream
+    MODE_MMAP, // single output file via mmap (--mmap_output)
+    MODE_SPLIT // one file per lifecycle (-s)
+};
+static const char *mode_names[] = {"single", "mmap", "split"};
+
+enum Bench_Input{
+    INPUT_IFSTREAM=0, // default parsing via ifstream
+    INPUT_IO_URING // read ahead via io_uring (--io_uring)
+};
+static const char *input_names[] = {"ifstream", "io_uring"};
+
+void print_usage();
+
+void print_usage()
+{
+    cout << "usage dlt-sort-bench [options] [corpus ...]\n";
+    cout << "runs dlt-sort on generated and/or the given corpora and reports the results as json\n";
+    cout << "a corpus is a dlt file or a comma separated list of dlt files\n";
+    cout << " -o --output file write the json to file (default stdout)\n";
+    cout << " -n --sizes n1[,n2,...] generate corpora with this nr of msgs (default 100000,1000000 if no corpus is given)\n";
+    cout << " -e --ecus nr  ECUs of the generated corpora (default 4)\n";
+    cout << " -l --lifecycles nr lifecycles per ECU of the generated corpora (default 4)\n";
+    cout << " -j --jobs j1[,j2,...] nr of threads to use (default 1 and the number of cpus)\n";
+    cout << " -m --modes single,mmap,split output modes to benchmark (default all)\n";
+    cout << " -i --inputs ifstream,io_uring input readers to benchmark (default ifstream)\n";
+    cout << " -r --repeat nr runs per config. The median is reported (default 3)\n";
+    cout << " -t --tmpdir dir for the generated corpora and the output files (default /tmp)\n";
+    cout << " -h --help     show usage/help\n";
+}
+
+static bool parse_list(const char *arg, std::vector<double> &vals)
+{
+    vals.clear();
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')){
+        char *end=0;
+        double v = strtod(item.c_str(), &end);
+        if (end==item.c_str() || *end || v<1.0) return false;
+        vals.push_back(v);
+    }
+    return vals.size()>0;
+}
+
+static double median(std::vector<double> v)
+{
+    std::sort(v.begin(), v.end());
+    if (!v.size()) return 0.0;
+    if (v.size()%2) return v[v.size()/2];
+    return (v[v.size()/2-1] + v[v.size()/2])/2.0;
+}
+
+#ifndef WIN32
+static double tv_secs(const struct timeval &tv)
+{
+    return (double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0);
+}
+
+static int run_once(const Bench_Corpus &c, Bench_Mode mode, Bench_Input input, int jobs, std::string const &ofilename, Bench_Run &run)
+{
+    memset(&run.result, 0, sizeof(run.result));
+    int fds[2];
+    if (pipe(fds)!=0) return -1;
+    cout.flush(); // otherwise the child would output the buffered data again
+    cerr.flush();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid<0){
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid==0){
+        // child: run the full pipeline quietly and report the stats via the pipe
+        close(fds[0]);
+        int devnull = open("/dev/null", O_WRONLY);
+        if (devnull>=0){
+            dup2(devnull, 1);
+            close(devnull);
+        }
+        nr_jobs = jobs;
+        use_mmap_output = (mode == MODE_MMAP) ? 1 : 0;
+        use_io_uring = (input == INPUT_IO_URING) ? 1 : 0;
+        Sort_Stats stats;
+        int ret = sort_dlt_files(c.files, ofilename, mode == MODE_SPLIT, false, &stats);
+        Bench_Result result;
+        result.nr_msgs = stats.nr_msgs;
+        result.bytes_written = stats.bytes_written;
+        result.nr_olcs = stats.nr_olcs;
+        if (write(fds[1], &result, sizeof(result)) != (ssize_t)sizeof(result)) ret = -1;
+        close(fds[1]);
+        _exit(ret ? 1 : 0);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], &run.result, sizeof(run.result));
+    close(fds[0]);
+    int status=0;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    if (wait4(pid, &status, 0, &ru)!=pid) return -1;
+    run.wall_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    run.user_secs = tv_secs(ru.ru_utime);
+    run.sys_secs = tv_secs(ru.ru_stime);
+#ifdef __APPLE__
+    run.peak_rss_bytes = (int64_t)ru.ru_maxrss; // in bytes on OSX
+#else
+    run.peak_rss_bytes = (int64_t)ru.ru_maxrss * 1024; // in kbytes on Linux
+#endif
+    run.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    if (got != (ssize_t)sizeof(run.result) && !run.exit_code) run.exit_code = -1;
+
+    // remove the output:
+    if (mode == MODE_SPLIT){
+        for (size_t i=0; i<run.result.nr_olcs; ++i)
+            remove(get_ofstream_name((int)i+1, ofilename).c_str());
+    }else
+        remove(ofilename.c_str());
+    return 0;
+}
+#endif
+
+static void output_json(std::ostream &o, const Bench_Corpus &c, Bench_Mode mode, Bench_Input input, int jobs, const std::vector<Bench_Run> &runs, bool first)
+{
+    std::vector<double> wall, user, sys;
+    int64_t peak_rss=0;
+    int exit_code=0;
+    for (size_t i=0; i<runs.size(); ++i){
+        wall.push_back(runs[i].wall_secs);
+        user.push_back(runs[i].user_secs);
+        sys.push_back(runs[i].sys_secs);
+        peak_rss = std::max(peak_rss, runs[i].peak_rss_bytes);
+        if (runs[i].exit_code) exit_code = runs[i].exit_code;
+    }
+    const Bench_Result &st = runs.back().result;
+    double w = median(wall);
+    if (!first) o << ",\n";
+    o << "  {\"corpus\": \"" << c.name << "\", \"input_files\": " << c.files.size() << ", \"input_bytes\": " << c.bytes;
+    o << ", \"mode\": \"" << mode_names[mode] << "\", \"input\": \"" << input_names[input] << "\", \"jobs\": " << jobs << ", \"repeat\": " << runs.size() << ",\n";
+    o << "   \"wall_secs\": " << w << ", \"wall_secs_min\": " << *std::min_element(wall.begin(), wall.end());
+    o << ", \"user_secs\": " << median(user) << ", \"sys_secs\": " << median(sys) << ",\n";
+    o << "   \"mb_per_sec\": " << (w>0.0 ? ((double)c.bytes/1000000.0)/w : 0.0);
+    o << ", \"msgs_per_sec\": " << (w>0.0 ? (double)st.nr_msgs/w : 0.0);
+    o << ", \"peak_rss_bytes\": " << peak_rss << ", \"bytes_written\": " << st.bytes_written;
+    o << ", \"nr_msgs\": " << st.nr_msgs << ", \"nr_olcs\": " << st.nr_olcs << ", \"exit_code\": " << exit_code << "}";
+}
+
+int main(int argc, char * argv[])
+{
+#ifdef WIN32
+    cerr << "dlt-sort-bench is not supported on Windows!\n";
+    return -1;
+#else
+    std::string ofilename;
+    std::string tmpdir("/tmp");
+    std::vector<double> sizes;
+    std::vector<double> jobs;
+    std::vector<Bench_Mode> modes;
+    std::vector<Bench_Input> inputs;
+    unsigned int nr_ecus=4, nr_lcs=4;
+    int repeat=3;
+
+    int c, option_index;
+    static struct option long_options[] =
+    {
+        {"output", required_argument, 0, 'o'},
+        {"sizes", required_argument, 0, 'n'},
+        {"ecus", required_argument, 0, 'e'},
+        {"lifecycles", required_argument, 0, 'l'},
+        {"jobs", required_argument, 0, 'j'},
+        {"modes", required_argument, 0, 'm'},
+        {"inputs", required_argument, 0, 'i'},
+        {"repeat", required_argument, 0, 'r'},
+        {"tmpdir", required_argument, 0, 't'},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    while ((c = getopt_long (argc, argv, "ho:n:e:l:j:m:i:r:t:", long_options, &option_index))!= -1){
+        switch(c)
+        {
+            case 'o':
+                ofilename = optarg;
+                break;
+            case 'n':
+                if (!parse_list(optarg, sizes)){
+                    cerr << "invalid sizes <" << optarg << ">!\n";
+                    return -1;
+                }
+                break;
+            case 'e':
+                nr_ecus = (unsigned int)atoi(optarg);
+                break;
+            case 'l':
+                nr_lcs = (unsigned int)atoi(optarg);
+                break;
+            case 'j':
+                if (!parse_list(optarg, jobs)){
+                    cerr << "invalid jobs <" << optarg << ">!\n";
+                    return -1;
+                }
+                break;
+            case 'm':
+            {
+                modes.clear();
+                std::stringstream ss(optarg);
+                std::string item;
+                while (std::getline(ss, item, ',')){
+                    if (item == "single") modes.push_back(MODE_SINGLE);
+                    else if (item == "mmap") modes.push_back(MODE_MMAP);
+                    else if (item == "split") modes.push_back(MODE_SPLIT);
+                    else{
+                        cerr << "unknown mode <" << item << ">!\n";
+                        return -1;
+                    }
+                }
+                break;
+            }
+            case 'i':
+            {
+                inputs.clear();
+                std::stringstream ss(optarg);
+                std::string item;
+                while (std::getline(ss, item, ',')){
+                    if (item == "ifstream") inputs.push_back(INPUT_IFSTREAM);
+                    else if (item == "io_uring") inputs.push_back(INPUT_IO_URING);
+                    else{
+                        cerr << "unknown input <" << item << ">!\n";
+                        return -1;
+                    }
+                }
+                break;
+            }
+            case 'r':
+                repeat = atoi(optarg);
+                if (repeat<1){
+                    cerr << "invalid repeat <" << optarg << ">!\n";
+                    return -1;
+                }
+                break;
+            case 't':
+                tmpdir = optarg;
+                break;
+            case 'h':
+                print_usage();
+                return 0;
+            default:
+                print_usage();
+                return -1;
+        }
+    }
+    argc-=optind;
+    argv+=optind;
+    if (!nr_ecus || !nr_lcs){
+        cerr << "nr of ECUs and lifecycles need to be >0!\n";
+        return -1;
+    }
+
+    // defaults:
+    if (!sizes.size() && !argc){
+        sizes.push_back(100000);
+        sizes.push_back(1000000);
+    }
+    if (!jobs.size()){
+        jobs.push_back(1);
+        if (get_nr_threads(0)>1) jobs.push_back(get_nr_threads(0));
+    }
+    if (!modes.size()){
+        modes.push_back(MODE_SINGLE);
+        modes.push_back(MODE_MMAP);
+        modes.push_back(MODE_SPLIT);
+    }
+    if (!inputs.size()) inputs.push_back(INPUT_IFSTREAM);
+
+    // the corpora:
+    std::vector<Bench_Corpus> corpora;
+    for (int i=0; i<argc; ++i){
+        Bench_Corpus bc;
+        bc.name = argv[i];
+        bc.bytes = 0;
+        bc.generated = false;
+        std::stringstream ss(argv[i]);
+        std::string item;
+        while (std::getline(ss, item, ',')){
+            if (!std::ifstream(item.c_str(), ios::in|ios::binary).is_open()){
+                cerr << "can't open <" << item << "> as file for input!\n";
+                return -1;
+            }
+            bc.files.push_back(item);
+            bc.bytes += get_file_size(item);
+        }
+        corpora.push_back(bc);
+    }
+    for (size_t i=0; i<sizes.size(); ++i){
+        Gen_Options opts;
+        init_Gen_Options(opts);
+        std::stringstream name;
+        name << "gen_" << (uint64_t)sizes[i] << "_e" << nr_ecus << "_l" << nr_lcs;
+        opts.out_prefix = tmpdir + "/dlt_sort_bench_" + name.str();
+        opts.nr_ecus = nr_ecus;
+        opts.lcs_per_ecu = nr_lcs;
+        opts.msgs_per_lc = (uint64_t)sizes[i] / (nr_ecus * nr_lcs);
+        if (!opts.msgs_per_lc) opts.msgs_per_lc = 1;
+        cerr << "generating corpus " << name.str() << "...\n";
+        Gen_Truth truth;
+        if (generate_corpus(opts, truth)!=0){
+            cerr << "generating the corpus failed!\n";
+            return -1;
+        }
+        Bench_Corpus bc;
+        bc.name = name.str();
+        bc.files = truth.files;
+        bc.bytes = (int64_t)truth.bytes_written;
+        bc.generated = true;
+        corpora.push_back(bc);
+    }
+
+    // run them:
+    std::ofstream ofile;
+    if (ofilename.length()){
+        ofile.open(ofilename.c_str(), ios::out|ios::trunc);
+        if (!ofile.is_open()){
+            cerr << "can't open <" << ofilename << "> for writing!\n";
+            return -1;
+        }
+    }
+    std::ostream &o = ofilename.length() ? ofile : cout;
+    o << "{\n \"tool\": \"dlt-sort-bench\",\n \"version\": \"" << dlt_sort_version << "\",\n";
+    o << " \"hw_threads\": " << get_nr_threads(0) << ",\n \"results\": [\n";
+    int toret = 0;
+    bool first = true;
+    const std::string out_name = tmpdir + "/dlt_sort_bench_out.dlt";
+    for (size_t ci=0; ci<corpora.size(); ++ci){
+        for (size_t mi=0; mi<modes.size(); ++mi){
+            for (size_t ii=0; ii<inputs.size(); ++ii){
+                for (size_t ji=0; ji<jobs.size(); ++ji){
+                    std::vector<Bench_Run> runs;
+                    std::vector<double> wall;
+                    for (int r=0; r<repeat; ++r){
+                        Bench_Run run;
+                        if (run_once(corpora[ci], modes[mi], inputs[ii], (int)jobs[ji], out_name, run)!=0){
+                            cerr << "couldn't start benchmark run!\n";
+                            return -1;
+                        }
+                        runs.push_back(run);
+                        wall.push_back(run.wall_secs);
+                    }
+                    cerr << corpora[ci].name << " " << mode_names[modes[mi]] << " " << input_names[inputs[ii]] << " -j " << (int)jobs[ji] << ": " << median(wall) << "s\n";
+                    if (runs.back().exit_code) toret = -1;
+                    output_json(o, corpora[ci], modes[mi], inputs[ii], (int)jobs[ji], runs, first);
+                    first = false;
+                }
+            }
+        }
+    }
+    o << "\n ]\n}\n";
+
+    for (size_t ci=0; ci<corpora.size(); ++ci){
+        if (!corpora[ci].generated) continue;
+        for (size_t i=0; i<corpora[ci].files.size(); ++i) remove(corpora[ci].files[i].c_str());
+    }
+    return toret;
+#endif
+}
@@ -0,0 +1,318 @@
+//
+//  main.cpp
+//  dlt-sort-benchmarks
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+/* micro benchmarks for each stage of the sorting.
+ The msgs are generated with dlt-sort-gen and parsed once per corpus. Each
+ stage is then measured on a copy of the state of the previous stage.
+ Three sweeps (nr of msgs, nr of ECUs, nr of lifecycles) are registered so
+ that the scaling of each stage can be compared.
+ The max nr of msgs for the msgs sweep is 1e6 by default and can be set via
+ the env var DLT_SORT_BENCH_MAX_MSGS (up to 1e8). */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+#include "msg_arena.h"
+#include "dlt_sort_gen.h"
+#include "benchmark/benchmark.h"
+
+typedef struct{
+    unsigned int nr_msgs;
+    unsigned int nr_ecus;
+    unsigned int nr_lcs; // per ECU
+} Bench_Corpus;
+
+// the state after each stage for the currently loaded corpus:
+typedef struct{
+    Bench_Corpus corpus;
+    bool loaded;
+    std::string file;
+    int64_t file_size;
+    size_t nr_msgs;
+    MAP_OF_ECUS parsed; // after process_input
+    MAP_OF_ECUS detected; // after determine_lcs
+    MAP_OF_ECUS skewed; // after determine_clock_skew
+    MAP_OF_ECUS merged; // after merge_lcs
+    MAP_OF_ECUS sorted; // after sort_msgs_lcs
+    LIST_OF_OLCS olcs; // after determine_overall_lcs
+} Bench_State;
+
+static Bench_State state_cache;
+
+static void unload_corpus()
+{
+    Bench_State &s = state_cache;
+    if (!s.loaded) return;
+    s.parsed.clear();
+    s.detected.clear();
+    s.skewed.clear();
+    s.merged.clear();
+    s.sorted.clear();
+    s.olcs.clear();
+    map_ecus.clear();
+    list_olcs.clear();
+    msg_arena.release();
+    remove(s.file.c_str());
+    s.loaded = false;
+}
+
+static bool load_corpus(const Bench_Corpus &c)
+{
+    Bench_State &s = state_cache;
+    if (s.loaded && s.corpus.nr_msgs == c.nr_msgs && s.corpus.nr_ecus == c.nr_ecus && s.corpus.nr_lcs == c.nr_lcs)
+        return true;
+    unload_corpus();
+
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.out_prefix = "/tmp/dlt_sort_bench";
+    opts.nr_ecus = c.nr_ecus;
+    opts.lcs_per_ecu = c.nr_lcs;
+    opts.msgs_per_lc = c.nr_msgs / (c.nr_ecus * c.nr_lcs);
+    if (!opts.msgs_per_lc) opts.msgs_per_lc = 1;
+    Gen_Truth truth;
+    if (generate_corpus(opts, truth) || truth.files.size()!=1) return false;
+    remove((opts.out_prefix + ".truth.json").c_str());
+    s.file = truth.files[0];
+    s.file_size = truth.bytes_written;
+    s.corpus = c;
+    s.loaded = true;
+
+    std::ifstream fin(s.file.c_str(), std::ios::in|std::ios::binary);
+    if (!fin.is_open() || process_input(fin)) return false;
+    fin.close();
+
+    s.nr_msgs = 0;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it)
+        s.nr_msgs += it->second.msgs.size();
+    s.parsed = map_ecus;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) determine_lcs(it->second);
+    s.detected = map_ecus;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) determine_clock_skew(it->second);
+    s.skewed = map_ecus;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) merge_lcs(it->second);
+    s.merged = map_ecus;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) sort_msgs_lcs(it->second);
+    s.sorted = map_ecus;
+    determine_overall_lcs();
+    s.olcs.swap(list_olcs);
+    map_ecus.clear();
+    return true;
+}
+
+static void set_counters(benchmark::State &state)
+{
+    const Bench_State &s = state_cache;
+    state.SetItemsProcessed(state.iterations() * (int64_t)s.nr_msgs);
+    state.counters["ecus"] = (double)s.corpus.nr_ecus;
+    state.counters["lcs"] = (double)s.corpus.nr_lcs;
+}
+
+static void BM_process_input(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    // keep the msgs of the cached corpus out of the way:
+    MsgArena kept_arena;
+    kept_arena.take_over(msg_arena);
+    while (state.KeepRunning()){
+        std::ifstream fin(state_cache.file.c_str(), std::ios::in|std::ios::binary);
+        process_input(fin);
+        state.PauseTiming();
+        map_ecus.clear();
+        msg_arena.release();
+        state.ResumeTiming();
+    }
+    msg_arena.take_over(kept_arena);
+    set_counters(state);
+    state.SetBytesProcessed(state.iterations() * state_cache.file_size);
+}
+
+static void BM_Lifecycle_fitsin(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    // msgs (in order of arrival) of the first lifecycle of the first ECU:
+    const LIST_OF_MSGS &msgs = state_cache.detected.begin()->second.lcs.front().msgs;
+    while (state.KeepRunning()){
+        LIST_OF_MSGS::const_iterator it = msgs.begin();
+        Lifecycle lc(**it);
+        for (++it; it!=msgs.end(); ++it)
+            benchmark::DoNotOptimize(lc.fitsin(**it));
+    }
+    state.SetItemsProcessed(state.iterations() * (int64_t)msgs.size());
+}
+
+static void BM_determine_lcs(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    while (state.KeepRunning()){
+        state.PauseTiming();
+        map_ecus = state_cache.parsed;
+        state.ResumeTiming();
+        for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) determine_lcs(it->second);
+    }
+    map_ecus.clear();
+    set_counters(state);
+}
+
+static void BM_determine_clock_skew(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    while (state.KeepRunning()){
+        state.PauseTiming();
+        map_ecus = state_cache.detected;
+        state.ResumeTiming();
+        for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) determine_clock_skew(it->second);
+    }
+    map_ecus.clear();
+    set_counters(state);
+}
+
+static void BM_merge_lcs(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    while (state.KeepRunning()){
+        state.PauseTiming();
+        map_ecus = state_cache.skewed;
+        state.ResumeTiming();
+        for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) merge_lcs(it->second);
+    }
+    map_ecus.clear();
+    set_counters(state);
+}
+
+static void BM_sort_msgs_lcs(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    while (state.KeepRunning()){
+        state.PauseTiming();
+        map_ecus = state_cache.merged;
+        state.ResumeTiming();
+        for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it) sort_msgs_lcs(it->second);
+    }
+    map_ecus.clear();
+    set_counters(state);
+}
+
+static void BM_determine_overall_lcs(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+    map_ecus = state_cache.sorted;
+    while (state.KeepRunning()){
+        determine_overall_lcs();
+        state.PauseTiming();
+        list_olcs.clear();
+        state.ResumeTiming();
+    }
+    map_ecus.clear();
+    set_counters(state);
+}
+
+static uint64_t hash_msg_headers(const LIST_OF_OLCS &olcs)
+{
+    // FNV-1a over the headers the output could change:
+    uint64_t h = 14695981039346656037ULL;
+    for (LIST_OF_OLCS::const_iterator oit=olcs.begin(); oit!=olcs.end(); ++oit)
+        for (LIST_OF_LCS::const_iterator it=(*oit).lcs.begin(); it!=(*oit).lcs.end(); ++it)
+            for (LIST_OF_MSGS::const_iterator mit=(*it).msgs.begin(); mit!=(*it).msgs.end(); ++mit){
+                const unsigned char *p = (const unsigned char *)(*mit)->storageheader;
+                for (size_t i=0; i<sizeof(DltStorageHeader); ++i) h = (h ^ p[i]) * 1099511628211ULL;
+                p = (const unsigned char *)&(*mit)->headerextra;
+                for (size_t i=0; i<sizeof(DltStandardHeaderExtra); ++i) h = (h ^ p[i]) * 1099511628211ULL;
+            }
+    return h;
+}
+
+static void BM_output_to_fstream(benchmark::State &state, Bench_Corpus c)
+{
+    if (!load_corpus(c)){ state.SkipWithError("couldn't generate corpus"); return; }
+#ifdef WIN32
+    std::ofstream f("nul", std::ios::out|std::ios::binary);
+#else
+    std::ofstream f("/dev/null", std::ios::out|std::ios::binary);
+#endif
+    // each iteration needs to output the same msgs:
+    const uint64_t headers = hash_msg_headers(state_cache.olcs);
+    while (state.KeepRunning()){
+        for (LIST_OF_OLCS::iterator it=state_cache.olcs.begin(); it!=state_cache.olcs.end(); ++it)
+            (*it).output_to_fstream(f, false);
+    }
+    if (hash_msg_headers(state_cache.olcs)!=headers){
+        state.SkipWithError("output_to_fstream changed the msgs");
+        return;
+    }
+    set_counters(state);
+    state.SetBytesProcessed(state.iterations() * state_cache.file_size);
+}
+
+typedef void (*Bench_Func)(benchmark::State &, Bench_Corpus);
+typedef struct{
+    const char *name;
+    Bench_Func func;
+} Bench_Stage;
+
+static const Bench_Stage stages[] = {
+    {"process_input", BM_process_input},
+    {"Lifecycle::fitsin", BM_Lifecycle_fitsin},
+    {"determine_lcs", BM_determine_lcs},
+    {"determine_clock_skew", BM_determine_clock_skew},
+    {"merge_lcs", BM_merge_lcs},
+    {"sort_msgs_lcs", BM_sort_msgs_lcs},
+    {"determine_overall_lcs", BM_determine_overall_lcs},
+    {"OverallLC::output_to_fstream", BM_output_to_fstream}
+};
+
+static void register_corpus(const Bench_Corpus &c)
+{
+    static std::vector<Bench_Corpus> registered; // the sweeps share some corpora
+    for (size_t i=0; i<registered.size(); ++i){
+        if (registered[i].nr_msgs == c.nr_msgs && registered[i].nr_ecus == c.nr_ecus && registered[i].nr_lcs == c.nr_lcs)
+            return;
+    }
+    registered.push_back(c);
+    // all stages per corpus so that the corpus is generated and parsed only once:
+    for (size_t i=0; i<sizeof(stages)/sizeof(stages[0]); ++i){
+        char name[128];
+        snprintf(name, sizeof(name), "%s/msgs:%u/ecus:%u/lcs:%u", stages[i].name, c.nr_msgs, c.nr_ecus, c.nr_lcs);
+        benchmark::RegisterBenchmark(name, stages[i].func, c)->Unit(benchmark::kMicrosecond);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int max_msgs = 1000000;
+    const char *env = getenv("DLT_SORT_BENCH_MAX_MSGS");
+    if (env){
+        double v = atof(env);
+        if (v>=1000.0 && v<=1e8) max_msgs = (unsigned int)v;
+    }
+
+    // sweep nr of msgs:
+    for (unsigned int n=1000; n<=max_msgs; n*=10){
+        Bench_Corpus c = {n, 4, 4};
+        register_corpus(c);
+        if (n > max_msgs/10) break; // avoid overflow
+    }
+    // sweep nr of ECUs:
+    for (unsigned int e=1; e<=16; e*=2){
+        Bench_Corpus c = {100000, e, 4};
+        register_corpus(c);
+    }
+    // sweep nr of lifecycles:
+    for (unsigned int l=1; l<=256; l*=4){
+        Bench_Corpus c = {100000, 4, l};
+        register_corpus(c);
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    unload_corpus();
+    return 0;
+}
@@ -0,0 +1,468 @@
+//
+//  dlt_sort_gen.cpp
+//  dlt-sort-gen
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <queue>
+
+#include <dlt/dlt_common.h>
+
+#include "dlt_sort_gen.h"
+
+using namespace std;
+
+const int64_t usecs_per_sec = 1000000;
+const int64_t usecs_per_tmsp = 100;
+const int64_t gen_base_usec = 1390000000LL*usecs_per_sec; // logger time of the first boot (Jan 2014)
+
+void init_Gen_Options(Gen_Options &o)
+{
+    o.out_prefix = "gen";
+    o.nr_ecus = 3;
+    o.lcs_per_ecu = 2;
+    o.msgs_per_lc = 10000;
+    o.apps_per_ecu = 4;
+    o.skew_min = 1.0;
+    o.skew_max = 1.0;
+    o.interval_usecs = 1000;
+    o.reboot = REBOOT_SYNC;
+    o.off_usecs = 30LL*usecs_per_sec;
+    o.latency = LATENCY_EXP;
+    o.latency_min_usecs = 200;
+    o.latency_mean_usecs = 2000;
+    o.ctrl_ratio = 0.01;
+    o.corrupt_ratio = 0.0;
+    o.rotate_bytes = 0;
+    o.rotate_overlap = 0;
+    o.payload_min = 10;
+    o.payload_max = 80;
+    o.seed = 1;
+}
+
+/* we don't use <random> as its distributions are implementation defined.
+ The corpus for a seed needs to be the same on each platform. */
+class Gen_Random{
+public:
+    Gen_Random(uint64_t seed) : state(seed) {};
+    uint64_t next(){ // splitmix64
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    double uniform(){ return (next() >> 11) * (1.0/9007199254740992.0); } // [0,1)
+    uint64_t range(uint64_t n){ return n ? next() % n : 0; } // [0,n)
+    double exp(double mean){ return -log(1.0-uniform()) * mean; }
+private:
+    uint64_t state;
+};
+
+typedef struct{
+    int64_t arrival; // logger time = storageheader time
+    uint64_t seq; // to keep the order stable for equal arrival times
+    std::string data; // the serialized msg
+    bool corrupt_version;
+} Gen_Msg;
+
+struct Gen_Msg_Later{
+    bool operator()(const Gen_Msg &a, const Gen_Msg &b) const {
+        if (a.arrival != b.arrival) return a.arrival > b.arrival;
+        return a.seq > b.seq;
+    }
+};
+
+static const char *gen_words[] = {"state", "changed", "to", "ok", "error", "timeout", "connection",
+    "request", "response", "value", "received", "sent", "init", "done", "queue", "size"};
+
+class ECU_Gen{
+    /* generates the msgs of one ECU in logger (arrival) order.
+     Msgs are created in send order (increasing tmsp). Due to the latency they can
+     arrive out of order. As each msg has at least latency_min we know that all
+     pending msgs with arrival < next send time + latency_min are final. */
+public:
+    ECU_Gen(const Gen_Options &o, unsigned int idx, Gen_ECU_Truth &t) : nr_ctrl_msgs(0), opts(o), rnd(o.seed*1000003ULL + idx), truth(t),
+        lc(-1), nr_lc_msgs(0), rt_usecs(0), next_send(0), mcnt(0), seq(0), burst_left(0), burst_usecs(0)
+    {
+        char ecu[5];
+        const char *digits = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        ecu[0] = 'E';
+        ecu[1] = digits[(idx/(36*36))%36];
+        ecu[2] = digits[(idx/36)%36];
+        ecu[3] = digits[idx%36];
+        ecu[4] = 0;
+        truth.ecu = ecu;
+        truth.skew = o.skew_min + (o.skew_max-o.skew_min)*rnd.uniform();
+        // app weights: the first apps are a lot chattier (1/n^2)
+        double sum = 0.0;
+        for (unsigned int i=0; i<o.apps_per_ecu; ++i){
+            sum += 1.0/((i+1.0)*(i+1.0));
+            app_cdf.push_back(sum);
+        }
+        for (size_t i=0; i<app_cdf.size(); ++i) app_cdf[i] /= sum;
+        seid = 100 + idx;
+        start_lc(0);
+    }
+    bool peek(int64_t &arrival){
+        // make sure the first pending msg is final:
+        while (lc >= 0 && (pending.empty() || pending.top().arrival >= next_send + opts.latency_min_usecs))
+            generate();
+        if (pending.empty()) return false;
+        arrival = pending.top().arrival;
+        return true;
+    }
+    Gen_Msg pop(){
+        Gen_Msg m = pending.top();
+        pending.pop();
+        return m;
+    }
+    uint64_t nr_ctrl_msgs;
+private:
+    void start_lc(int64_t prev_end){
+        int64_t lc_dur = (int64_t)opts.msgs_per_lc * opts.interval_usecs;
+        int64_t boot;
+        int k = lc+1;
+        switch (opts.reboot){
+            case REBOOT_RANDOM:
+                if (k==0) boot = gen_base_usec + (int64_t)(rnd.uniform()*lc_dur);
+                else boot = prev_end + (int64_t)(opts.off_usecs*(0.5+rnd.uniform()));
+                break;
+            case REBOOT_QUICK:
+                if (k==0) boot = gen_base_usec + (int64_t)rnd.range(usecs_per_sec);
+                else boot = prev_end + usecs_per_sec/2 + (int64_t)rnd.range(usecs_per_sec);
+                break;
+            default: // REBOOT_SYNC: planned boot time for all ECUs plus up to 2s jitter
+                boot = gen_base_usec + k*(lc_dur + opts.off_usecs) + (int64_t)rnd.range(2*usecs_per_sec);
+                if (k>0 && boot < prev_end + usecs_per_sec) boot = prev_end + usecs_per_sec;
+                break;
+        }
+        lc = k;
+        Gen_LC_Truth t;
+        t.boot_usec = boot;
+        t.begin_usec = std::numeric_limits<int64_t>::max();
+        t.end_usec = boot;
+        t.nr_msgs = 0;
+        truth.lcs.push_back(t);
+        nr_lc_msgs = 0;
+        rt_usecs = 200000 + (int64_t)rnd.range(300000); // first msg after 200-500ms
+        next_send = boot + rt_usecs;
+    }
+    int64_t latency(){
+        double extra = (double)(opts.latency_mean_usecs - opts.latency_min_usecs);
+        if (extra<0.0) extra = 0.0;
+        double l = 0.0;
+        switch (opts.latency){
+            case LATENCY_UNIFORM:
+                l = rnd.uniform() * 2.0 * extra;
+                break;
+            case LATENCY_BURSTY:
+                if (!burst_left && rnd.uniform() < 0.001){
+                    burst_left = 100 + (unsigned int)rnd.range(900);
+                    burst_usecs = 20.0*extra*rnd.uniform();
+                }
+                if (burst_left){
+                    --burst_left;
+                    l = burst_usecs;
+                }
+                // fallthrough
+            default: // LATENCY_EXP
+                l += std::min(rnd.exp(extra), 50.0*extra);
+                break;
+        }
+        return opts.latency_min_usecs + (int64_t)l;
+    }
+    void add_msg(uint32_t tmsp, bool ctrl, int64_t send){
+        Gen_LC_Truth &t = truth.lcs.back();
+        Gen_Msg m;
+        m.arrival = send + latency();
+        m.seq = seq++;
+        m.corrupt_version = !ctrl && opts.corrupt_ratio>0.0 && rnd.uniform() < opts.corrupt_ratio/4;
+
+        // build payload (verbose mode, one string argument):
+        std::string text;
+        unsigned int app = 0;
+        double u = rnd.uniform();
+        while (app+1 < app_cdf.size() && u > app_cdf[app]) ++app;
+        char buf[64];
+        snprintf(buf, sizeof(buf), "msg %u app %u:", mcnt, app);
+        text = buf;
+        size_t text_len = opts.payload_min + (size_t)rnd.range(opts.payload_max - opts.payload_min + 1);
+        while (text.length() < text_len){
+            text += ' ';
+            text += gen_words[rnd.range(sizeof(gen_words)/sizeof(gen_words[0]))];
+        }
+        text.resize(text_len);
+        std::string payload;
+        uint32_t type_info = 0x00000200; // DLT_TYPE_INFO_STRG. little endian as MSBF is not set
+        uint16_t str_len = (uint16_t)(text.length()+1);
+        payload.append((const char *)&type_info, sizeof(type_info));
+        payload.append((const char *)&str_len, sizeof(str_len));
+        payload.append(text);
+        payload.push_back(0);
+
+        DltStorageHeader sh;
+        memcpy(sh.pattern, "DLT\1", 4);
+        sh.seconds = (uint32_t)(m.arrival / usecs_per_sec);
+        sh.microseconds = (int32_t)(m.arrival % usecs_per_sec);
+        memcpy(sh.ecu, truth.ecu.c_str(), 4);
+        DltStandardHeader hdr;
+        hdr.htyp = DLT_HTYP_UEH | DLT_HTYP_WEID | DLT_HTYP_WSID | DLT_HTYP_WTMS | (m.corrupt_version ? (2<<5) : (1<<5));
+        hdr.mcnt = (uint8_t)mcnt;
+        size_t len = sizeof(hdr) + DLT_SIZE_WEID + DLT_SIZE_WSID + DLT_SIZE_WTMS + sizeof(DltExtendedHeader) + payload.length();
+        hdr.len = DLT_HTOBE_16((uint16_t)len);
+        DltStandardHeaderExtra extra;
+        memcpy(extra.ecu, truth.ecu.c_str(), 4);
+        extra.seid = DLT_HTOBE_32(seid);
+        extra.tmsp = DLT_HTOBE_32(tmsp);
+        DltExtendedHeader ext;
+        if (ctrl){
+            ext.msin = (DLT_TYPE_CONTROL << DLT_MSIN_MSTP_SHIFT) | (2 << DLT_MSIN_MTIN_SHIFT); // response
+            memcpy(ext.apid, "DA1\0", 4);
+            memcpy(ext.ctid, "DC1\0", 4);
+        }else{
+            unsigned int level = 1 + (unsigned int)rnd.range(6);
+            ext.msin = DLT_MSIN_VERB | (DLT_TYPE_LOG << DLT_MSIN_MSTP_SHIFT) | (level << DLT_MSIN_MTIN_SHIFT);
+            snprintf(buf, sizeof(buf), "A%03u", app%1000);
+            memcpy(ext.apid, buf, 4);
+            snprintf(buf, sizeof(buf), "C%03u", (unsigned int)rnd.range(3));
+            memcpy(ext.ctid, buf, 4);
+        }
+        ext.noar = 1;
+        m.data.reserve(sizeof(sh)+len);
+        m.data.append((const char *)&sh, sizeof(sh));
+        m.data.append((const char *)&hdr, sizeof(hdr));
+        m.data.append((const char *)&extra, sizeof(extra));
+        m.data.append((const char *)&ext, sizeof(ext));
+        m.data.append(payload);
+        ++mcnt;
+
+        if (!ctrl && !m.corrupt_version){
+            // the ones dlt-sort uses:
+            ++t.nr_msgs;
+            int64_t begin = m.arrival - (int64_t)(tmsp*usecs_per_tmsp*truth.skew);
+            if (begin < t.begin_usec) t.begin_usec = begin;
+            if (send > t.end_usec) t.end_usec = send;
+        }
+        if (ctrl) ++nr_ctrl_msgs;
+        pending.push(m);
+    }
+    void generate(){
+        // generate the next msg of the current lifecycle
+        Gen_LC_Truth &t = truth.lcs.back();
+        uint32_t tmsp = (uint32_t)(rt_usecs / (usecs_per_tmsp*truth.skew));
+        if (tmsp==0) tmsp=1;
+        int64_t send = t.boot_usec + (int64_t)(tmsp*usecs_per_tmsp*truth.skew);
+        add_msg(tmsp, false, send);
+        if (opts.ctrl_ratio>0.0 && rnd.uniform() < opts.ctrl_ratio)
+            add_msg(0, true, send);
+        ++nr_lc_msgs;
+        rt_usecs += 1 + (int64_t)rnd.exp((double)opts.interval_usecs);
+        if (nr_lc_msgs >= opts.msgs_per_lc){
+            if ((unsigned int)(lc+1) < opts.lcs_per_ecu){
+                start_lc(t.end_usec + 2*opts.latency_mean_usecs);
+            }else{
+                lc = -1; // done
+                next_send = std::numeric_limits<int64_t>::max() - opts.latency_min_usecs;
+                return;
+            }
+        }
+        next_send = truth.lcs.back().boot_usec + rt_usecs;
+    }
+    // member vars:
+    const Gen_Options &opts;
+    Gen_Random rnd;
+    Gen_ECU_Truth &truth;
+    std::vector<double> app_cdf;
+    int lc; // current lifecycle or -1 if done
+    uint64_t nr_lc_msgs;
+    int64_t rt_usecs; // real time since boot of the next msg
+    int64_t next_send; // logger time of the next msg to generate
+    uint32_t mcnt;
+    uint32_t seid;
+    uint64_t seq;
+    unsigned int burst_left;
+    double burst_usecs;
+    std::priority_queue<Gen_Msg, std::vector<Gen_Msg>, Gen_Msg_Later> pending;
+};
+
+static std::string get_file_name(const Gen_Options &opts, int nr)
+{
+    if (!opts.rotate_bytes) return opts.out_prefix + ".dlt";
+    char buf[20];
+    snprintf(buf, sizeof(buf), "_%03d.dlt", nr);
+    return opts.out_prefix + buf;
+}
+
+static bool open_file(const Gen_Options &opts, Gen_Truth &truth, std::ofstream &f)
+{
+    std::string name = get_file_name(opts, (int)truth.files.size());
+    f.open(name.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
+    if (!f.is_open()){
+        cerr << "can't open <" << name << "> for writing!\n";
+        return false;
+    }
+    truth.files.push_back(name);
+    return true;
+}
+
+int generate_corpus(const Gen_Options &opts, Gen_Truth &truth)
+{
+    if (opts.nr_ecus==0 || opts.lcs_per_ecu==0 || opts.msgs_per_lc==0 || opts.apps_per_ecu==0) return -1;
+    if (opts.skew_min<0.5 || opts.skew_max>1.5 || opts.skew_min>opts.skew_max) return -1;
+    if (opts.payload_min>opts.payload_max || opts.latency_min_usecs<0) return -1;
+
+    truth.files.clear();
+    truth.bytes_written = 0;
+    truth.nr_msgs = 0;
+    truth.nr_ctrl_msgs = 0;
+    truth.nr_garbage = 0;
+    truth.nr_corrupt_msgs = 0;
+    truth.nr_duplicates = 0;
+    truth.nr_overall_lcs = 0;
+    truth.ecus.clear();
+    truth.ecus.resize(opts.nr_ecus);
+
+    std::vector<ECU_Gen *> ecus;
+    for (unsigned int i=0; i<opts.nr_ecus; ++i){
+        ecus.push_back(new ECU_Gen(opts, i, truth.ecus[i]));
+    }
+    Gen_Random rnd(opts.seed ^ 0x5A5A5A5AULL);
+
+    std::vector<char> fbuf(1<<20);
+    std::ofstream f;
+    f.rdbuf()->pubsetbuf(&fbuf[0], fbuf.size());
+    if (!open_file(opts, truth, f)) return -2;
+    uint64_t file_bytes = 0;
+    std::deque<std::string> last_msgs; // for rotate_overlap
+
+    // merge the msgs of all ECUs by arrival time:
+    for(;;){
+        int64_t min_arrival=0;
+        ECU_Gen *min_ecu = NULL;
+        for (size_t i=0; i<ecus.size(); ++i){
+            int64_t arrival;
+            if (ecus[i]->peek(arrival) && (!min_ecu || arrival < min_arrival)){
+                min_arrival = arrival;
+                min_ecu = ecus[i];
+            }
+        }
+        if (!min_ecu) break;
+        Gen_Msg m = min_ecu->pop();
+
+        if (opts.rotate_bytes && file_bytes >= opts.rotate_bytes){
+            f.close();
+            if (!open_file(opts, truth, f)) return -2;
+            file_bytes = 0;
+            // rotated files might repeat the last msgs:
+            for (std::deque<std::string>::const_iterator it=last_msgs.begin(); it!=last_msgs.end(); ++it){
+                f.write(it->data(), it->length());
+                file_bytes += it->length();
+                truth.bytes_written += it->length();
+                ++truth.nr_msgs;
+                ++truth.nr_duplicates;
+            }
+        }
+        if (opts.corrupt_ratio>0.0 && rnd.uniform() < opts.corrupt_ratio*3/4){
+            // some garbage before the msg. we avoid 'D' so that no pattern gets created accidentally
+            size_t len = 1 + (size_t)rnd.range(64);
+            for (size_t i=0; i<len; ++i){
+                char c = (char)rnd.range(256);
+                if (c=='D') c='d';
+                f.put(c);
+            }
+            file_bytes += len;
+            truth.bytes_written += len;
+            ++truth.nr_garbage;
+        }
+        f.write(m.data.data(), m.data.length());
+        file_bytes += m.data.length();
+        truth.bytes_written += m.data.length();
+        ++truth.nr_msgs;
+        if (m.corrupt_version) ++truth.nr_corrupt_msgs;
+        if (opts.rotate_overlap){
+            last_msgs.push_back(m.data);
+            if (last_msgs.size() > opts.rotate_overlap) last_msgs.pop_front();
+        }
+    }
+    f.close();
+
+    for (size_t i=0; i<ecus.size(); ++i){
+        truth.nr_ctrl_msgs += ecus[i]->nr_ctrl_msgs;
+        delete ecus[i];
+    }
+
+    // overall lifecycles: union of intersecting lifecycle intervals (like determine_overall_lcs)
+    std::vector<std::pair<int64_t, int64_t> > ivs;
+    for (size_t i=0; i<truth.ecus.size(); ++i)
+        for (size_t j=0; j<truth.ecus[i].lcs.size(); ++j)
+            ivs.push_back(std::make_pair(truth.ecus[i].lcs[j].begin_usec, truth.ecus[i].lcs[j].end_usec));
+    std::sort(ivs.begin(), ivs.end());
+    int64_t cur_end = 0;
+    for (size_t i=0; i<ivs.size(); ++i){
+        if (i==0 || ivs[i].first > cur_end){
+            ++truth.nr_overall_lcs;
+            cur_end = ivs[i].second;
+        }else if (ivs[i].second > cur_end) cur_end = ivs[i].second;
+    }
+    return 0;
+}
+
+int make_corpus(const std::string &prefix, unsigned int nr_ecus, unsigned int lcs_per_ecu, uint64_t msgs_per_lc, Gen_Truth &truth, Gen_Options *opts)
+{
+    Gen_Options defaults;
+    if (!opts){
+        init_Gen_Options(defaults);
+        opts = &defaults;
+    }
+    opts->out_prefix = prefix;
+    opts->nr_ecus = nr_ecus;
+    opts->lcs_per_ecu = lcs_per_ecu;
+    opts->msgs_per_lc = msgs_per_lc;
+    return generate_corpus(*opts, truth);
+}
+
+int write_truth_json(const Gen_Options &opts, const Gen_Truth &truth, const std::string &name)
+{
+    std::ofstream f(name.c_str(), ios_base::out | ios_base::trunc);
+    if (!f.is_open()){
+        cerr << "can't open <" << name << "> for writing!\n";
+        return -1;
+    }
+    f << "{\n";
+    f << " \"seed\": " << opts.seed << ",\n";
+    f << " \"files\": [";
+    for (size_t i=0; i<truth.files.size(); ++i)
+        f << (i ? ", " : "") << "\"" << truth.files[i] << "\"";
+    f << "],\n";
+    f << " \"nr_msgs\": " << truth.nr_msgs << ",\n";
+    f << " \"nr_ctrl_msgs\": " << truth.nr_ctrl_msgs << ",\n";
+    f << " \"nr_garbage\": " << truth.nr_garbage << ",\n";
+    f << " \"nr_corrupt_msgs\": " << truth.nr_corrupt_msgs << ",\n";
+    f << " \"nr_duplicates\": " << truth.nr_duplicates << ",\n";
+    f << " \"nr_overall_lcs\": " << truth.nr_overall_lcs << ",\n";
+    f << " \"ecus\": [\n";
+    for (size_t i=0; i<truth.ecus.size(); ++i){
+        const Gen_ECU_Truth &e = truth.ecus[i];
+        f << "  {\"ecu\": \"" << e.ecu << "\", \"skew\": " << std::setprecision(9) << e.skew << ", \"lifecycles\": [\n";
+        for (size_t j=0; j<e.lcs.size(); ++j){
+            const Gen_LC_Truth &l = e.lcs[j];
+            f << "   {\"boot_usec\": " << l.boot_usec << ", \"begin_usec\": " << l.begin_usec <<
+                ", \"end_usec\": " << l.end_usec << ", \"nr_msgs\": " << l.nr_msgs << "}" << (j+1<e.lcs.size() ? "," : "") << "\n";
+        }
+        f << "  ]}" << (i+1<truth.ecus.size() ? "," : "") << "\n";
+    }
+    f << " ]\n}\n";
+    return f.good() ? 0 : -1;
+}
@@ -0,0 +1,82 @@
+//
+//  dlt_sort_gen.h
+//  dlt-sort-gen
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_gen_dlt_sort_gen_h
+#define dlt_sort_gen_dlt_sort_gen_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+enum Gen_Reboot{
+    REBOOT_SYNC=0, // all ECUs (re-)boot at about the same time (like a vehicle power cycle)
+    REBOOT_RANDOM, // each ECU (re-)boots independently
+    REBOOT_QUICK // like sync but with very short off times (hard case for the lifecycle detection)
+};
+
+enum Gen_Latency{
+    LATENCY_UNIFORM=0, // min + uniform(0, 2*(mean-min))
+    LATENCY_EXP, // min + exponential with mean-min (capped)
+    LATENCY_BURSTY // like exp but with bursts of much higher latency (e.g. logger reconnects)
+};
+
+typedef struct{
+    std::string out_prefix; // files: <prefix>.dlt (or <prefix>_000.dlt,... if rotated) and <prefix>.truth.json
+    unsigned int nr_ecus;
+    unsigned int lcs_per_ecu;
+    uint64_t msgs_per_lc; // msgs per lifecycle and ECU
+    unsigned int apps_per_ecu; // the first apps are a lot chattier than the others
+    double skew_min; // clock skew of each ECU is uniform within [skew_min, skew_max]
+    double skew_max; // (1.0 = same speed as the logger clock. see determine_clock_skew)
+    int64_t interval_usecs; // mean time between two msgs of an ECU
+    int reboot; // Gen_Reboot
+    int64_t off_usecs; // time the ECUs are off between two lifecycles
+    int latency; // Gen_Latency
+    int64_t latency_min_usecs; // min transport latency ECU -> logger
+    int64_t latency_mean_usecs;
+    double ctrl_ratio; // ratio of control msgs with tmsp=0
+    double corrupt_ratio; // ratio of msgs preceded by garbage or with a corrupt header
+    uint64_t rotate_bytes; // 0 = single file. Otherwise a new file is started after that many bytes
+    unsigned int rotate_overlap; // nr of msgs repeated at the begin of a rotated file
+    unsigned int payload_min; // size of the text of the payload
+    unsigned int payload_max;
+    uint64_t seed;
+} Gen_Options;
+
+typedef struct{
+    int64_t boot_usec; // real boot time (tmsp 0)
+    int64_t begin_usec; // begin as dlt-sort should detect it (boot + min latency)
+    int64_t end_usec; // send time of the last msg
+    uint64_t nr_msgs; // msgs with a tmsp (i.e. the ones that dlt-sort keeps)
+} Gen_LC_Truth;
+
+typedef struct{
+    std::string ecu;
+    double skew;
+    std::vector<Gen_LC_Truth> lcs;
+} Gen_ECU_Truth;
+
+typedef struct{
+    std::vector<std::string> files;
+    uint64_t bytes_written; // size of all files (incl. garbage and duplicates)
+    uint64_t nr_msgs; // all msgs written (incl. ctrl msgs, duplicates and corrupt ones)
+    uint64_t nr_ctrl_msgs;
+    uint64_t nr_garbage; // nr of garbage blocks inserted
+    uint64_t nr_corrupt_msgs; // msgs with a wrong header version
+    uint64_t nr_duplicates; // msgs repeated due to rotate_overlap
+    unsigned int nr_overall_lcs; // overall lifecycles (intersecting lcs of all ECUs)
+    std::vector<Gen_ECU_Truth> ecus;
+} Gen_Truth;
+
+void init_Gen_Options(Gen_Options &);
+int generate_corpus(const Gen_Options &opts, Gen_Truth &truth); // 0 = success
+// generate_corpus with the other options from opts (if given, e.g. rotate_bytes) or the defaults:
+int make_corpus(const std::string &prefix, unsigned int nr_ecus, unsigned int lcs_per_ecu, uint64_t msgs_per_lc, Gen_Truth &truth, Gen_Options *opts=0);
+int write_truth_json(const Gen_Options &opts, const Gen_Truth &truth, const std::string &name);
+
+#endif
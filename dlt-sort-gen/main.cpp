@@ -0,0 +1,160 @@
+//
+//  main.cpp
+//  dlt-sort-gen
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "dlt_sort_gen.h"
+
+using namespace std;
+
+void print_usage();
+
+void print_usage()
+{
+    cout << "usage dlt-sort-gen [options]\n";
+    cout << "generates a synthetic multi ECU dlt corpus and a ground truth file <prefix>.truth.json\n";
+    cout << " -o --output prefix output file prefix (default gen)\n";
+    cout << " -e --ecus nr  number of ECUs (default 3)\n";
+    cout << " -l --lifecycles nr lifecycles per ECU (default 2)\n";
+    cout << " -n --msgs nr  msgs per lifecycle and ECU (default 10000)\n";
+    cout << " -a --apps nr  apps per ECU (default 4)\n";
+    cout << " -i --interval usecs mean time between two msgs of an ECU (default 1000)\n";
+    cout << "--skew min[,max] clock skew range of the ECUs within 0.5..1.5 (default 1.0)\n";
+    cout << "--reboot sync|random|quick reboot pattern (default sync)\n";
+    cout << "--off_time secs time the ECUs are off between lifecycles (default 30)\n";
+    cout << "--latency uniform|exp|bursty,min_usecs,mean_usecs transport latency (default exp,200,2000)\n";
+    cout << "--ctrl ratio   ratio of control msgs with tmsp 0 (default 0.01)\n";
+    cout << "--corrupt ratio ratio of msgs with garbage before/corrupt header (default 0)\n";
+    cout << "--rotate kbytes start a new file after this size (default 0 = no rotation)\n";
+    cout << "--rotate_overlap nr repeat the last nr msgs at the begin of a rotated file (default 0)\n";
+    cout << "--payload min,max length of the payload text (default 10,80)\n";
+    cout << "--seed nr      seed for the random generator (default 1)\n";
+    cout << " -h --help     show usage/help\n";
+}
+
+int main(int argc, char * argv[])
+{
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    
+    int c, option_index;
+    static struct option long_options[] =
+    {
+        {"output", required_argument, 0, 'o'},
+        {"ecus", required_argument, 0, 'e'},
+        {"lifecycles", required_argument, 0, 'l'},
+        {"msgs", required_argument, 0, 'n'},
+        {"apps", required_argument, 0, 'a'},
+        {"interval", required_argument, 0, 'i'},
+        {"help", no_argument, 0, 'h'},
+        {"skew", required_argument, 0, 0},
+        {"reboot", required_argument, 0, 0},
+        {"off_time", required_argument, 0, 0},
+        {"latency", required_argument, 0, 0},
+        {"ctrl", required_argument, 0, 0},
+        {"corrupt", required_argument, 0, 0},
+        {"rotate", required_argument, 0, 0},
+        {"rotate_overlap", required_argument, 0, 0},
+        {"payload", required_argument, 0, 0},
+        {"seed", required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+    while ((c = getopt_long (argc, argv, "ho:e:l:n:a:i:", long_options, &option_index))!= -1){
+        switch(c)
+        {
+            case 0:
+            {
+                const char *name = long_options[option_index].name;
+                if (!strcmp(name, "skew")){
+                    if (sscanf(optarg, "%lf,%lf", &opts.skew_min, &opts.skew_max)==1)
+                        opts.skew_max = opts.skew_min;
+                }else if (!strcmp(name, "reboot")){
+                    if (!strcmp(optarg, "sync")) opts.reboot = REBOOT_SYNC;
+                    else if (!strcmp(optarg, "random")) opts.reboot = REBOOT_RANDOM;
+                    else if (!strcmp(optarg, "quick")) opts.reboot = REBOOT_QUICK;
+                    else{
+                        cerr << "unknown reboot pattern <" << optarg << ">!\n";
+                        return -1;
+                    }
+                }else if (!strcmp(name, "off_time")){
+                    opts.off_usecs = (int64_t)(atof(optarg)*1000000.0);
+                }else if (!strcmp(name, "latency")){
+                    char dist[20];
+                    long long l_min, l_mean;
+                    if (sscanf(optarg, "%19[a-z],%lld,%lld", dist, &l_min, &l_mean)!=3){
+                        cerr << "invalid latency <" << optarg << ">!\n";
+                        return -1;
+                    }
+                    opts.latency_min_usecs = l_min;
+                    opts.latency_mean_usecs = l_mean;
+                    if (!strcmp(dist, "uniform")) opts.latency = LATENCY_UNIFORM;
+                    else if (!strcmp(dist, "exp")) opts.latency = LATENCY_EXP;
+                    else if (!strcmp(dist, "bursty")) opts.latency = LATENCY_BURSTY;
+                    else{
+                        cerr << "unknown latency distribution <" << dist << ">!\n";
+                        return -1;
+                    }
+                }else if (!strcmp(name, "ctrl")){
+                    opts.ctrl_ratio = atof(optarg);
+                }else if (!strcmp(name, "corrupt")){
+                    opts.corrupt_ratio = atof(optarg);
+                }else if (!strcmp(name, "rotate")){
+                    opts.rotate_bytes = strtoull(optarg, 0, 10)*1024;
+                }else if (!strcmp(name, "rotate_overlap")){
+                    opts.rotate_overlap = (unsigned int)atoi(optarg);
+                }else if (!strcmp(name, "payload")){
+                    if (sscanf(optarg, "%u,%u", &opts.payload_min, &opts.payload_max)!=2){
+                        cerr << "invalid payload <" << optarg << ">!\n";
+                        return -1;
+                    }
+                }else if (!strcmp(name, "seed")){
+                    opts.seed = strtoull(optarg, 0, 10);
+                }
+                break;
+            }
+            case 'o':
+                opts.out_prefix = optarg;
+                break;
+            case 'e':
+                opts.nr_ecus = (unsigned int)atoi(optarg);
+                break;
+            case 'l':
+                opts.lcs_per_ecu = (unsigned int)atoi(optarg);
+                break;
+            case 'n':
+                opts.msgs_per_lc = strtoull(optarg, 0, 10);
+                break;
+            case 'a':
+                opts.apps_per_ecu = (unsigned int)atoi(optarg);
+                break;
+            case 'i':
+                opts.interval_usecs = atoll(optarg);
+                break;
+            case 'h':
+                print_usage();
+                return 0;
+            default:
+                print_usage();
+                return -1;
+        }
+    }
+    
+    Gen_Truth truth;
+    if (generate_corpus(opts, truth)!=0){
+        cerr << "generating the corpus failed. Invalid options?\n";
+        return -1;
+    }
+    std::string truth_name = opts.out_prefix + ".truth.json";
+    if (write_truth_json(opts, truth, truth_name)!=0) return -1;
+    cout << "generated " << truth.nr_msgs << " msgs in " << truth.files.size() << " file(s) and " << truth_name << "\n";
+    return 0;
+}
@@ -7,9 +7,43 @@
 //
 
 #include <limits>
+#include <sys/stat.h>
 #include "dlt-sort.h"
+#include "thread_pool.h"
+#include "msg_arena.h"
+#include "trace_events.h"
+#include "mem_budget.h"
+#include "pipeline.h"
+#include "async_read.h"
+#include "read_planner.h"
+#include "payload_blocks.h"
+#include "nav_index.h"
+#include "in_place.h"
+#include "fan_out.h"
+#include "dedup.h"
+#include "server.h"
+#include "shard.h"
+#include "htyp_codec.h"
+#include "dlt_sort_gen.h"
 #include "gtest/gtest.h"
 
+static std::string read_file(const char *name)
+{
+    std::ifstream f(name, std::ios::in|std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+}
+
+// make_corpus and the output of a single run as reference (sorted to <prefix>_ref.dlt):
+static int make_corpus(const std::string &prefix, unsigned int nr_ecus, unsigned int lcs_per_ecu, uint64_t msgs_per_lc, Gen_Truth &truth, std::string &ref, bool timeadjust=false, Gen_Options *opts=0, Sort_Stats *ref_stats=0)
+{
+    if (make_corpus(prefix, nr_ecus, lcs_per_ecu, msgs_per_lc, truth, opts)) return -1;
+    std::string ref_name = prefix + "_ref.dlt";
+    if (sort_dlt_files(truth.files, ref_name, false, timeadjust, ref_stats)) return -1;
+    ref = read_file(ref_name.c_str());
+    remove(ref_name.c_str());
+    return ref.size() ? 0 : -1;
+}
+
 TEST(BASIC_ASSUMPTIONS, size_of_dlt_structs) {
     ASSERT_EQ(sizeof(char), 1);
     ASSERT_EQ(sizeof(int32_t), 4);
@@ -167,6 +201,15 @@ TEST(Lifecycle_Tests, calc_min_time) {
     ASSERT_EQ(1999900, lc.calc_min_time());
 }
 
+TEST(Lifecycle_Tests, determine_end) {
+    Lifecycle lc;
+    lc.usec_begin = 10LL*usecs_per_sec;
+    lc.max_tmsp = 50000; // 5s
+    ASSERT_EQ(15LL*usecs_per_sec, lc.determine_end());
+    lc.clock_skew = 0.5;
+    ASSERT_EQ(12500000LL, lc.determine_end());
+}
+
 TEST(Lifecycle_Tests, DISABLED_expand_if_intersects) {
     // todo
     EXPECT_TRUE(false) << "not implemented yet";
@@ -192,6 +235,54 @@ TEST(Algorithm, DISABLED_process_message) {
     EXPECT_TRUE(false) << "not implemented yet";
 }
 
+TEST(Algorithm, filter_message) {
+    DltMessage m;
+    init_DltMessage(m);
+    m.standardheader->htyp = DLT_HTYP_WEID | DLT_HTYP_WTMS | DLT_HTYP_UEH;
+    memcpy(m.headerextra.ecu, "ECU1", 4);
+    memcpy(m.extendedheader->apid, "APP\0", 4);
+    memcpy(m.extendedheader->ctid, "CTX1", 4);
+    m.extendedheader->msin = (DLT_TYPE_LOG << DLT_MSIN_MSTP_SHIFT) | (DLT_LOG_DEBUG << DLT_MSIN_MTIN_SHIFT);
+    m.headerextra.tmsp = 42;
+    ASSERT_EQ(FILTER_KEEP, filter_message(m));
+    
+    // filtered ECUs are dropped completely:
+    ASSERT_TRUE(add_filter_ids(msg_filter.excl_ecus, "ECU2,ECU1"));
+    ASSERT_EQ(2, msg_filter.excl_ecus.size());
+    ASSERT_EQ(FILTER_DROP, filter_message(m));
+    msg_filter.excl_ecus.clear();
+    ASSERT_TRUE(add_filter_ids(msg_filter.incl_ecus, "ECU2"));
+    ASSERT_EQ(FILTER_DROP, filter_message(m));
+    ASSERT_TRUE(add_filter_ids(msg_filter.incl_ecus, "ECU1"));
+    ASSERT_EQ(FILTER_KEEP, filter_message(m));
+    msg_filter.incl_ecus.clear();
+    
+    // apid/ctid filtered msgs are kept as header only (if they have a tmsp):
+    ASSERT_FALSE(add_filter_ids(msg_filter.incl_apids, "TOOLONG"));
+    ASSERT_FALSE(add_filter_ids(msg_filter.incl_apids, "A,,B"));
+    msg_filter.incl_apids.clear();
+    ASSERT_TRUE(add_filter_ids(msg_filter.incl_apids, "APP"));
+    ASSERT_EQ(FILTER_KEEP, filter_message(m));
+    ASSERT_TRUE(add_filter_ids(msg_filter.excl_ctids, "CTX1"));
+    ASSERT_EQ(FILTER_HEADER_ONLY, filter_message(m));
+    m.headerextra.tmsp = 0;
+    ASSERT_EQ(FILTER_DROP, filter_message(m));
+    m.headerextra.tmsp = 42;
+    msg_filter.incl_apids.clear();
+    msg_filter.excl_ctids.clear();
+    
+    // log level:
+    msg_filter.max_log_level = DLT_LOG_INFO;
+    ASSERT_EQ(FILTER_HEADER_ONLY, filter_message(m));
+    msg_filter.max_log_level = DLT_LOG_DEBUG;
+    ASSERT_EQ(FILTER_KEEP, filter_message(m));
+    // non log msgs are not affected by the log level:
+    msg_filter.max_log_level = DLT_LOG_FATAL;
+    m.extendedheader->msin = (DLT_TYPE_CONTROL << DLT_MSIN_MSTP_SHIFT);
+    ASSERT_EQ(FILTER_KEEP, filter_message(m));
+    msg_filter.max_log_level = 0;
+}
+
 TEST(Algorithm, DISABLED_determine_lcs) {
     // todo
     EXPECT_TRUE(false) << "not implemented yet";
@@ -217,6 +308,117 @@ TEST(FileHandling_Tests, DISABLED_output_message) {
     EXPECT_TRUE(false) << "not implemented yet";
 }
 
+TEST(FileHandling_Tests, htyp_codecs) {
+    static_assert(Htyp_Layout<0>::size == 0, "no extra headers");
+    static_assert(Htyp_Layout<nr_htyp_layouts-1>::size == 4+4+4+10, "all extra headers");
+    static_assert(Htyp_Layout<0xe>::ueh_offset == 12, "ext. header after ecu, seid and tmsp");
+    for (unsigned int htyp=0; htyp<0x20; ++htyp){
+        if (htyp & DLT_HTYP_MSBF) continue; // not part of the layout
+        DltMessage m;
+        init_DltMessage(m);
+        m.standardheader->htyp = (uint8_t)(htyp | DLT_HTYP_PROTOCOL_VERSION1);
+        memcpy(m.headerextra.ecu, "ECU1", 4);
+        m.headerextra.seid = 0x01020304;
+        m.headerextra.tmsp = 50000;
+        m.extendedheader->msin = 0x41;
+        m.extendedheader->noar = 2;
+        memcpy(m.extendedheader->apid, "APP1", 4);
+        memcpy(m.extendedheader->ctid, "CTX1", 4);
+        const Htyp_Codec &codec = get_htyp_codec(m.standardheader->htyp);
+        size_t size = 0;
+        if (DLT_IS_HTYP_WEID(htyp)) size += DLT_SIZE_WEID;
+        if (DLT_IS_HTYP_WSID(htyp)) size += DLT_SIZE_WSID;
+        if (DLT_IS_HTYP_WTMS(htyp)) size += DLT_SIZE_WTMS;
+        if (DLT_IS_HTYP_UEH(htyp)) size += sizeof(DltExtendedHeader);
+        ASSERT_EQ(size, codec.size);
+        char buf[max_htyp_layout_size];
+        ASSERT_EQ(buf+size, codec.encode(m, buf));
+        ASSERT_EQ(0x01020304, m.headerextra.seid); // unchanged
+        DltMessage d;
+        init_DltMessage(d);
+        memset(&d.headerextra, 0, sizeof(d.headerextra));
+        d.headerextra.tmsp = 1;
+        codec.decode(buf, d);
+        EXPECT_EQ(DLT_IS_HTYP_WEID(htyp) ? 'E' : 0, d.headerextra.ecu[0]);
+        EXPECT_EQ(DLT_IS_HTYP_WSID(htyp) ? 0x01020304u : 0u, d.headerextra.seid);
+        EXPECT_EQ(DLT_IS_HTYP_WTMS(htyp) ? 50000u : 0u, d.headerextra.tmsp);
+        if (DLT_IS_HTYP_UEH(htyp)){
+            EXPECT_EQ(0, memcmp(d.extendedheader, m.extendedheader, sizeof(DltExtendedHeader)));
+        }
+    }
+}
+
+TEST(FileHandling_Tests, serialize_message) {
+    DltMessage m;
+    init_DltMessage(m);
+    memcpy(m.storageheader->pattern, "DLT\1", 4);
+    m.storageheader->seconds = 1000;
+    m.storageheader->microseconds = 42;
+    m.standardheader->htyp = DLT_HTYP_WEID | DLT_HTYP_WSID | DLT_HTYP_WTMS | DLT_HTYP_UEH;
+    memcpy(m.headerextra.ecu, "ECU1", 4);
+    m.headerextra.seid = 0x01020304;
+    m.headerextra.tmsp = 50000; // 5s
+    unsigned char payload[5] = {1, 2, 3, 4, 5};
+    m.databuffer = payload;
+    m.databuffersize = sizeof(payload);
+    ASSERT_EQ(16+4+4+4+4+10+5, get_message_size(m));
+    
+    Out_Msg o;
+    o.msg = &m;
+    o.usec_begin = 10LL*usecs_per_sec;
+    o.clock_skew = 1.0;
+    ASSERT_EQ(15LL*usecs_per_sec, get_adjusted_time(o));
+    
+    // serialize_message needs to produce the same bytes as output_message but not change the msg:
+    std::vector<char> buf(get_message_size(m));
+    ASSERT_EQ(buf.size(), serialize_message(o, false, &buf[0]));
+    ASSERT_EQ(0x01020304, m.headerextra.seid);
+    ASSERT_EQ(50000, m.headerextra.tmsp);
+    const char *name = "/tmp/dlt_sort_unittest_serialize.dlt";
+    std::ofstream f(name, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+    output_message(&m, f);
+    f.close();
+    std::ifstream fin(name, std::ios_base::in | std::ios_base::binary);
+    std::vector<char> written(buf.size());
+    fin.read(&written[0], written.size());
+    ASSERT_EQ(buf.size(), fin.gcount());
+    ASSERT_TRUE(buf == written);
+    remove(name);
+    
+    // with timeadjust the storageheader gets the lifecycle time:
+    m.headerextra.seid = 0x01020304;
+    m.headerextra.tmsp = 50000;
+    ASSERT_EQ(buf.size(), serialize_message(o, true, &buf[0]));
+    DltStorageHeader *sh = (DltStorageHeader *)&buf[0];
+    ASSERT_EQ(15, sh->seconds);
+    ASSERT_EQ(0, sh->microseconds);
+    ASSERT_EQ(1000, m.storageheader->seconds);
+}
+
+TEST(FileHandling_Tests, process_input_stats) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.corrupt_ratio = 0.05;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_stats", 2, 1, 2000, truth, &opts));
+    ASSERT_LT(0, truth.nr_garbage);
+    ASSERT_LT(0, truth.nr_corrupt_msgs);
+    
+    Parse_Stats stats;
+    memset(&stats, 0, sizeof(stats));
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    process_input(fin, &stats);
+    fin.close();
+    remove(truth.files[0].c_str());
+    EXPECT_EQ(truth.nr_corrupt_msgs, stats.nr_skipped);
+    EXPECT_EQ(truth.nr_msgs - truth.nr_corrupt_msgs, stats.nr_msgs);
+    EXPECT_EQ(0, stats.nr_filtered);
+    EXPECT_LE(truth.nr_garbage, stats.resync_bytes);
+    map_ecus.clear();
+    msg_arena.release();
+}
+
 TEST(FileHandling_Tests, get_ofstream_name) {
     ASSERT_STREQ("/tmp/dLt_test.dlt", get_ofstream_name(0, "/tmp/dLt_test.dlt").c_str());
     // ignore neg cnt
@@ -241,6 +443,1155 @@ TEST(FileHandling_Tests, get_ofstream_name) {
 }
 
 
+TEST(ThreadPool, parallel_for) {
+    ThreadPool pool(4);
+    ASSERT_EQ(4, pool.size());
+    std::vector<int> v(1000, 0);
+    pool.parallel_for(v.size(), [&](size_t i){ v[i] += (int)i; });
+    for (size_t i=0; i<v.size(); ++i)
+        ASSERT_EQ((int)i, v[i]);
+    // pool can be reused:
+    pool.parallel_for(v.size(), [&](size_t i){ v[i] -= (int)i; });
+    for (size_t i=0; i<v.size(); ++i)
+        ASSERT_EQ(0, v[i]);
+    pool.parallel_for(0, [&](size_t){ FAIL(); });
+    ASSERT_EQ(1, ThreadPool(1).size());
+    ASSERT_LE(1, get_nr_threads(0));
+}
+
+TEST(ThreadPool, Task_Group) {
+    // nested tasks with very different sizes:
+    ThreadPool pool(4);
+    std::vector<std::vector<int> > v(16);
+    Task_Group group(pool);
+    for (size_t i=0; i<v.size(); ++i){
+        group.run([&v, &pool, i](){
+            v[i].resize(i==3 ? 100000 : 100+i);
+            Task_Group inner(pool);
+            for (size_t j=0; j<v[i].size(); j+=1000){
+                inner.run([&v, i, j](){
+                    for (size_t k=j; k<j+1000 && k<v[i].size(); ++k) v[i][k] = (int)(i+k);
+                });
+            }
+            inner.wait();
+        });
+    }
+    group.wait();
+    for (size_t i=0; i<v.size(); ++i)
+        for (size_t k=0; k<v[i].size(); ++k)
+            ASSERT_EQ((int)(i+k), v[i][k]);
+    // with one thread the tasks run inline:
+    ThreadPool single(1);
+    Task_Group g(single);
+    int x=0;
+    g.run([&x](){ x=42; });
+    ASSERT_EQ(42, x);
+}
+
+TEST(Algorithm, sort_dlt_files_missing_input) {
+    // an error doesn't leave msgs behind for the next call:
+    Gen_Truth truth;
+    std::string ref;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_missing", 2, 1, 1000, truth, ref));
+    const char *out_name = "/tmp/dlt_sort_unittest_missing_out.dlt";
+    std::vector<std::string> ifiles(truth.files);
+    ifiles.push_back("/tmp/dlt_sort_unittest_missing_none.dlt");
+    EXPECT_EQ(-1, sort_dlt_files(ifiles, out_name, false, false));
+    EXPECT_EQ(0u, map_ecus.size());
+    EXPECT_EQ(0u, list_olcs.size());
+    EXPECT_EQ(0u, msg_arena.bytes_used());
+    ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, false));
+    EXPECT_TRUE(ref == read_file(out_name));
+    remove(out_name);
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(Algorithm, sort_dlt_files_jobs) {
+    // parallel parse, per ECU and per lc tasks need to result in the same output for any nr of threads:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 700000;
+    opts.rotate_overlap = 0;
+    Gen_Truth truth;
+    std::string ref;
+    Sort_Stats ref_stats;
+    nr_jobs = 1;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_jobs", 6, 3, 2000, truth, ref, true, &opts, &ref_stats));
+    ASSERT_LE(2, truth.files.size());
+    const char *out_name = "/tmp/dlt_sort_unittest_jobs_out.dlt";
+    for (nr_jobs=2; nr_jobs<=8; nr_jobs*=2){
+        Sort_Stats stats;
+        ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, true, &stats));
+        EXPECT_TRUE(ref == read_file(out_name));
+        EXPECT_EQ(ref_stats.parse.nr_msgs, stats.parse.nr_msgs);
+        EXPECT_EQ(ref_stats.bytes_read, stats.bytes_read);
+        EXPECT_EQ(ref_stats.nr_olcs, stats.nr_olcs);
+        // the concurrent ECU tasks of a stage are timed once:
+        double stages_wall = 0.0;
+        for (int i=0; i<NR_STAGES; ++i) stages_wall += stats.stages[i].wall_secs;
+        EXPECT_LT(0.0, stats.total.wall_secs);
+        EXPECT_GE(stats.total.wall_secs, stages_wall);
+    }
+    nr_jobs = 0;
+    remove(out_name);
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(Algorithm, determine_lcs_chunks) {
+    // the lcs detected in chunks need to be the same as the ones detected sequentially:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.reboot = REBOOT_QUICK;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_chunks", 1, 4, 3000, truth, &opts));
+    ASSERT_EQ(1, truth.files.size());
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    ASSERT_EQ(0, process_input(fin));
+    fin.close();
+    remove(truth.files[0].c_str());
+    ASSERT_EQ(1, map_ecus.size());
+    ECU_Info &seq = map_ecus.begin()->second;
+    ASSERT_EQ(0, determine_lcs(seq));
+    ThreadPool pool(4);
+    for (size_t chunk_msgs=1000; chunk_msgs<=5000; chunk_msgs+=2000){
+        ECU_Info info;
+        info.msgs = seq.msgs;
+        ASSERT_EQ(0, determine_lcs(info, &pool, chunk_msgs));
+        ASSERT_EQ(seq.lcs.size(), info.lcs.size());
+        LIST_OF_LCS::const_iterator lit = info.lcs.begin();
+        for (LIST_OF_LCS::const_iterator it = seq.lcs.begin(); it!=seq.lcs.end(); ++it, ++lit){
+            EXPECT_EQ((*it).usec_begin, (*lit).usec_begin);
+            EXPECT_EQ((*it).usec_end, (*lit).usec_end);
+            EXPECT_EQ((*it).min_tmsp, (*lit).min_tmsp);
+            EXPECT_EQ((*it).max_tmsp, (*lit).max_tmsp);
+            EXPECT_TRUE((*it).msgs == (*lit).msgs);
+        }
+    }
+    map_ecus.clear();
+    msg_arena.release();
+}
+
+TEST(Algorithm, determine_lcs_chunks_boundary) {
+    // short lcs that interleave (bursty latency, quick reboots) with chunk bounds within and close to the restarts:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.reboot = REBOOT_QUICK;
+    opts.latency = LATENCY_BURSTY;
+    opts.ctrl_ratio = 0.05;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_chunks_boundary", 1, 12, 700, truth, &opts));
+    ASSERT_EQ(1, truth.files.size());
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    ASSERT_EQ(0, process_input(fin));
+    fin.close();
+    remove(truth.files[0].c_str());
+    ASSERT_EQ(1, map_ecus.size());
+    ECU_Info &seq = map_ecus.begin()->second;
+    ASSERT_EQ(0, determine_lcs(seq));
+    ThreadPool pool(4);
+    for (size_t chunk_msgs=97; chunk_msgs<=1500; chunk_msgs+=101){
+        ECU_Info info;
+        info.msgs = seq.msgs;
+        ASSERT_EQ(0, determine_lcs(info, &pool, chunk_msgs));
+        ASSERT_EQ(seq.lcs.size(), info.lcs.size()) << "chunk_msgs " << chunk_msgs;
+        LIST_OF_LCS::const_iterator lit = info.lcs.begin();
+        for (LIST_OF_LCS::const_iterator it = seq.lcs.begin(); it!=seq.lcs.end(); ++it, ++lit){
+            EXPECT_EQ((*it).usec_begin, (*lit).usec_begin) << "chunk_msgs " << chunk_msgs;
+            EXPECT_EQ((*it).usec_end, (*lit).usec_end);
+            EXPECT_TRUE((*it).msgs == (*lit).msgs);
+        }
+    }
+    map_ecus.clear();
+    msg_arena.release();
+}
+
+TEST(Algorithm, determine_clock_skew_per_lc) {
+    // each long lc gets its own estimate. The short ones the skew of their ECU:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.interval_usecs = 50000; // 100s per lc
+    opts.skew_min = 0.995;
+    opts.skew_max = 1.005;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_skew", 2, 3, 2000, truth, &opts));
+    ASSERT_EQ(1, truth.files.size());
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    ASSERT_EQ(0, process_input(fin));
+    fin.close();
+    remove(truth.files[0].c_str());
+    ASSERT_EQ(2, map_ecus.size());
+    ThreadPool pool(4);
+    use_skew_per_lc = 1;
+    size_t i=0;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!= map_ecus.end(); ++it, ++i){
+        ECU_Info &info = it->second;
+        ASSERT_EQ(0, determine_lcs(info));
+        ASSERT_LE(3, info.lcs.size());
+        // a short lc:
+        Lifecycle short_lc(*info.lcs.front().msgs.front());
+        info.lcs.push_back(short_lc);
+        determine_clock_skew(info, &pool);
+        std::set<double> skews;
+        for (LIST_OF_LCS::iterator lit=info.lcs.begin(); lit!=info.lcs.end(); ++lit){
+            EXPECT_NEAR(truth.ecus[i].skew, (*lit).clock_skew, 0.0005);
+            skews.insert((*lit).clock_skew);
+        }
+        EXPECT_LT(1, skews.size()); // the estimates differ a bit
+        // without the per lc mode all get the one of the ECU:
+        use_skew_per_lc = 0;
+        determine_clock_skew(info, &pool);
+        EXPECT_EQ(info.lcs.back().clock_skew, info.lcs.front().clock_skew);
+        use_skew_per_lc = 1;
+    }
+    use_skew_per_lc = 0;
+    map_ecus.clear();
+    msg_arena.release();
+}
+
+TEST(Algorithm, determine_clock_skew_fast) {
+    // the skew from the sample needs to be (about) the same as the one from all msgs:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.skew_min = 0.99;
+    opts.skew_max = 1.01;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_fast_skew", 2, 2, 20000, truth, &opts));
+    ASSERT_EQ(1, truth.files.size());
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    ASSERT_EQ(0, process_input(fin));
+    fin.close();
+    remove(truth.files[0].c_str());
+    ThreadPool pool(4);
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!= map_ecus.end(); ++it){
+        ECU_Info &info = it->second;
+        ASSERT_EQ(0, determine_lcs(info));
+        ECU_Info fast = info;
+        EXPECT_EQ(0, determine_clock_skew(info, &pool));
+        use_fast_skew = 1;
+        int64_t error = determine_clock_skew(fast, &pool);
+        use_fast_skew = 0;
+        EXPECT_LE(0, error);
+        EXPECT_GT(1000, error); // 1ms
+        ASSERT_EQ(info.lcs.size(), fast.lcs.size());
+        LIST_OF_LCS::const_iterator fit = fast.lcs.begin();
+        for (LIST_OF_LCS::const_iterator lit=info.lcs.begin(); lit!=info.lcs.end(); ++lit, ++fit){
+            EXPECT_NEAR((*lit).clock_skew, (*fit).clock_skew, 0.00001);
+            EXPECT_NEAR((double)(*lit).usec_begin, (double)(*fit).usec_begin, 1000.0);
+            EXPECT_TRUE((*lit).msgs == (*fit).msgs);
+        }
+    }
+    map_ecus.clear();
+    msg_arena.release();
+}
+
+TEST(TraceEvents, write_trace_events) {
+    {
+        Trace_Span span("not_recorded", "test");
+    }
+    use_trace_events = 1;
+    {
+        Trace_Span span("recorded", "test", "a \"detail\"");
+    }
+    use_trace_events = 0;
+    const char *name = "/tmp/dlt_sort_unittest_trace.json";
+    ASSERT_EQ(0, write_trace_events(name));
+    std::ifstream f(name);
+    std::string json((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    f.close();
+    remove(name);
+    EXPECT_EQ(std::string::npos, json.find("not_recorded"));
+    EXPECT_NE(std::string::npos, json.find("\"name\": \"recorded\", \"cat\": \"test\", \"ph\": \"X\""));
+    EXPECT_NE(std::string::npos, json.find("\"args\": {\"detail\": \"a \\\"detail\\\"\"}"));
+}
+
+TEST(MsgArena, alloc) {
+    MsgArena arena(1024);
+    ASSERT_EQ(0, arena.nr_chunks());
+    DltMessage *m = arena.alloc_msg();
+    ASSERT_TRUE(m != NULL);
+    ASSERT_EQ(0, ((size_t)m) % sizeof(void*));
+    ASSERT_EQ((DltStorageHeader *)&m->headerbuffer[0], m->storageheader);
+    ASSERT_EQ(1, arena.nr_chunks());
+    // small allocs fit into the current chunk:
+    unsigned char *p1 = arena.alloc_payload(3);
+    unsigned char *p2 = arena.alloc_payload(5);
+    ASSERT_EQ(p1+3, p2);
+    ASSERT_EQ(1, arena.nr_chunks());
+    // bigger than a chunk gets its own chunk:
+    unsigned char *p3 = arena.alloc_payload(4000);
+    memset(p3, 0xaa, 4000);
+    ASSERT_EQ(2, arena.nr_chunks());
+    ASSERT_LE(1024+4000, arena.bytes_reserved());
+    ASSERT_EQ(sizeof(DltMessage)+3+5+4000, arena.bytes_used());
+    
+    MsgArena other(1024);
+    other.alloc_payload(10);
+    arena.take_over(other);
+    ASSERT_EQ(3, arena.nr_chunks());
+    ASSERT_EQ(0, other.nr_chunks());
+    // the current chunk is still used:
+    unsigned char *p4 = arena.alloc_payload(1);
+    ASSERT_EQ(p3+4000, p4);
+    
+    arena.release();
+    ASSERT_EQ(0, arena.nr_chunks());
+    ASSERT_EQ(0, arena.bytes_used());
+}
+
+TEST(MemBudget, payload_refs) {
+    // with a tiny mem_limit the payloads are re-read from the input. The output needs to be the same:
+    Gen_Truth truth;
+    std::string ref;
+    Sort_Stats stats;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_mem", 2, 2, 5000, truth, ref, true, 0, &stats));
+    const char *out_name = "/tmp/dlt_sort_unittest_mem_out.dlt";
+    
+    EXPECT_EQ(0, stats.parse.nr_payload_refs);
+    EXPECT_LT(0, stats.stages[STAGE_PARSE].mem.msgs);
+    EXPECT_LT(0, stats.stages[STAGE_PARSE].mem.payloads);
+    EXPECT_LT(0, stats.stages[STAGE_PARSE].mem.list_nodes);
+    EXPECT_LT(0, stats.stages[STAGE_OVERALL_LCS].mem.lcs);
+    
+    mem_limit = 64*1024;
+    for (use_mmap_output=0; use_mmap_output<2; ++use_mmap_output){
+        ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, true, &stats));
+        EXPECT_LT(0, stats.parse.nr_payload_refs);
+        EXPECT_TRUE(ref == read_file(out_name));
+    }
+    use_mmap_output = 0;
+    mem_limit = 0;
+    remove(out_name);
+    remove(truth.files[0].c_str());
+}
+
+TEST(MemBudget, Payload_Planner) {
+    // the payloads in an order alternating between the ECUs are read with few coalesced reads:
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_planner", 3, 1, 20000, truth));
+    ASSERT_EQ(1, truth.files.size());
+    use_payload_refs = 1;
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    ASSERT_EQ(0, process_input(fin, 0, 0));
+    fin.close();
+    ASSERT_EQ(0, open_payload_files(truth.files));
+    
+    VEC_OF_OUT_MSGS order;
+    std::vector<LIST_OF_MSGS::const_iterator> its, ends;
+    for (MAP_OF_ECUS::const_iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it){
+        its.push_back(it->second.msgs.begin());
+        ends.push_back(it->second.msgs.end());
+    }
+    for (bool added=true; added;){
+        added = false;
+        for (size_t e=0; e<its.size(); ++e){
+            if (its[e]==ends[e]) continue;
+            Out_Msg o;
+            o.msg = *its[e]++;
+            o.usec_begin = 0;
+            o.clock_skew = 1.0;
+            order.push_back(o);
+            added = true;
+        }
+    }
+    size_t nr_refs = 0;
+    {
+        Payload_Planner planner(order, 0, order.size());
+        for (size_t i=0; i<order.size(); ++i){
+            const DltMessage *msg = order[i].msg;
+            if (!(msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF)) continue;
+            ++nr_refs;
+            std::vector<unsigned char> payload((size_t)msg->databuffersize);
+            ASSERT_TRUE(read_payload(*msg, &payload[0]));
+            const unsigned char *p = planner.payload(i);
+            ASSERT_TRUE(p != 0);
+            ASSERT_EQ(0, memcmp(p, &payload[0], payload.size()));
+        }
+        EXPECT_LT(1000, nr_refs);
+        EXPECT_GT(nr_refs/100, (size_t)planner.nr_reads());
+    }
+    {
+        // stopped before all payloads were used:
+        Payload_Planner planner(order, order.size()/2, order.size());
+    }
+    close_payload_files();
+    use_payload_refs = 0;
+    map_ecus.clear();
+    msg_arena.release();
+    remove(truth.files[0].c_str());
+}
+
+TEST(PayloadBlocks, lz_compress) {
+    std::vector<std::vector<unsigned char> > inputs(5);
+    for (int i=0; i<3; ++i) inputs[1].push_back((unsigned char)i); // shorter than a match
+    for (int i=0; i<100000; ++i) inputs[2].push_back((unsigned char)(i%7)); // long matches
+    srand(42);
+    for (int i=0; i<70000; ++i) inputs[3].push_back((unsigned char)rand()); // incompressible
+    const char *text = "DLT verbose msg: value=";
+    for (int i=0; i<5000; ++i){
+        inputs[4].insert(inputs[4].end(), text, text+strlen(text));
+        inputs[4].push_back((unsigned char)('0'+(i%10)));
+    }
+    for (size_t i=0; i<inputs.size(); ++i){
+        const std::vector<unsigned char> &in = inputs[i];
+        std::vector<unsigned char> c(lz_compress_bound(in.size()));
+        size_t c_len = lz_compress(in.size() ? &in[0] : 0, in.size(), &c[0]);
+        ASSERT_LE(c_len, c.size());
+        std::vector<unsigned char> out(in.size()+1);
+        EXPECT_TRUE(lz_decompress(&c[0], c_len, &out[0], in.size()));
+        out.resize(in.size());
+        EXPECT_TRUE(in == out);
+        if (in.size()>1000 && i!=3){ EXPECT_GT(in.size()/5, c_len); }
+        // truncated input is detected:
+        if (c_len>1){
+            out.resize(in.size()+1);
+            EXPECT_FALSE(lz_decompress(&c[0], c_len-1, &out[0], in.size()));
+        }
+    }
+}
+
+TEST(PayloadBlocks, sort_dlt_files) {
+    // the output with compressed payloads is the same:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 500000;
+    opts.rotate_overlap = 0;
+    Gen_Truth truth;
+    std::string ref;
+    Sort_Stats ref_stats;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_blocks", 3, 2, 5000, truth, ref, true, &opts, &ref_stats));
+    EXPECT_EQ(0, ref_stats.parse.payload_bytes_raw);
+    const char *out_name = "/tmp/dlt_sort_unittest_blocks_out.dlt";
+    
+    use_payload_blocks = 1;
+    for (use_mmap_output=0; use_mmap_output<2; ++use_mmap_output){
+        for (nr_jobs=1; nr_jobs<=4; nr_jobs+=3){
+            Sort_Stats stats;
+            ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, true, &stats));
+            EXPECT_TRUE(ref == read_file(out_name));
+            EXPECT_LT(0, stats.parse.payload_bytes_raw);
+            EXPECT_GT(stats.parse.payload_bytes_raw, stats.parse.payload_bytes_compressed);
+            EXPECT_GT(ref_stats.stages[STAGE_PARSE].mem.payloads, stats.stages[STAGE_PARSE].mem.payloads);
+        }
+    }
+    // --dedup compares the payloads as well:
+    use_dedup = 1;
+    ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, true));
+    EXPECT_TRUE(ref == read_file(out_name));
+    use_dedup = 0;
+    use_mmap_output = 0;
+    nr_jobs = 0;
+    use_payload_blocks = 0;
+    remove(out_name);
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(Pipeline, SPSC_Queue) {
+    SPSC_Queue<int> queue(3);
+    ASSERT_TRUE(queue.try_push(1));
+    ASSERT_TRUE(queue.try_push(2));
+    ASSERT_TRUE(queue.try_push(3));
+    ASSERT_FALSE(queue.try_push(4)); // full
+    int v=0;
+    ASSERT_TRUE(queue.try_pop(v));
+    ASSERT_EQ(1, v);
+    // producer and consumer in different threads:
+    std::thread producer([&](){
+        for (int i=4; i<=100000; ++i) queue.push(i);
+        queue.close();
+    });
+    int expected=2;
+    while (queue.pop(v)){
+        ASSERT_EQ(expected, v);
+        ++expected;
+    }
+    producer.join();
+    ASSERT_EQ(100001, expected);
+}
+
+TEST(Pipeline, same_output) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 1500000;
+    opts.rotate_overlap = 0;
+    opts.corrupt_ratio = 0.01;
+    Gen_Truth truth;
+    std::string ref;
+    Sort_Stats ref_stats;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_pipe", 5, 3, 4000, truth, ref, false, &opts, &ref_stats));
+    ASSERT_LE(2, truth.files.size());
+    const char *out_name = "/tmp/dlt_sort_unittest_pipe_out.dlt";
+    
+    use_pipeline = 1;
+    for (nr_jobs=1; nr_jobs<=4; nr_jobs+=3){
+        Sort_Stats stats;
+        ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, false, &stats));
+        EXPECT_TRUE(ref == read_file(out_name));
+        EXPECT_EQ(ref_stats.parse.nr_msgs, stats.parse.nr_msgs);
+        EXPECT_EQ(ref_stats.parse.nr_skipped, stats.parse.nr_skipped);
+        EXPECT_EQ(ref_stats.parse.resync_bytes, stats.parse.resync_bytes);
+        ASSERT_EQ(ref_stats.ecus.size(), stats.ecus.size());
+        for (size_t i=0; i<stats.ecus.size(); ++i)
+            EXPECT_EQ(ref_stats.ecus[i].nr_lcs, stats.ecus[i].nr_lcs);
+    }
+    use_pipeline = 0;
+    nr_jobs = 0;
+    remove(out_name);
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(AsyncRead, same_output) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 1500000; // > read_block_size so the blocks of a file are in flight together
+    opts.rotate_overlap = 0;
+    Gen_Truth truth;
+    std::string ref;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_uring", 4, 2, 8000, truth, ref, false, &opts));
+    ASSERT_LE(2, truth.files.size());
+    const char *out_name = "/tmp/dlt_sort_unittest_uring_out.dlt";
+    
+    // the reader passes the blocks of all files in order (with io_uring or the blocking fallback):
+    // a file that can't be read is passed as empty and reported after the others:
+    std::vector<std::string> files(truth.files);
+    files.insert(files.begin()+1, "/tmp/dlt_sort_unittest_uring_missing.dlt");
+    for (use_io_uring=1; use_io_uring>=0; --use_io_uring){
+        SPSC_Queue<Read_Block> queue(read_queue_blocks);
+        int read_error = 0;
+        std::thread reader(read_files, &files, &queue, &read_error);
+        for (size_t i=0; i<files.size(); ++i){
+            std::string data;
+            Read_Block rb;
+            while (queue.pop(rb) && rb.data){
+                EXPECT_EQ((int64_t)data.size(), rb.offset);
+                data.append(&(*rb.data)[0], rb.data->size());
+                delete rb.data;
+            }
+            EXPECT_TRUE(read_file(files[i].c_str()) == data);
+        }
+        reader.join();
+        EXPECT_EQ(-1, read_error);
+    }
+    
+    use_io_uring = 1;
+    for (use_pipeline=0; use_pipeline<=1; ++use_pipeline){
+        ASSERT_EQ(0, sort_dlt_files(truth.files, out_name, false, false));
+        EXPECT_TRUE(ref == read_file(out_name));
+    }
+    use_pipeline = 0;
+    use_io_uring = 0;
+    remove(out_name);
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(Dedup, sort_dlt_files) {
+    // the same capture twice (e.g. from two loggers) results in the output of one:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    Gen_Truth truth;
+    std::string ref;
+    Sort_Stats ref_stats;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_dedup", 3, 2, 3000, truth, ref, false, &opts, &ref_stats));
+    ASSERT_EQ(1, truth.files.size());
+    const char *out_name = "/tmp/dlt_sort_unittest_dedup_out.dlt";
+    EXPECT_EQ(0, ref_stats.nr_duplicates);
+    
+    std::vector<std::string> ifiles(2, truth.files[0]);
+    int64_t nr_lc_msgs = (int64_t)opts.nr_ecus * opts.lcs_per_ecu * opts.msgs_per_lc;
+    use_dedup = 1;
+    for (nr_jobs=1; nr_jobs<=4; nr_jobs+=3){
+        Sort_Stats stats;
+        ASSERT_EQ(0, sort_dlt_files(ifiles, out_name, false, false, &stats));
+        EXPECT_TRUE(ref == read_file(out_name));
+        // the control msgs with tmsp 0 are not part of any lc (and not output):
+        EXPECT_EQ(nr_lc_msgs, stats.nr_duplicates);
+        EXPECT_EQ(2*ref_stats.nr_msgs - nr_lc_msgs, stats.nr_msgs);
+    }
+    // with the payloads kept in the files:
+    mem_limit = 1;
+    {
+        Sort_Stats stats;
+        ASSERT_EQ(0, sort_dlt_files(ifiles, out_name, false, false, &stats));
+        EXPECT_TRUE(ref == read_file(out_name));
+        EXPECT_EQ(nr_lc_msgs, stats.nr_duplicates);
+    }
+    mem_limit = 0;
+    use_dedup = 0;
+    nr_jobs = 0;
+    remove(out_name);
+    remove(truth.files[0].c_str());
+}
+
+TEST(Dedup, unreadable_payload) {
+    // two msgs with payloads that can't be read (no payload file open) aren't duplicates:
+    DltMessage a, b;
+    init_DltMessage(a);
+    init_DltMessage(b);
+    Payload_Ref ref_a, ref_b;
+    memset(&ref_a, 0, sizeof(ref_a));
+    memset(&ref_b, 0, sizeof(ref_b));
+    ref_a.file_idx = ref_b.file_idx = 1000;
+    ref_b.offset = 100;
+    a.databuffer = (unsigned char *)&ref_a;
+    b.databuffer = (unsigned char *)&ref_b;
+    a.databuffersize = b.databuffersize = 20;
+    a.found_serialheader |= DLT_SORT_MSG_PAYLOAD_REF;
+    b.found_serialheader |= DLT_SORT_MSG_PAYLOAD_REF;
+    bool readable = true;
+    hash_message(a, 0, &readable);
+    EXPECT_FALSE(readable);
+    EXPECT_FALSE(equal_messages(a, b));
+    Msg_Hash_Set set(2);
+    EXPECT_TRUE(set.insert(&a));
+    EXPECT_TRUE(set.insert(&b));
+    EXPECT_EQ(2u, set.nr_unreadable());
+    EXPECT_EQ(0u, set.size());
+}
+
+TEST(Server, handle_request) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    Gen_Truth truth;
+    std::string ref;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_server", 3, 2, 2000, truth, ref, false, &opts));
+    ASSERT_EQ(1, truth.files.size());
+    const char *out_name = "/tmp/dlt_sort_unittest_server_out.dlt";
+    
+    int64_t nr_lc_msgs = (int64_t)opts.nr_ecus * opts.lcs_per_ecu * opts.msgs_per_lc; // the control msgs with tmsp 0 are not output
+    Sort_Server server(2);
+    EXPECT_EQ(0, server.handle_request("sort c1 x.dlt").find("ERR"));
+    EXPECT_EQ(0, server.handle_request("add c1 " + truth.files[0]).find("OK"));
+    EXPECT_EQ(0, server.handle_request("add c2 /tmp/dlt_sort_unittest_server_missing.dlt").find("ERR"));
+    EXPECT_EQ(0, server.handle_request("list").find("OK c1"));
+    // the same output as a single run (twice without parsing again):
+    for (int i=0; i<2; ++i){
+        std::ostringstream expected;
+        expected << "OK " << nr_lc_msgs << " msgs";
+        EXPECT_EQ(expected.str(), server.handle_request(std::string("sort c1 ") + out_name));
+        EXPECT_TRUE(ref == read_file(out_name));
+    }
+    // an output that can't be written is an error (the server keeps running):
+    EXPECT_EQ(0, server.handle_request("sort c1 /tmp/dlt_sort_unittest_no_dir/out.dlt").find("ERR"));
+    EXPECT_EQ(0, server.handle_request("sort c1 /tmp/dlt_sort_unittest_no_dir/out.dlt split").find("ERR"));
+    // just one ECU:
+    std::ostringstream expected;
+    expected << "OK " << opts.lcs_per_ecu * opts.msgs_per_lc << " msgs";
+    EXPECT_EQ(expected.str(), server.handle_request(std::string("sort c1 ") + out_name + " ecus=" + truth.ecus[1].ecu));
+    // a time window of the lifecycle time:
+    Sort_Context ctx;
+    ThreadPool pool(1);
+    ASSERT_EQ(0, ctx.analyse(truth.files, pool));
+    ASSERT_EQ(nr_lc_msgs, ctx.nr_msgs());
+    ASSERT_FALSE(ctx.is_stale());
+    Output_Selection sel;
+    init_Output_Selection(sel);
+    const Lifecycle &lc = ctx.overall_lcs().front().lcs.front();
+    sel.usec_from = lc.usec_begin;
+    sel.usec_to = lc.usec_begin + usecs_per_sec;
+    int64_t nr_msgs = 0;
+    ASSERT_EQ(0, ctx.output(out_name, sel, false, true, pool, &nr_msgs));
+    EXPECT_LT(0, nr_msgs);
+    EXPECT_GT(nr_lc_msgs, nr_msgs);
+    std::string out = read_file(out_name);
+    int64_t nr_out = 0;
+    for (size_t pos=0; pos+sizeof(DltStorageHeader)<=out.size(); ++nr_out){
+        DltStorageHeader sh;
+        memcpy(&sh, out.data()+pos, sizeof(sh));
+        int64_t t = (int64_t)sh.seconds*usecs_per_sec + sh.microseconds;
+        EXPECT_LE(sel.usec_from, t);
+        EXPECT_GT(sel.usec_to, t);
+        DltStandardHeader hdr;
+        memcpy(&hdr, out.data()+pos+sizeof(sh), sizeof(hdr));
+        pos += sizeof(sh) + DLT_BETOH_16(hdr.len);
+    }
+    EXPECT_EQ(nr_msgs, nr_out);
+    
+    // a changed file is analysed again:
+    {
+        std::ofstream f(truth.files[0].c_str(), std::ios::out|std::ios::app|std::ios::binary);
+        f.write(ref.data(), 1000); // a few msgs again
+    }
+    EXPECT_TRUE(ctx.is_stale());
+    EXPECT_NE(std::string::npos, server.handle_request(std::string("sort c1 ") + out_name).find("analysed again"));
+    EXPECT_EQ(std::string::npos, server.handle_request(std::string("sort c1 ") + out_name).find("analysed again"));
+    EXPECT_EQ("OK", server.handle_request("remove c1"));
+    EXPECT_EQ("OK", server.handle_request("list"));
+    EXPECT_EQ(0, server.handle_request("foo").find("ERR"));
+    EXPECT_EQ("OK", server.handle_request("shutdown"));
+    remove(out_name);
+    remove(truth.files[0].c_str());
+}
+
+TEST(Server, analyse_incremental) {
+    // only the new and changed files are parsed. The output is the same as of a single run:
+    Gen_Truth truth_a, truth_b;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_incr_a", 3, 2, 2000, truth_a));
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.seed = 2;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_incr_b", 1, 2, 1500, truth_b, &opts)); // the first ECU only
+    std::string a = truth_a.files[0], b = truth_b.files[0];
+    const char *ref_name = "/tmp/dlt_sort_unittest_incr_ref.dlt";
+    const char *out_name = "/tmp/dlt_sort_unittest_incr_out.dlt";
+    Output_Selection sel;
+    init_Output_Selection(sel);
+    ThreadPool pool(2);
+    Sort_Context ctx;
+    const char *steps[][2] = {{a.c_str(), 0}, {a.c_str(), b.c_str()}, {b.c_str(), 0}, {b.c_str(), a.c_str()}, {a.c_str(), b.c_str()}};
+    const size_t nr_parsed[] = {1, 1, 0, 1, 0};
+    for (size_t i=0; i<sizeof(nr_parsed)/sizeof(nr_parsed[0]); ++i){
+        std::vector<std::string> files(1, steps[i][0]);
+        if (steps[i][1]) files.push_back(steps[i][1]);
+        ASSERT_EQ(0, ctx.analyse(files, pool));
+        EXPECT_EQ(nr_parsed[i], ctx.nr_files_parsed()) << "step " << i;
+        ASSERT_EQ(0, sort_dlt_files(files, ref_name, false, false));
+        ASSERT_EQ(0, ctx.output(out_name, sel, false, false, pool));
+        EXPECT_TRUE(read_file(ref_name) == read_file(out_name)) << "step " << i;
+    }
+    // a changed file:
+    {
+        std::string msgs = read_file(b.c_str());
+        std::ofstream f(b.c_str(), std::ios::out|std::ios::app|std::ios::binary);
+        f.write(msgs.data(), 1000); // a few msgs again
+    }
+    EXPECT_EQ(1, ctx.refresh(pool));
+    EXPECT_EQ(1u, ctx.nr_files_parsed());
+    EXPECT_EQ(0, ctx.refresh(pool));
+    ASSERT_EQ(0, sort_dlt_files(ctx.files(), ref_name, false, false));
+    ASSERT_EQ(0, ctx.output(out_name, sel, false, false, pool));
+    EXPECT_TRUE(read_file(ref_name) == read_file(out_name));
+    // a missing file keeps the current content:
+    std::vector<std::string> files(ctx.files());
+    files.push_back("/tmp/dlt_sort_unittest_incr_missing.dlt");
+    EXPECT_EQ(-1, ctx.analyse(files, pool));
+    EXPECT_EQ(2u, ctx.files().size());
+    ASSERT_EQ(0, ctx.output(out_name, sel, false, false, pool));
+    EXPECT_TRUE(read_file(ref_name) == read_file(out_name));
+    remove(ref_name);
+    remove(out_name);
+    remove(a.c_str());
+    remove(b.c_str());
+}
+
+TEST(Server, run_keeps_other_files) {
+    // only a socket (from a previous run) is replaced:
+    const char *name = "/tmp/dlt_sort_unittest_server_sock";
+    std::ofstream(name, std::ios::binary) << "no socket";
+    Sort_Server server(1);
+    EXPECT_EQ(-1, server.run(name));
+    EXPECT_EQ("no socket", read_file(name));
+    remove(name);
+}
+
+TEST(Shard, map_reduce) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 400000;
+    Gen_Truth truth;
+    std::string ref;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_shard", 4, 2, 2000, truth, ref, true, &opts));
+    ASSERT_LE(2, truth.files.size());
+    const char *out_name = "/tmp/dlt_sort_unittest_shard_out.dlt";
+    
+    // one map over all files results in the same output:
+    std::string prefix("/tmp/dlt_sort_unittest_shard_map");
+    ASSERT_EQ(0, map_dlt_files(truth.files, prefix));
+    std::vector<std::string> lcs_files(1, prefix + ".lcs");
+    Sort_Stats stats;
+    ASSERT_EQ(0, reduce_dlt_files(lcs_files, out_name, false, true, &stats));
+    EXPECT_TRUE(ref == read_file(out_name));
+    EXPECT_EQ((int64_t)ref.size(), stats.bytes_written);
+    
+    // a map per file. Contains all msgs:
+    std::vector<std::string> map_lcs_files, map_prefixes(1, prefix);
+    for (size_t i=0; i<truth.files.size(); ++i){
+        std::ostringstream map_prefix;
+        map_prefix << prefix << i;
+        ASSERT_EQ(0, map_dlt_files(std::vector<std::string>(1, truth.files[i]), map_prefix.str()));
+        map_lcs_files.push_back(map_prefix.str() + ".lcs");
+        map_prefixes.push_back(map_prefix.str());
+    }
+    ASSERT_EQ(0, reduce_dlt_files(map_lcs_files, out_name, false, true, &stats));
+    EXPECT_EQ(ref.size(), read_file(out_name).size());
+    EXPECT_EQ(-1, reduce_dlt_files(std::vector<std::string>(1, truth.files[0]), out_name, false, false)); // a dlt file is no lcs file
+    
+    // a truncated or missing lifecycle file is an error (and not an empty lifecycle):
+    std::string lc_name = get_ofstream_name(1, prefix + "_lc.dlt");
+    std::string lc = read_file(lc_name.c_str());
+    ASSERT_LT(100u, lc.size());
+    {
+        std::ofstream f(lc_name.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+        f.write(lc.data(), lc.size()-10);
+    }
+    EXPECT_EQ(-1, reduce_dlt_files(lcs_files, out_name, false, true));
+    remove(lc_name.c_str());
+    EXPECT_EQ(-1, reduce_dlt_files(lcs_files, out_name, false, true));
+    
+    remove(out_name);
+    for (size_t i=0; i<map_prefixes.size(); ++i){
+        remove((map_prefixes[i] + ".lcs").c_str());
+        for (int j=1; !remove(get_ofstream_name(j, map_prefixes[i] + "_lc.dlt").c_str()); ++j) {}
+    }
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+static uint64_t get_le(const std::string &s, size_t pos, size_t len)
+{
+    uint64_t v=0;
+    for (size_t i=0; i<len; ++i) v |= ((uint64_t)(unsigned char)s[pos+i]) << (8*i);
+    return v;
+}
+
+static void check_nav_index(const std::string &dlt_name, uint64_t &nr_msgs)
+{
+    // each record points to a msg of the output file. The coarse entries to every 1024th:
+    std::string out = read_file(dlt_name.c_str());
+    std::string idx = read_file((dlt_name + ".idx").c_str());
+    ASSERT_LE(40u, idx.size());
+    ASSERT_EQ(std::string("DLTSIDX1"), idx.substr(0, 8));
+    EXPECT_EQ(1u, get_le(idx, 8, 4));
+    ASSERT_EQ(24u, get_le(idx, 12, 4));
+    nr_msgs = get_le(idx, 16, 8);
+    uint64_t nr_coarse = get_le(idx, 24, 8);
+    ASSERT_EQ(nav_index_coarse_msgs, get_le(idx, 32, 8));
+    EXPECT_EQ((nr_msgs+nav_index_coarse_msgs-1)/nav_index_coarse_msgs, nr_coarse);
+    ASSERT_EQ(40 + 24*(nr_msgs+nr_coarse), idx.size());
+    uint64_t expected_offset = 0;
+    int64_t max_time = std::numeric_limits<int64_t>::min();
+    for (uint64_t i=0; i<nr_msgs; ++i){
+        size_t rec = 40 + 24*i;
+        uint64_t offset = get_le(idx, rec, 8);
+        int64_t t = (int64_t)get_le(idx, rec+8, 8);
+        ASSERT_EQ(expected_offset, offset);
+        ASSERT_EQ(0, out.compare(offset, 4, "DLT\x01", 4));
+        DltStorageHeader sh;
+        DltStandardHeader std_hdr;
+        memcpy(&sh, &out[offset], sizeof(sh));
+        memcpy(&std_hdr, &out[offset+sizeof(sh)], sizeof(std_hdr));
+        if (!DLT_IS_HTYP_WEID(std_hdr.htyp)){ EXPECT_EQ(0, memcmp(sh.ecu, &idx[rec+16], 4)); }
+        expected_offset += sizeof(sh) + DLT_BETOH_16(std_hdr.len);
+        if (t > max_time) max_time = t;
+        if (i % nav_index_coarse_msgs == 0){
+            size_t c = 40 + 24*(nr_msgs + i/nav_index_coarse_msgs);
+            EXPECT_EQ(max_time, (int64_t)get_le(idx, c, 8));
+            EXPECT_EQ(i, get_le(idx, c+8, 8));
+            EXPECT_EQ(offset, get_le(idx, c+16, 8));
+        }
+    }
+    EXPECT_EQ(out.size(), expected_offset);
+}
+
+TEST(NavIndex, sort_dlt_files) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 400000;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_index", 3, 2, 3000, truth, &opts));
+    std::string out_name("/tmp/dlt_sort_unittest_index_out.dlt");
+    std::string idx_name = out_name + ".idx";
+    
+    use_nav_index = 1;
+    uint64_t nr_msgs = 0;
+    ASSERT_EQ(0, sort_dlt_files(truth.files, out_name.c_str(), false, false));
+    check_nav_index(out_name, nr_msgs);
+    EXPECT_LT(0u, nr_msgs);
+    std::string ref_idx = read_file(idx_name.c_str());
+    // the same index with -t, via mmap and from --reduce:
+    ASSERT_EQ(0, sort_dlt_files(truth.files, out_name.c_str(), false, true));
+    EXPECT_TRUE(ref_idx == read_file(idx_name.c_str()));
+    use_mmap_output = 1;
+    nr_jobs = 4;
+    ASSERT_EQ(0, sort_dlt_files(truth.files, out_name.c_str(), false, true));
+    EXPECT_TRUE(ref_idx == read_file(idx_name.c_str()));
+    // an index that can't be written is an error. The output is complete anyhow:
+    std::string ref_out = read_file(out_name.c_str());
+    remove(idx_name.c_str());
+    ASSERT_EQ(0, mkdir(idx_name.c_str(), 0755));
+    EXPECT_EQ(-1, sort_dlt_files(truth.files, out_name.c_str(), false, true));
+    EXPECT_TRUE(ref_out == read_file(out_name.c_str()));
+    rmdir(idx_name.c_str());
+    use_mmap_output = 0;
+    nr_jobs = 0;
+    std::string prefix("/tmp/dlt_sort_unittest_index_map");
+    ASSERT_EQ(0, map_dlt_files(truth.files, prefix));
+    ASSERT_EQ(0, reduce_dlt_files(std::vector<std::string>(1, prefix + ".lcs"), out_name.c_str(), false, true));
+    EXPECT_TRUE(ref_idx == read_file(idx_name.c_str()));
+    
+    // one index per file with -s:
+    ASSERT_EQ(0, sort_dlt_files(truth.files, out_name.c_str(), true, false));
+    uint64_t nr_split_msgs = 0;
+    int nr_files = 0;
+    for (int j=1;; ++j){
+        std::string name = get_ofstream_name(j, out_name);
+        if (read_file(name.c_str()).empty()) break;
+        uint64_t n = 0;
+        check_nav_index(name, n);
+        nr_split_msgs += n;
+        ++nr_files;
+        remove(name.c_str());
+        remove((name + ".idx").c_str());
+    }
+    EXPECT_LE(2, nr_files);
+    EXPECT_EQ(nr_msgs, nr_split_msgs);
+    use_nav_index = 0;
+    
+    remove(out_name.c_str());
+    remove(idx_name.c_str());
+    remove((prefix + ".lcs").c_str());
+    for (int j=1; !remove(get_ofstream_name(j, prefix + "_lc.dlt").c_str()); ++j) {}
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(InPlace, sort_dlt_file) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.corrupt_ratio = 0.01; // garbage bytes that are dropped
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_inplace", 3, 2, 3000, truth, &opts));
+    ASSERT_EQ(1u, truth.files.size());
+    const std::string input = read_file(truth.files[0].c_str());
+    std::string ref_name("/tmp/dlt_sort_unittest_inplace_ref.dlt");
+    std::string name("/tmp/dlt_sort_unittest_inplace_out.dlt");
+    std::vector<std::string> ifiles(1, name);
+    
+    // the same output as sort_dlt_files with and without -t:
+    for (int timeadjust=0; timeadjust<2; ++timeadjust){
+        ASSERT_EQ(0, sort_dlt_files(truth.files, ref_name.c_str(), false, timeadjust!=0));
+        std::string ref = read_file(ref_name.c_str());
+        EXPECT_LT(ref.size(), input.size());
+        std::ofstream(name.c_str(), std::ios::binary) << input;
+        ASSERT_EQ(0, sort_dlt_file_in_place(ifiles, false, timeadjust!=0));
+        EXPECT_TRUE(ref == read_file(name.c_str())) << "timeadjust=" << timeadjust;
+        EXPECT_TRUE(read_file((name + ".inplace").c_str()).empty());
+        // a sorted file stays as it is:
+        ASSERT_EQ(0, sort_dlt_file_in_place(ifiles, false, timeadjust!=0));
+        EXPECT_TRUE(ref == read_file(name.c_str())) << "timeadjust=" << timeadjust;
+    }
+    
+    // killed after the truncation but before removing the journal:
+    std::ofstream(name.c_str(), std::ios::binary) << input;
+    in_place_keep_journal = 1;
+    ASSERT_EQ(0, sort_dlt_file_in_place(ifiles, false, true));
+    in_place_keep_journal = 0;
+    EXPECT_TRUE(read_file(ref_name.c_str()) == read_file(name.c_str()));
+    EXPECT_FALSE(read_file((name + ".inplace").c_str()).empty());
+    ASSERT_EQ(0, sort_dlt_file_in_place(ifiles, false, true)); // continues with the journal
+    EXPECT_TRUE(read_file(ref_name.c_str()) == read_file(name.c_str()));
+    EXPECT_TRUE(read_file((name + ".inplace").c_str()).empty());
+    
+    // an incomplete journal is ignored. The index is written as well:
+    std::ofstream(name.c_str(), std::ios::binary) << input;
+    std::ofstream((name + ".inplace").c_str(), std::ios::binary) << "DLTS";
+    use_nav_index = 1;
+    ASSERT_EQ(0, sort_dlt_file_in_place(ifiles, false, true));
+    use_nav_index = 0;
+    EXPECT_TRUE(read_file(ref_name.c_str()) == read_file(name.c_str()));
+    EXPECT_TRUE(read_file((name + ".inplace").c_str()).empty());
+    uint64_t nr_msgs = 0;
+    check_nav_index(name, nr_msgs);
+    EXPECT_LT(0u, nr_msgs);
+    
+    // a plan reversing the order parks most msgs:
+    std::ofstream(name.c_str(), std::ios::binary) << read_file(ref_name.c_str());
+    std::vector<In_Place_Msg> plan;
+    {
+        std::string out = read_file(name.c_str());
+        for (size_t offset=0; offset<out.size(); ){
+            DltStandardHeader std_hdr;
+            memcpy(&std_hdr, &out[offset+sizeof(DltStorageHeader)], sizeof(std_hdr));
+            In_Place_Msg m;
+            m.src = offset;
+            m.len = (uint32_t)(sizeof(DltStorageHeader) + DLT_BETOH_16(std_hdr.len));
+            m.usecs = 0;
+            plan.insert(plan.begin(), m);
+            offset += m.len;
+        }
+    }
+    ASSERT_EQ(0, permute_in_place(name, plan, false, name + ".inplace", 0));
+    std::string reversed = read_file(name.c_str());
+    std::string ref = read_file(ref_name.c_str());
+    ASSERT_EQ(ref.size(), reversed.size());
+    uint64_t pos = 0;
+    for (size_t i=0; i<plan.size(); ++i){
+        EXPECT_EQ(0, reversed.compare(pos, plan[i].len, ref, plan[i].src, plan[i].len)) << "msg " << i;
+        pos += plan[i].len;
+    }
+    
+    remove(name.c_str());
+    remove((name + ".idx").c_str());
+    remove(ref_name.c_str());
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(FanOut, parse_output_spec) {
+    Output_Spec spec;
+    ASSERT_TRUE(parse_output_spec("sorted.dlt", spec));
+    EXPECT_EQ("sorted.dlt", spec.name);
+    EXPECT_FALSE(spec.split || spec.timeadjust || spec.per_ecu);
+    ASSERT_TRUE(parse_output_spec("te:sorted.dlt", spec));
+    EXPECT_EQ("sorted.dlt", spec.name);
+    EXPECT_TRUE(!spec.split && spec.timeadjust && spec.per_ecu);
+    ASSERT_TRUE(parse_output_spec("c:\\sorted.dlt", spec)); // no valid prefix
+    EXPECT_EQ("c:\\sorted.dlt", spec.name);
+    EXPECT_FALSE(parse_output_spec("st:", spec));
+    uint32_t ecu_id;
+    memcpy(&ecu_id, "EC\0\0", 4);
+    EXPECT_EQ("sorted_EC.dlt", get_ecu_ofstream_name(ecu_id, "sorted.dlt"));
+    memcpy(&ecu_id, "E/1 ", 4);
+    EXPECT_EQ("out_E_1__452F3120.dlt", get_ecu_ofstream_name(ecu_id, "out"));
+    // ids with replaced chars don't end up in the same file:
+    memcpy(&ecu_id, "E_1 ", 4);
+    EXPECT_EQ("out_E_1__455F3120.dlt", get_ecu_ofstream_name(ecu_id, "out"));
+    memcpy(&ecu_id, "EC\0X", 4);
+    EXPECT_EQ("sorted_EC_45430058.dlt", get_ecu_ofstream_name(ecu_id, "sorted.dlt"));
+}
+
+TEST(FanOut, sort_dlt_files) {
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.rotate_bytes = 300000;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_fanout", 3, 2, 2000, truth, &opts));
+    std::string ref_name("/tmp/dlt_sort_unittest_fanout_ref.dlt");
+    std::string prefix("/tmp/dlt_sort_unittest_fanout_out");
+    
+    // all outputs of one run are the same as those of separate runs:
+    std::vector<Output_Spec> outputs(4);
+    for (size_t i=0; i<outputs.size(); ++i) init_Output_Spec(outputs[i]);
+    outputs[0].name = prefix + ".dlt";
+    outputs[1].name = prefix + "_t.dlt";
+    outputs[1].timeadjust = true;
+    outputs[2].name = prefix + "_s.dlt";
+    outputs[2].split = true;
+    outputs[2].timeadjust = true;
+    outputs[3].name = prefix + "_e.dlt";
+    outputs[3].per_ecu = true;
+    Sort_Stats stats;
+    use_payload_blocks = 1; // the payloads are decompressed once for all outputs
+    ASSERT_EQ(0, sort_dlt_files(truth.files, outputs, &stats));
+    use_payload_blocks = 0;
+    int64_t bytes_written = 0;
+    
+    ASSERT_EQ(0, sort_dlt_files(truth.files, ref_name.c_str(), false, false));
+    std::string ref = read_file(ref_name.c_str());
+    EXPECT_LT(0u, ref.size());
+    EXPECT_TRUE(ref == read_file(outputs[0].name.c_str()));
+    bytes_written += ref.size();
+    ASSERT_EQ(0, sort_dlt_files(truth.files, ref_name.c_str(), false, true));
+    EXPECT_TRUE(read_file(ref_name.c_str()) == read_file(outputs[1].name.c_str()));
+    bytes_written += ref.size();
+    ASSERT_EQ(0, sort_dlt_files(truth.files, ref_name.c_str(), true, true));
+    int nr_files = 0;
+    for (int j=1;; ++j){
+        std::string name = get_ofstream_name(j, ref_name);
+        std::string split = read_file(name.c_str());
+        if (split.empty()) break;
+        EXPECT_TRUE(split == read_file(get_ofstream_name(j, outputs[2].name).c_str())) << "file " << j;
+        bytes_written += split.size();
+        ++nr_files;
+        remove(name.c_str());
+        remove(get_ofstream_name(j, outputs[2].name).c_str());
+    }
+    EXPECT_LE(2, nr_files);
+    for (size_t e=0; e<truth.ecus.size(); ++e){
+        ASSERT_TRUE(add_filter_ids(msg_filter.incl_ecus, truth.ecus[e].ecu.c_str()));
+        ASSERT_EQ(0, sort_dlt_files(truth.files, ref_name.c_str(), false, false));
+        msg_filter.incl_ecus.clear();
+        uint32_t ecu_id = 0;
+        memcpy(&ecu_id, truth.ecus[e].ecu.c_str(), std::min<size_t>(4, truth.ecus[e].ecu.size()));
+        std::string name = get_ecu_ofstream_name(ecu_id, outputs[3].name);
+        std::string per_ecu = read_file(name.c_str());
+        EXPECT_LT(0u, per_ecu.size());
+        EXPECT_TRUE(read_file(ref_name.c_str()) == per_ecu) << truth.ecus[e].ecu;
+        bytes_written += per_ecu.size();
+        remove(name.c_str());
+    }
+    EXPECT_EQ(bytes_written, stats.bytes_written);
+    
+    // an output that can't be opened is an error. The others are written anyhow:
+    outputs.resize(2);
+    outputs[1].name = "/tmp/dlt_sort_unittest_no_dir/out.dlt";
+    outputs[1].per_ecu = true;
+    remove(outputs[0].name.c_str());
+    EXPECT_EQ(-1, sort_dlt_files(truth.files, outputs));
+    EXPECT_TRUE(ref == read_file(outputs[0].name.c_str()));
+    
+    remove(ref_name.c_str());
+    remove(outputs[0].name.c_str());
+    remove(outputs[1].name.c_str());
+    for (size_t i=0; i<truth.files.size(); ++i) remove(truth.files[i].c_str());
+}
+
+TEST(Generator, bytes_written) {
+    // all bytes of all files incl. garbage and the msgs repeated after rotation:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.corrupt_ratio = 0.05;
+    opts.rotate_bytes = 100000;
+    opts.rotate_overlap = 5;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_gen_bytes", 2, 1, 2000, truth, &opts));
+    ASSERT_LT(0, truth.nr_garbage);
+    ASSERT_LT(0, truth.nr_duplicates);
+    uint64_t file_bytes = 0;
+    for (size_t i=0; i<truth.files.size(); ++i){
+        file_bytes += read_file(truth.files[i].c_str()).size();
+        remove(truth.files[i].c_str());
+    }
+    EXPECT_EQ(file_bytes, truth.bytes_written);
+}
+
+TEST(Generator, lifecycle_detection) {
+    // generate a small corpus and check the detected lifecycles/skew against the ground truth:
+    Gen_Options opts;
+    init_Gen_Options(opts);
+    opts.skew_min = 0.995;
+    opts.skew_max = 1.005;
+    Gen_Truth truth;
+    ASSERT_EQ(0, make_corpus("/tmp/dlt_sort_unittest_gen", 3, 2, 3000, truth, &opts));
+    ASSERT_EQ(1, truth.files.size());
+    ASSERT_EQ(2, truth.nr_overall_lcs);
+    
+    std::ifstream fin(truth.files[0].c_str(), std::ios::in|std::ios::binary);
+    ASSERT_TRUE(fin.is_open());
+    ASSERT_EQ(0, process_input(fin));
+    fin.close();
+    remove(truth.files[0].c_str());
+    ASSERT_EQ(3, map_ecus.size());
+    size_t i=0;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!= map_ecus.end(); ++it, ++i){
+        ECU_Info &info = it->second;
+        const Gen_ECU_Truth &t = truth.ecus[i];
+        ASSERT_EQ(0, memcmp(&it->first, t.ecu.c_str(), 4));
+        determine_lcs(info);
+        determine_clock_skew(info);
+        merge_lcs(info);
+        sort_msgs_lcs(info);
+        ASSERT_EQ(t.lcs.size(), info.lcs.size());
+        for (LIST_OF_LCS::iterator lit=info.lcs.begin(); lit!=info.lcs.end(); ++lit){
+            EXPECT_NEAR(t.skew, (*lit).clock_skew, 0.0005);
+            bool found=false;
+            for (size_t j=0; j<t.lcs.size(); ++j){
+                if (std::abs((double)((*lit).usec_begin - t.lcs[j].begin_usec)) < 10000.0){ // 10ms
+                    found=true;
+                    EXPECT_EQ(t.lcs[j].nr_msgs, (*lit).msgs.size());
+                    EXPECT_NEAR((double)t.lcs[j].end_usec, (double)(*lit).usec_end, 20000.0);
+                }
+            }
+            EXPECT_TRUE(found);
+        }
+    }
+    determine_overall_lcs();
+    EXPECT_EQ(truth.nr_overall_lcs, list_olcs.size());
+    list_olcs.clear();
+    map_ecus.clear();
+    msg_arena.release();
+}
+
 int main(int argc, char **argv){
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,462 @@
+//
+//  async_read.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <deque>
+#endif
+#endif
+#include "async_read.h"
+
+using namespace std;
+
+int use_io_uring = 0; // by default read with one blocking read after the other
+
+Block_Streambuf::~Block_Streambuf()
+{
+    // the blocks of this file need to be consumed even if the parsing stopped early:
+    while (next_block()) {};
+    delete block;
+}
+
+Block_Streambuf::int_type Block_Streambuf::underflow()
+{
+    while (gptr()==egptr()){
+        if (!next_block()) return traits_type::eof();
+    }
+    return traits_type::to_int_type(*gptr());
+}
+
+Block_Streambuf::pos_type Block_Streambuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode)
+{
+    int64_t cur = pending_pos>=0 ? pending_pos : block_pos + (gptr()-eback());
+    if (dir==std::ios_base::beg) return seek_to(off);
+    if (dir==std::ios_base::cur) return seek_to(cur+off);
+    return seek_to(file_size+off);
+}
+
+Block_Streambuf::pos_type Block_Streambuf::seekpos(pos_type pos, std::ios_base::openmode)
+{
+    return seek_to(pos);
+}
+
+Block_Streambuf::pos_type Block_Streambuf::seek_to(int64_t pos)
+{
+    int64_t avail_end = block_pos + (egptr()-eback());
+    if (pos<0 || pos>file_size) return pos_type(off_type(-1));
+    if (pos>=block_pos && pos<=avail_end){
+        setg(eback(), eback()+(pos-block_pos), egptr());
+        pending_pos = -1;
+    }else if (pos>avail_end){
+        // skip until the block containing pos is there:
+        setg(eback(), egptr(), egptr());
+        pending_pos = pos;
+    }else
+        return pos_type(off_type(-1)); // the data is gone already
+    return pos_type(pos);
+}
+
+bool Block_Streambuf::next_block()
+{
+    if (at_end) return false;
+    Read_Block rb;
+    if (!queue.pop(rb)) rb.data = 0; // reader stopped
+    delete block;
+    block = rb.data;
+    if (!block){
+        at_end = true;
+        setg(0, 0, 0);
+        block_pos = file_size;
+        pending_pos = -1;
+        return false;
+    }
+    block_pos = rb.offset;
+    char *b = &(*block)[0];
+    char *e = b + block->size();
+    if (pending_pos>=0){
+        if (pending_pos < block_pos+(int64_t)block->size()){
+            setg(b, b+(pending_pos-block_pos), e);
+            pending_pos = -1;
+        }else
+            setg(b, e, e); // skip the whole block
+    }else
+        setg(b, b, e);
+    return true;
+}
+
+int get_input_sizes(std::vector<std::string> const &ifiles, std::vector<int64_t> &sizes)
+{
+    sizes.clear();
+    for (size_t i=0; i<ifiles.size(); ++i){
+        std::ifstream f(ifiles[i].c_str(), ios::in|ios::binary);
+        if (!f.is_open()){
+            cerr << "can't open <" << ifiles[i] << "> as file for input!\n";
+            return -1;
+        }
+        f.seekg(0, f.end);
+        sizes.push_back((int64_t)f.tellg());
+    }
+    return 0;
+}
+
+static int read_files_blocking(std::vector<std::string> const &ifiles, SPSC_Queue<Read_Block> &queue)
+{
+    int ret = 0;
+    for (size_t i=0; i<ifiles.size(); ++i){
+        Trace_Span span("read_file", "task", ifiles[i].c_str());
+        std::ifstream f(ifiles[i].c_str(), ios::in|ios::binary);
+        if (!f.is_open()){
+            cerr << "can't open <" << ifiles[i] << "> as file for input!\n";
+            ret = -1;
+        }
+        Read_Block rb;
+        rb.offset = 0;
+        while (f.good()){
+            rb.data = new std::vector<char>(read_block_size);
+            f.read(&(*rb.data)[0], read_block_size);
+            size_t n = (size_t)f.gcount();
+            if (!n){
+                delete rb.data;
+                break;
+            }
+            rb.data->resize(n);
+            queue.push(rb);
+            rb.offset += n;
+        }
+        if (f.bad()){
+            cerr << "reading <" << ifiles[i] << "> failed!\n";
+            ret = -1;
+        }
+        rb.data = 0; // end of this file
+        queue.push(rb);
+    }
+    return ret;
+}
+
+#ifdef HAVE_IO_URING
+
+/* minimal io_uring (via the raw syscalls, so no liburing needed).
+ Only this (the reader) thread submits and reaps. The kernel reads the sq
+ tail and writes the cq tail so these are accessed with acquire/release. */
+class Uring{
+public:
+    Uring() : fd(-1), sq_ptr(0), cq_ptr(0), sqes(0), sq_map_size(0), cq_map_size(0), sqes_map_size(0), to_submit(0) {}
+    ~Uring();
+    bool init(unsigned int entries); // false if io_uring is not available
+    bool prep_readv(int rfd, struct iovec *iov, int64_t offset, void *user_data); // false if the sq is full
+    int enter(unsigned int min_complete); // submits the prepared sqes. <0 = -errno
+    bool reap(void *&user_data, int &res); // false if no completion available
+private:
+    Uring(const Uring&); // not copyable
+    Uring &operator=(const Uring&);
+    // member vars:
+    int fd;
+    void *sq_ptr;
+    void *cq_ptr;
+    struct io_uring_sqe *sqes;
+    size_t sq_map_size;
+    size_t cq_map_size;
+    size_t sqes_map_size;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_entries;
+    unsigned int *sq_array;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+    unsigned int to_submit;
+};
+
+Uring::~Uring()
+{
+    if (sqes) munmap(sqes, sqes_map_size);
+    if (cq_ptr && cq_ptr!=sq_ptr) munmap(cq_ptr, cq_map_size);
+    if (sq_ptr) munmap(sq_ptr, sq_map_size);
+    if (fd>=0) close(fd);
+}
+
+bool Uring::init(unsigned int entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (fd<0) return false; // e.g. ENOSYS (old kernel) or EPERM (disabled or seccomp)
+    sq_map_size = p.sq_off.array + p.sq_entries*sizeof(unsigned int);
+    cq_map_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP)!=0;
+    if (single_mmap) sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+    void *ptr = mmap(0, sq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ptr==MAP_FAILED) return false;
+    sq_ptr = ptr;
+    if (single_mmap) cq_ptr = sq_ptr;
+    else{
+        ptr = mmap(0, cq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ptr==MAP_FAILED) return false;
+        cq_ptr = ptr;
+    }
+    sqes_map_size = p.sq_entries*sizeof(struct io_uring_sqe);
+    ptr = mmap(0, sqes_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ptr==MAP_FAILED) return false;
+    sqes = (struct io_uring_sqe *)ptr;
+
+    char *sq = (char*)sq_ptr;
+    sq_head = (unsigned int*)(sq + p.sq_off.head);
+    sq_tail = (unsigned int*)(sq + p.sq_off.tail);
+    sq_mask = (unsigned int*)(sq + p.sq_off.ring_mask);
+    sq_entries = (unsigned int*)(sq + p.sq_off.ring_entries);
+    sq_array = (unsigned int*)(sq + p.sq_off.array);
+    char *cq = (char*)cq_ptr;
+    cq_head = (unsigned int*)(cq + p.cq_off.head);
+    cq_tail = (unsigned int*)(cq + p.cq_off.tail);
+    cq_mask = (unsigned int*)(cq + p.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return true;
+}
+
+bool Uring::prep_readv(int rfd, struct iovec *iov, int64_t offset, void *user_data)
+{
+    unsigned int tail = *sq_tail;
+    if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= *sq_entries) return false;
+    unsigned int idx = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = IORING_OP_READV; // IORING_OP_READ needs 5.6. READV works since 5.1
+    sqe->fd = rfd;
+    sqe->addr = (uint64_t)(uintptr_t)iov;
+    sqe->len = 1;
+    sqe->off = (uint64_t)offset;
+    sqe->user_data = (uint64_t)(uintptr_t)user_data;
+    sq_array[idx] = idx;
+    __atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+    ++to_submit;
+    return true;
+}
+
+int Uring::enter(unsigned int min_complete)
+{
+    for(;;){
+        int r = (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (r>=0){
+            to_submit -= (unsigned int)r;
+            return r;
+        }
+        if (errno!=EINTR) return -errno;
+    }
+}
+
+bool Uring::reap(void *&user_data, int &res)
+{
+    unsigned int head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+    struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+    user_data = (void*)(uintptr_t)cqe->user_data;
+    res = cqe->res;
+    __atomic_store_n(cq_head, head+1, __ATOMIC_RELEASE);
+    return true;
+}
+
+typedef struct{
+    size_t file_idx;
+    std::vector<char> *data; // NULL = end of the file
+    int64_t offset;
+    size_t done; // bytes read so far
+    bool complete;
+    struct iovec iov; // of the remaining part
+} Uring_Read;
+
+static bool submit_read(Uring &ring, int fd, Uring_Read *r)
+{
+    r->iov.iov_base = &(*r->data)[r->done];
+    r->iov.iov_len = r->data->size() - r->done;
+    return ring.prep_readv(fd, &r->iov, r->offset + (int64_t)r->done, r);
+}
+
+/* keeps up to uring_reads_in_flight blocks in flight. Once the blocks of a file
+ are all submitted the next file is opened, so the reads continue across the files.
+ The blocks complete in any order but are passed to the queue in file order. */
+static int read_files_uring(Uring &ring, std::vector<std::string> const &ifiles, SPSC_Queue<Read_Block> &queue)
+{
+    Trace_Span span("read_files", "task", "io_uring");
+    std::vector<int> fds(ifiles.size(), -1);
+    std::vector<bool> failed(ifiles.size(), false);
+    std::deque<Uring_Read *> reads; // in file order
+    size_t in_flight = 0;
+    size_t next_file = 0;
+    int64_t next_offset = 0;
+    int64_t next_file_size = -1;
+    int ret = 0;
+
+    while (next_file<ifiles.size() || reads.size()){
+        // submit new reads (and end of file markers) up to the limit:
+        while (next_file<ifiles.size() && reads.size()<uring_reads_in_flight){
+            if (next_file_size<0){
+                int fd = open(ifiles[next_file].c_str(), O_RDONLY|O_CLOEXEC);
+                struct stat st;
+                if (fd>=0 && fstat(fd, &st)==0){
+                    fds[next_file] = fd;
+                    next_file_size = st.st_size;
+                }else{
+                    if (fd>=0) close(fd);
+                    cerr << "can't open <" << ifiles[next_file] << "> as file for input!\n";
+                    failed[next_file] = true;
+                    next_file_size = 0;
+                }
+                next_offset = 0;
+            }
+            Uring_Read *r = new Uring_Read;
+            r->file_idx = next_file;
+            r->offset = next_offset;
+            r->done = 0;
+            if (next_offset >= next_file_size){
+                r->data = 0;
+                r->complete = true;
+                ++next_file;
+                next_file_size = -1;
+            }else{
+                size_t len = (size_t)std::min<int64_t>(read_block_size, next_file_size-next_offset);
+                r->data = new std::vector<char>(len);
+                r->complete = false;
+                if (!submit_read(ring, fds[next_file], r)){
+                    delete r->data;
+                    delete r;
+                    break; // sq full. try after the next completions
+                }
+                ++in_flight;
+                next_offset += (int64_t)len;
+            }
+            reads.push_back(r);
+        }
+
+        // wait only if the next block (in file order) is not there yet:
+        bool wait = reads.size() && !reads.front()->complete && in_flight;
+        int r = ring.enter(wait ? 1 : 0);
+        if (r<0){
+            cerr << "io_uring_enter failed with " << -r << "!\n";
+            ret = -1;
+            break;
+        }
+
+        void *user_data;
+        int res;
+        while (ring.reap(user_data, res)){
+            Uring_Read *rd = (Uring_Read *)user_data;
+            --in_flight;
+            if (res==-EAGAIN || res==-EINTR) res = 0; // just retry
+            else if (res<=0){
+                // error or the file got shorter. So we stop this file:
+                if (!failed[rd->file_idx] && res<0)
+                    cerr << "reading <" << ifiles[rd->file_idx] << "> failed with " << -res << "!\n";
+                failed[rd->file_idx] = true;
+                rd->data->resize(rd->done);
+                rd->complete = true;
+                continue;
+            }
+            rd->done += (size_t)res;
+            if (rd->done < rd->data->size()){
+                // short read. the rest needs another one:
+                if (submit_read(ring, fds[rd->file_idx], rd)) ++in_flight;
+                else{
+                    rd->data->resize(rd->done);
+                    failed[rd->file_idx] = true;
+                    rd->complete = true;
+                }
+            }else
+                rd->complete = true;
+        }
+
+        // pass the completed blocks in file order:
+        while (reads.size() && reads.front()->complete){
+            Uring_Read *rd = reads.front();
+            reads.pop_front();
+            Read_Block rb;
+            rb.data = rd->data;
+            rb.offset = rd->offset;
+            if (!rb.data){
+                if (fds[rd->file_idx]>=0) close(fds[rd->file_idx]);
+                fds[rd->file_idx] = -1;
+                queue.push(rb);
+            }else if (rb.data->size() && !failed[rd->file_idx])
+                queue.push(rb);
+            else
+                delete rb.data; // we don't pass data behind a gap
+            delete rd;
+        }
+    }
+
+    if (ret){
+        // the kernel might still write to the buffers of the reads in flight. So we leak those.
+        while (reads.size()){
+            Uring_Read *rd = reads.front();
+            reads.pop_front();
+            if (rd->complete){
+                delete rd->data;
+                delete rd;
+            }
+        }
+        // the parser sees the end of the remaining files once the queue is closed:
+        for (size_t i=0; i<fds.size(); ++i)
+            if (fds[i]>=0) close(fds[i]);
+    }
+    for (size_t i=0; i<failed.size(); ++i)
+        if (failed[i]) ret = -1;
+    return ret;
+}
+
+#endif
+
+void read_files(std::vector<std::string> const *ifiles, SPSC_Queue<Read_Block> *queue, int *error)
+{
+    // the files are passed up to an error. The parser gets the error after joining this thread:
+#ifdef HAVE_IO_URING
+    if (use_io_uring){
+        Uring ring;
+        if (ring.init(uring_reads_in_flight)){
+            if (verbose) cout << " reading with io_uring (" << uring_reads_in_flight << " reads in flight)\n";
+            *error = read_files_uring(ring, *ifiles, *queue);
+            queue->close();
+            return;
+        }
+        if (verbose) cout << " io_uring not available. Reading with blocking reads.\n";
+    }
+#else
+    if (use_io_uring && verbose) cout << " io_uring not supported. Reading with blocking reads.\n";
+#endif
+    *error = read_files_blocking(*ifiles, *queue);
+    queue->close();
+}
+
+int parse_read_ahead(std::vector<std::string> const &ifiles, Sort_Stats *stats)
+{
+    std::vector<int64_t> sizes;
+    if (get_input_sizes(ifiles, sizes)) return -1;
+
+    SPSC_Queue<Read_Block> read_queue(read_queue_blocks);
+    int read_error = 0;
+    std::thread reader(read_files, &ifiles, &read_queue, &read_error);
+    for (size_t i=0; i<ifiles.size(); ++i){
+        Trace_Span span("parse_file", "task", ifiles[i].c_str());
+        printf("Processing file %s:\n", ifiles[i].c_str());
+        Block_Streambuf buf(read_queue, sizes[i]);
+        std::istream fin(&buf);
+        (void)process_input(fin, stats ? &stats->parse : 0, (int)i); // and ignore parsing errors. just continue with next file
+        if (stats) stats->bytes_read += sizes[i];
+    }
+    reader.join();
+    return read_error;
+}
@@ -0,0 +1,66 @@
+//
+//  async_read.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_async_read_h
+#define dlt_sort_async_read_h
+
+#include <stddef.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+#include "pipeline.h"
+
+/* reading the input files in blocks ahead of the parser (--io_uring and --pipeline):
+ A reader thread passes the blocks of all files (one file after the other)
+ via a SPSC_Queue to the parser. With --io_uring (Linux) the reader keeps many
+ reads in flight across the next files so that e.g. network storage gets a
+ full queue. If io_uring is not available (older kernel, not allowed or
+ other OS) it reads one block after the other with blocking reads. */
+
+extern int use_io_uring;
+
+typedef struct{
+    std::vector<char> *data; // NULL = end of the file
+    int64_t offset; // of data within the file
+} Read_Block;
+
+const size_t read_block_size = 1<<20;
+const size_t read_queue_blocks = 8; // i.e. max. 8MB read ahead (plus the reads in flight)
+const unsigned int uring_reads_in_flight = 32;
+
+/* reads the blocks of one file from the reader thread.
+ Supports the seeks process_input does: to the end (just to determine the
+ size), back to the begin (if nothing was read yet) and forward. */
+class Block_Streambuf : public std::streambuf{
+public:
+    Block_Streambuf(SPSC_Queue<Read_Block> &q, int64_t size) : queue(q), file_size(size), block(0), block_pos(0), pending_pos(-1), at_end(false) {}
+    ~Block_Streambuf();
+protected:
+    int_type underflow();
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode);
+    pos_type seekpos(pos_type pos, std::ios_base::openmode);
+private:
+    Block_Streambuf(const Block_Streambuf&); // not copyable
+    Block_Streambuf &operator=(const Block_Streambuf&);
+    pos_type seek_to(int64_t pos);
+    bool next_block();
+    // member vars:
+    SPSC_Queue<Read_Block> &queue;
+    int64_t file_size;
+    std::vector<char> *block; // the current one
+    int64_t block_pos; // file offset of the current block
+    int64_t pending_pos; // >=0 if we seeked behind the current block
+    bool at_end;
+};
+
+int get_input_sizes(std::vector<std::string> const &ifiles, std::vector<int64_t> &sizes); // 0 if all files can be opened
+void read_files(std::vector<std::string> const *ifiles, SPSC_Queue<Read_Block> *queue, int *error); // the reader thread. Closes the queue at the end. error: set to -1 if a file couldn't be read completely
+int parse_read_ahead(std::vector<std::string> const &ifiles, Sort_Stats *stats=0); // process_input of one file after the other from the reader thread. 0 = success
+
+#endif
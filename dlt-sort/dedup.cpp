@@ -0,0 +1,167 @@
+//
+//  dedup.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <string.h>
+#include "dedup.h"
+#include "thread_pool.h"
+#include "mem_budget.h"
+
+using namespace std;
+
+int use_dedup = 0; // by default all msgs are kept
+
+// FNV-1a:
+const uint64_t fnv_offset = 14695981039346656037ULL;
+const uint64_t fnv_prime = 1099511628211ULL;
+
+static inline uint64_t hash_bytes(uint64_t h, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i=0; i<len; ++i){
+        h ^= p[i];
+        h *= fnv_prime;
+    }
+    return h;
+}
+
+/* the payload of a msg. Read into buf if only referenced (see mem_budget.h) or
+ compressed (see payload_blocks.h). false if it can't be read. */
+static bool get_payload(const DltMessage &msg, std::vector<unsigned char> &buf, Payload_Block_Cache *blocks, const unsigned char *&payload)
+{
+    payload = 0;
+    if (msg.databuffersize<=0) return true;
+    if (!(msg.found_serialheader & (DLT_SORT_MSG_PAYLOAD_REF|DLT_SORT_MSG_PAYLOAD_BLOCK))){
+        payload = msg.databuffer;
+        return true;
+    }
+    buf.resize((size_t)msg.databuffersize);
+    bool ok;
+    if (msg.found_serialheader & DLT_SORT_MSG_PAYLOAD_REF)
+        ok = read_payload(msg, &buf[0]);
+    else if (blocks){
+        // copied as the next use of the cache might replace the block:
+        const unsigned char *p = blocks->payload(msg);
+        ok = p!=0;
+        if (ok) memcpy(&buf[0], p, buf.size());
+    }else
+        ok = read_block_payload(msg, &buf[0]);
+    if (ok) payload = &buf[0];
+    return ok;
+}
+
+uint64_t hash_message(const DltMessage &msg, Payload_Block_Cache *blocks, bool *readable)
+{
+    uint8_t htyp = msg.standardheader->htyp;
+    uint64_t h = hash_bytes(fnv_offset, msg.standardheader, sizeof(*msg.standardheader)); // htyp, mcnt, len
+    if (DLT_IS_HTYP_WEID(htyp)) h = hash_bytes(h, msg.headerextra.ecu, DLT_SIZE_WEID);
+    if (DLT_IS_HTYP_WSID(htyp)) h = hash_bytes(h, &msg.headerextra.seid, sizeof(msg.headerextra.seid));
+    if (DLT_IS_HTYP_WTMS(htyp)) h = hash_bytes(h, &msg.headerextra.tmsp, sizeof(msg.headerextra.tmsp));
+    if (DLT_IS_HTYP_UEH(htyp)) h = hash_bytes(h, msg.extendedheader, sizeof(*msg.extendedheader));
+    std::vector<unsigned char> buf;
+    const unsigned char *payload;
+    bool ok = get_payload(msg, buf, blocks, payload);
+    if (payload) h = hash_bytes(h, payload, (size_t)msg.databuffersize);
+    if (readable) *readable = ok;
+    return h;
+}
+
+bool equal_messages(const DltMessage &a, const DltMessage &b, Payload_Block_Cache *blocks)
+{
+    if (memcmp(a.standardheader, b.standardheader, sizeof(*a.standardheader))) return false;
+    uint8_t htyp = a.standardheader->htyp;
+    if (DLT_IS_HTYP_WEID(htyp) && memcmp(a.headerextra.ecu, b.headerextra.ecu, DLT_SIZE_WEID)) return false;
+    if (DLT_IS_HTYP_WSID(htyp) && a.headerextra.seid != b.headerextra.seid) return false;
+    if (DLT_IS_HTYP_WTMS(htyp) && a.headerextra.tmsp != b.headerextra.tmsp) return false;
+    if (DLT_IS_HTYP_UEH(htyp) && memcmp(a.extendedheader, b.extendedheader, sizeof(*a.extendedheader))) return false;
+    if (a.databuffersize != b.databuffersize) return false;
+    std::vector<unsigned char> buf_a, buf_b;
+    const unsigned char *pa, *pb;
+    if (!get_payload(a, buf_a, blocks, pa) || !get_payload(b, buf_b, blocks, pb)) return false; // we can't tell
+    return !pa || !memcmp(pa, pb, (size_t)a.databuffersize);
+}
+
+Msg_Hash_Set::Msg_Hash_Set(size_t max_msgs) : nr_msgs(0), unreadable(0)
+{
+    size_t nr_slots = 16;
+    while (nr_slots < 2*max_msgs) nr_slots <<= 1;
+    tags.resize(nr_slots);
+    msgs.resize(nr_slots, 0);
+    mask = nr_slots-1;
+}
+
+bool Msg_Hash_Set::insert(const DltMessage *msg)
+{
+    bool readable;
+    uint64_t h = hash_message(*msg, &blocks, &readable);
+    if (!readable){ // kept as we can't compare it
+        ++unreadable;
+        return true;
+    }
+    uint32_t tag = (uint32_t)(h>>32);
+    for (size_t i = (size_t)h & mask;; i = (i+1) & mask){
+        if (!msgs[i]){
+            assert(nr_msgs < mask); // we need at least one empty slot
+            tags[i] = tag;
+            msgs[i] = msg;
+            ++nr_msgs;
+            return true;
+        }
+        if (tags[i]==tag && equal_messages(*msgs[i], *msg, &blocks)) return false;
+    }
+}
+
+static int64_t remove_duplicates(Lifecycle &lc, size_t &nr_unreadable)
+{
+    Msg_Hash_Set set(lc.msgs.size());
+    int64_t nr_removed = 0;
+    for (LIST_OF_MSGS::iterator it = lc.msgs.begin(); it!=lc.msgs.end();){
+        if (set.insert(*it))
+            ++it;
+        else{
+            (*it)->found_serialheader |= DLT_SORT_MSG_DUPLICATE;
+            it = lc.msgs.erase(it);
+            ++nr_removed;
+        }
+    }
+    nr_unreadable = set.nr_unreadable();
+    return nr_removed;
+}
+
+int64_t remove_duplicates(ECU_Info &ecu, ThreadPool *pool)
+{
+    std::vector<Lifecycle *> lcs_v;
+    for (LIST_OF_LCS::iterator it = ecu.lcs.begin(); it!=ecu.lcs.end(); ++it)
+        lcs_v.push_back(&(*it));
+    std::vector<int64_t> nr_removed(lcs_v.size(), 0);
+    std::vector<size_t> nr_unreadable(lcs_v.size(), 0);
+    std::function<void(size_t)> dedup_lc = [&](size_t i){
+        Trace_Span span("dedup_lc", "task");
+        nr_removed[i] = remove_duplicates(*lcs_v[i], nr_unreadable[i]);
+    };
+    if (pool)
+        pool->parallel_for(lcs_v.size(), dedup_lc);
+    else
+        for (size_t i=0; i<lcs_v.size(); ++i) dedup_lc(i);
+    
+    int64_t total = 0;
+    size_t unreadable = 0;
+    for (size_t i=0; i<nr_removed.size(); ++i){
+        total += nr_removed[i];
+        unreadable += nr_unreadable[i];
+    }
+    if (unreadable) cerr << "can't read the payload of " << unreadable << " msgs. Kept them without checking for duplicates!\n";
+    if (total){
+        for (LIST_OF_MSGS::iterator j = ecu.msgs.begin(); j!=ecu.msgs.end();){
+            if ((*j)->found_serialheader & DLT_SORT_MSG_DUPLICATE)
+                j = ecu.msgs.erase(j); // the msg itself is freed with the arena
+            else
+                ++j;
+        }
+    }
+    return total;
+}
@@ -0,0 +1,51 @@
+//
+//  dedup.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_dedup_h
+#define dlt_sort_dedup_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "dlt-sort.h"
+#include "payload_blocks.h"
+
+/* removal of duplicate msgs (--dedup):
+ Overlapping captures of the same ECU (e.g. from two loggers or rotated files
+ that repeat their tail) contain the same msgs multiple times. Two msgs are
+ duplicates if ecu id, session id, tmsp, mcnt, the headers and the payload are
+ equal. The storage header is ignored as it differs between the loggers.
+ Duplicates end up in the same lifecycle so only the lcs are searched. */
+
+extern int use_dedup;
+
+uint64_t hash_message(const DltMessage &msg, Payload_Block_Cache *blocks=0, bool *readable=0); // blocks: to decompress the payload (if in a block). readable: false if the payload can't be read
+bool equal_messages(const DltMessage &a, const DltMessage &b, Payload_Block_Cache *blocks=0); // false if a payload can't be read
+
+/* open-addressing (linear probing) hash set of msgs. The size is fixed at
+ construction (load factor <= 0.5). Per slot only a part of the hash and the
+ msg ptr are kept. Equal hashes are confirmed by comparing the msgs. */
+class Msg_Hash_Set{
+public:
+    explicit Msg_Hash_Set(size_t max_msgs);
+    bool insert(const DltMessage *msg); // false if an equal msg is contained already. Msgs with an unreadable payload are never equal (and not inserted)
+    size_t size() const { return nr_msgs; }
+    size_t nr_unreadable() const { return unreadable; }
+private:
+    std::vector<uint32_t> tags; // upper 32 bits of the hash
+    std::vector<const DltMessage *> msgs; // NULL = empty slot
+    size_t mask;
+    size_t nr_msgs;
+    size_t unreadable; // msgs with a payload that couldn't be read
+    Payload_Block_Cache blocks; // of the compressed payloads (in order of arrival as the msgs)
+};
+
+class ThreadPool;
+int64_t remove_duplicates(ECU_Info &ecu, ThreadPool *pool=0); // keeps the first one in order of arrival. Call before sorting. Returns the nr of removed msgs
+
+#endif
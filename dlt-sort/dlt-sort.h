@@ -19,12 +19,15 @@
 #include <string>
 #include <list>
 #include <map>
+#include <set>
 #include <vector>
 
 #include <dlt/dlt_common.h>
+#include "trace_events.h"
 
 #ifdef WIN32 // M$ doesnt seem to like (yet) snprintf
 #define snprintf _snprintf_s
+#define ctime_r(t, buf) (ctime_s(buf, 26, t), buf)
 #endif
 
 const int64_t usecs_per_sec = 1000000;
@@ -34,11 +37,24 @@ const int64_t usecs_per_tmsp = 100;
 const int DLT_HEADER_VERSION_MIN = 1;
 const int DLT_HEADER_VERSION_MAX = 1;
 
+extern const char* const dlt_sort_version;
+
 extern int verbose;
 extern int trust_logger_time;
 extern int use_max_earlier_sanity_check;
 extern int64_t max_earlier_begin_usec;
 extern int use_clock_drift_detection;
+extern int use_skew_per_lc;
+extern int use_fast_skew;
+extern int nr_jobs;
+extern int use_mmap_output;
+
+/* we don't use the serial header detection from the dlt lib. So we use the
+ found_serialheader member to keep some flags per message: */
+const int8_t DLT_SORT_MSG_FILTERED = 0x01; // header-only record of a filtered msg. Used for lifecycle detection only. Never output.
+const int8_t DLT_SORT_MSG_PAYLOAD_REF = 0x02; // databuffer points to a Payload_Ref (see mem_budget.h) instead of the payload
+const int8_t DLT_SORT_MSG_DUPLICATE = 0x04; // removed by --dedup (see dedup.h)
+const int8_t DLT_SORT_MSG_PAYLOAD_BLOCK = 0x08; // databuffer points to the ref of a compressed block (see payload_blocks.h) instead of the payload
 
 /* type definitions */
 
@@ -46,11 +62,12 @@ typedef std::list<DltMessage *> LIST_OF_MSGS;
 
 class Lifecycle{
 public:
-    Lifecycle() : usec_begin(0), usec_end(0), rel_offset_valid(false), min_tmsp(0), max_tmsp(0), clock_skew(1.0f) {};
+    Lifecycle() : usec_begin(0), usec_end(0), rel_offset_valid(false), min_tmsp(0), max_tmsp(0), clock_skew(1.0f), shard_lc(-1) {};
     Lifecycle(const DltMessage &);
-    void debug_print() const;
+    void debug_print(std::ostream &os = std::cout) const;
     bool fitsin(const DltMessage &); // function is non const. modifies the lifecycle
     void set_clock_skew(double new_skew); // non const! adjusts even usec_begin, usec_end
+    void set_clock_skew(double new_skew, int64_t new_begin); // if the begin for new_skew is known already
     int64_t calc_min_time() const;
     int64_t determine_max_latency(int64_t begin=-1, double skew=-1.0) const;
     double determine_clock_skew() const;
@@ -66,7 +83,7 @@ public:
     uint32_t max_tmsp;
     // clock skew support:
     double clock_skew;
-    
+    int shard_lc; // --reduce: index of the intermediate file with the msgs (see shard.h). -1 = msgs are in the list
 };
 typedef std::list<Lifecycle> LIST_OF_LCS;
 
@@ -76,12 +93,53 @@ typedef struct{
 } ECU_Info;
 typedef std::map<uint32_t, ECU_Info> MAP_OF_ECUS;
 
+/* assigns the msgs of an ECU (in order of arrival) to lifecycles.
+ Used by determine_lcs and by the pipeline while parsing. */
+class LC_Detector{
+public:
+    LC_Detector(LIST_OF_LCS &l) : lcs(l), cur_l(l.end()), prev_msg(0) {}
+    void add(DltMessage *msg);
+    const DltMessage *last_msg() const { return cur_l==lcs.end() ? 0 : (*cur_l).msgs.back(); } // of the last matching lifecycle
+private:
+    LIST_OF_LCS &lcs;
+    LIST_OF_LCS::iterator cur_l; // the last matching lifecycle
+    DltMessage *prev_msg;
+};
+
+typedef std::set<uint32_t> SET_OF_IDS;
+typedef struct{
+    SET_OF_IDS incl_ecus; // if not empty only these ECUs are kept
+    SET_OF_IDS excl_ecus;
+    SET_OF_IDS incl_apids; // if not empty only these APIDs are kept
+    SET_OF_IDS excl_apids;
+    SET_OF_IDS incl_ctids; // if not empty only these CTIDs are kept
+    SET_OF_IDS excl_ctids;
+    int max_log_level; // 0 = all. Otherwise log msgs with a less severe level (higher value) are filtered.
+} Msg_Filter;
+
+enum Filter_Result{
+    FILTER_KEEP=0, // keep the full msg
+    FILTER_HEADER_ONLY, // keep only the header for the lifecycle detection (payload is skipped)
+    FILTER_DROP // drop the msg completely
+};
+
+typedef struct{
+    DltMessage *msg;
+    int64_t usec_begin; // of the lifecycle the msg belongs to
+    double clock_skew; // of the lifecycle the msg belongs to
+} Out_Msg;
+typedef std::vector<Out_Msg> VEC_OF_OUT_MSGS;
+
+class Nav_Index_Writer;
+
 class OverallLC{
 public:
     OverallLC():usec_begin(0), usec_end(0) {};
     OverallLC(const Lifecycle&);
     bool expand_if_intersects(const Lifecycle &);
-    bool output_to_fstream(std::ofstream &f, bool timeadjust);
+    void determine_output_order(VEC_OF_OUT_MSGS &order);
+    size_t nr_msgs() const;
+    bool output_to_fstream(std::ofstream &f, bool timeadjust, Nav_Index_Writer *index=0); // index: of f (see nav_index.h). Doesn't change the msgs
     void debug_print() const;
     // member vars:
     int64_t usec_begin;
@@ -91,6 +149,92 @@ public:
 };
 typedef std::list<OverallLC> LIST_OF_OLCS;
 
+typedef struct{
+    int64_t nr_msgs; // msgs parsed (incl. filtered ones)
+    int64_t nr_filtered;
+    int64_t nr_skipped; // msgs with a wrong header version or length
+    int64_t resync_bytes; // bytes skipped to find the next storageheader pattern
+    int64_t nr_payload_refs; // msgs with the payload kept in the input file (see --mem_limit)
+    int64_t payload_bytes_raw; // payloads kept in compressed blocks (see --compress_payloads)
+    int64_t payload_bytes_compressed; // size of these blocks
+} Parse_Stats;
+
+enum Sort_Stage{
+    STAGE_PARSE=0,
+    STAGE_LCS, // lifecycle detection
+    STAGE_SKEW,
+    STAGE_MERGE,
+    STAGE_SORT,
+    STAGE_OVERALL_LCS,
+    STAGE_OUTPUT,
+    NR_STAGES
+};
+extern const char * const sort_stage_names[NR_STAGES];
+
+typedef struct{
+    int64_t msgs; // msg records in the arena
+    int64_t payloads; // payloads (or payload refs) in the arena
+    int64_t list_nodes; // nodes of all msg lists (ecu msgs, lifecycles, overall lifecycles)
+    int64_t lcs; // ECU, lifecycle and overall lifecycle structures
+    int64_t arena_reserved; // chunks reserved by the arena (>= msgs+payloads)
+} Mem_Usage;
+
+typedef struct{
+    double wall_secs;
+    double cpu_secs; // of the whole process (i.e. all threads)
+    Mem_Usage mem; // at the end of the stage
+} Stage_Time;
+
+typedef struct{
+    uint32_t ecu;
+    int64_t nr_msgs; // output (i.e. not filtered)
+    size_t nr_lcs; // detected
+    size_t nr_lcs_merged; // after merge
+    double clock_skew; // of the first lifecycle
+    std::vector<double> lc_clock_skews; // of each lifecycle with --skew_per_lc
+    int64_t skew_error_usecs; // of --fast_skew (0 otherwise)
+    int64_t nr_duplicates; // removed by --dedup
+} ECU_Stats;
+
+typedef struct{
+    int64_t nr_msgs; // output (i.e. not filtered)
+    int64_t nr_duplicates; // removed by --dedup
+    int64_t bytes_read;
+    int64_t bytes_written;
+    size_t nr_olcs;
+    int64_t peak_rss_bytes; // 0 if unknown
+    Parse_Stats parse;
+    Stage_Time stages[NR_STAGES];
+    Stage_Time total; // the whole run (measured by Run_Clock. The stages don't cover e.g. the cleanup)
+    std::vector<ECU_Stats> ecus;
+} Sort_Stats;
+
+/* adds the elapsed wall and cpu time between construction and destruction to the stage
+ and records the stage as trace event (if enabled). The cpu time is the one of
+ the process. So a stage is timed once around all its tasks and the clocks of
+ a stage mustn't overlap. */
+class Stage_Clock{
+public:
+    Stage_Clock(Sort_Stats *stats, Sort_Stage stage, const char *detail=0); // stats can be NULL. Then no time is measured.
+    ~Stage_Clock();
+private:
+    Stage_Time *time;
+    double wall_begin;
+    double cpu_begin;
+    Trace_Span span;
+};
+
+/* sets the wall and cpu time between construction and destruction as stats->total. */
+class Run_Clock{
+public:
+    explicit Run_Clock(Sort_Stats *stats); // stats can be NULL
+    ~Run_Clock();
+private:
+    Stage_Time *time;
+    double wall_begin;
+    double cpu_begin;
+};
+
 typedef struct{
     LIST_OF_MSGS::iterator it;
     LIST_OF_MSGS::iterator end;
@@ -102,25 +246,54 @@ typedef std::vector<LC_it> VEC_OF_LC_it;
 
 /* prototype declarations */
 void init_DltMessage(DltMessage &);
-int process_input(std::ifstream &);
+class MsgArena;
+int process_input(std::istream &, Parse_Stats *stats=0, int file_idx=-1);
+int process_input(std::istream &, Parse_Stats *stats, int file_idx, MAP_OF_ECUS &ecus, MsgArena &arena); // into ecus instead of map_ecus
 int process_message(DltMessage *msg);
-int output_message(DltMessage *msg, std::ofstream &f);
-int determine_lcs(ECU_Info &);
-void determine_clock_skew(ECU_Info &);
+int process_message(DltMessage *msg, MAP_OF_ECUS &ecus);
+uint32_t get_ecu_id(const DltMessage &msg);
+bool add_filter_ids(SET_OF_IDS &ids, const char *list);
+Filter_Result filter_message(const DltMessage &msg);
+int remove_filtered_msgs(ECU_Info &);
+int output_message(const DltMessage *msg, std::ofstream &f, const unsigned char *payload=0); // payload: of a PAYLOAD_REF msg if read already
+size_t get_message_size(const DltMessage &msg);
+int64_t get_adjusted_time(const Out_Msg &o);
+void adjust_storage_header(const Out_Msg &o, DltStorageHeader &sh); // sets the time to get_adjusted_time (as with -t)
+size_t serialize_message(const Out_Msg &o, bool timeadjust, char *dst, const unsigned char *payload=0);
+class ThreadPool;
+const size_t lcs_chunk_msgs = 1<<18; // msgs per chunk for the parallel lifecycle detection
+int determine_lcs(ECU_Info &, ThreadPool *pool=0, size_t chunk_msgs=lcs_chunk_msgs); // with a pool ECUs with more msgs are split into chunks (approximation, see there)
+int64_t determine_clock_skew(ECU_Info &, ThreadPool *pool=0); // per lifecycle if use_skew_per_lc. Returns the max. error of --fast_skew (in usecs)
 bool compare_tmsp(const DltMessage *first, const DltMessage *second);
-int sort_msgs_lcs(ECU_Info &);
+int sort_msgs_lcs(ECU_Info &, ThreadPool *pool=0); // with a pool each lc is sorted in its own task
 bool compare_usecbegin(const OverallLC &first, const OverallLC &second);
 int merge_lcs(ECU_Info &);
 
-void debug_print(const LIST_OF_LCS &);
+void debug_print(const LIST_OF_LCS &, std::ostream &os = std::cout);
 void debug_print(const LIST_OF_OLCS &);
 void debug_print_message(const DltMessage &msg);
 int determine_overall_lcs();
+int determine_overall_lcs(MAP_OF_ECUS &ecus, LIST_OF_OLCS &olcs); // into olcs instead of list_olcs
 std::string get_ofstream_name(int cnt, std::string const &templ);
-std::ofstream *get_ofstream(int cnt, std::string const &name);
+std::ofstream *get_ofstream(int cnt, std::string const &name, char *buf=0, size_t buf_size=0); // NULL if it can't be opened
+int output_split(LIST_OF_OLCS &olcs, std::string const &templ, bool timeadjust, ThreadPool &pool);
+int output_mmap(LIST_OF_OLCS &olcs, std::string const &name, bool timeadjust, ThreadPool &pool);
 int64_t multiply(int64_t a, double b);
+void init_Sort_Stats(Sort_Stats &);
+double get_wall_secs();
+double get_cpu_secs();
+int64_t get_peak_rss();
+int64_t get_file_size(std::string const &name); // 0 if it can't be opened
+int analyse_ecus(std::vector<std::string> const &ifiles, Sort_Stats *stats, ThreadPool &pool); // parsing and all per ECU stages of sort_dlt_files. The result is in map_ecus
+int analyse_ecus(MAP_OF_ECUS &ecus, Sort_Stats *stats, ThreadPool &pool); // all per ECU stages on the parsed msgs of ecus. The result is in their lcs
+int analyse_dlt_files(std::vector<std::string> const &ifiles, Sort_Stats *stats, ThreadPool &pool); // all stages but the output. The result is in list_olcs
+int sort_dlt_files(std::vector<std::string> const &ifiles, std::string const &ofilename, bool do_split, bool do_timeadjust, Sort_Stats *stats=0);
+int write_stats_json(const Sort_Stats &stats, std::vector<std::string> const &ifiles, std::string const &name, int status=0); // status: the return value of the run (stats of a failed run can be incomplete)
 
 extern MAP_OF_ECUS map_ecus;
+typedef void (*Msg_Added_Func)(ECU_Info &info, DltMessage *msg);
+extern Msg_Added_Func on_msg_added; // called by process_message for each msg added to map_ecus. NULL = none
 extern LIST_OF_OLCS list_olcs;
+extern Msg_Filter msg_filter;
 
 #endif
@@ -8,18 +8,51 @@
 
 #include <iomanip>
 #include <limits>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
 #include "dlt-sort.h"
+#include "thread_pool.h"
+#include "msg_arena.h"
+#include "mem_budget.h"
+#include "pipeline.h"
+#include "async_read.h"
+#include "read_planner.h"
+#include "payload_blocks.h"
+#include "nav_index.h"
+#include "in_place.h"
+#include "fan_out.h"
+#include "htyp_codec.h"
+#include "dedup.h"
+#include "sort_context.h"
 
 using namespace std;
 
+const char* const dlt_sort_version="1.3";
+
 int verbose = 0;
 int trust_logger_time=0; // by default we don't trust the logger time. see ::fitsin for an example why
 int use_max_earlier_sanity_check=1; // by default enabled.
 int64_t max_earlier_begin_usecs = 120ll*usecs_per_sec; // by default max 2mins
 int use_clock_drift_detection=1; // by default enabled.
+int use_skew_per_lc=0; // by default one clock skew for all lifecycles of an ECU
+int use_fast_skew=0; // by default the skew search runs on all msgs
+int nr_jobs=0; // number of threads to use. 0 = number of hw threads
+int use_mmap_output=0; // by default write the single output file via ofstream
 
 MAP_OF_ECUS map_ecus;
+Msg_Added_Func on_msg_added = 0;
 LIST_OF_OLCS list_olcs;
+Msg_Filter msg_filter; // by default no filter active
 
 void init_DltMessage(DltMessage &msg){
     msg.found_serialheader=0;
@@ -34,6 +67,7 @@ void init_DltMessage(DltMessage &msg){
 Lifecycle::Lifecycle(const DltMessage &m)
 {
     clock_skew = 1.0f;
+    shard_lc = -1;
     usec_begin = m.storageheader->seconds;
     usec_begin *= usecs_per_sec;
     usec_begin += m.storageheader->microseconds;
@@ -239,16 +273,18 @@ int64_t Lifecycle::determine_begin (double skew) const
 
 int64_t Lifecycle::determine_end() const
 {
-    int64_t ret = multiply(max_tmsp, clock_skew);
+    int64_t ret = multiply(((int64_t)max_tmsp) * usecs_per_tmsp, clock_skew); // tmsp is in 0.1ms granularity
     ret += usec_begin;
     return ret;
 }
 
-void determine_clock_skew(ECU_Info &ecu)
-{
-    if (ecu.lcs.size()==0) return;
-    if (ecu.msgs.size()==0) return;
+// lifecycles shorter than this get the clock skew of their ECU as their own estimate is too unreliable:
+const size_t min_skew_lc_msgs = 1000;
+const uint32_t min_skew_lc_tmsps = 60*10000; // 60s (tmsp is in 0.1ms)
+const size_t fast_skew_buckets = 1024; // per lifecycle for --fast_skew
 
+static double determine_ecu_clock_skew(const ECU_Info &ecu)
+{
     double skew_min = 0.5;
     double skew_max = 1.5;
     double r_skew=1.25; // >1 = ECU clock is faster than logger clock
@@ -346,15 +382,131 @@ void determine_clock_skew(ECU_Info &ecu)
         --i;
     }while(i>0);
     // last_skew contains the optimum:
-    // adjust each lc:
-    //cout << endl;
-    for (LIST_OF_LCS::iterator it=ecu.lcs.begin(); it!=ecu.lcs.end(); ++it){
-        (*it).set_clock_skew(last_skew);
-        //cout << " max latency = " << (*it).determine_max_latency() << endl;
+    return last_skew;
+}
+
+/* the skew search only depends on the msgs with the min and max latency.
+ So for --fast_skew it runs on a sample: the tmsp range of the lc is split into
+ buckets and from each bucket the msgs with the min and max (storage time - tmsp)
+ are kept. That's a single pass over the msgs. */
+static void sample_lc(const Lifecycle &lc, Lifecycle &sample)
+{
+    sample.usec_begin = lc.usec_begin;
+    sample.usec_end = lc.usec_end;
+    sample.rel_offset_valid = lc.rel_offset_valid;
+    sample.min_tmsp = lc.min_tmsp;
+    sample.max_tmsp = lc.max_tmsp;
+    sample.clock_skew = lc.clock_skew;
+    sample.msgs.clear();
+    if (lc.msgs.size() <= 2*fast_skew_buckets){
+        sample.msgs = lc.msgs;
+        return;
+    }
+    std::vector<DltMessage *> mins(fast_skew_buckets, 0), maxs(fast_skew_buckets, 0);
+    std::vector<int64_t> min_d(fast_skew_buckets), max_d(fast_skew_buckets);
+    uint64_t range = (uint64_t)(lc.max_tmsp - lc.min_tmsp) + 1;
+    for (LIST_OF_MSGS::const_iterator it=lc.msgs.begin(); it!=lc.msgs.end(); ++it){
+        DltMessage *m = *it;
+        uint32_t tmsp = m->headerextra.tmsp;
+        size_t b = 0; // a first msg without tmsp is below min_tmsp
+        if (tmsp > lc.min_tmsp) b = (size_t)(((uint64_t)(tmsp - lc.min_tmsp) * fast_skew_buckets) / range);
+        if (b >= fast_skew_buckets) b = fast_skew_buckets-1;
+        int64_t d = (usecs_per_sec*m->storageheader->seconds)+m->storageheader->microseconds;
+        d -= usecs_per_tmsp*tmsp;
+        if (!mins[b] || d<min_d[b]){ mins[b] = m; min_d[b] = d; }
+        if (!maxs[b] || d>max_d[b]){ maxs[b] = m; max_d[b] = d; }
+    }
+    for (size_t b=0; b<fast_skew_buckets; ++b){
+        if (mins[b]) sample.msgs.push_back(mins[b]);
+        if (maxs[b] && maxs[b]!=mins[b]) sample.msgs.push_back(maxs[b]);
+    }
+}
+
+/* sets the skew found on the sample. The exact begin and max latency are
+ determined with a single pass over all msgs. Returns the error of the sample
+ (the larger one of begin and max latency) in usecs. */
+static int64_t apply_sampled_skew(Lifecycle &lc, const Lifecycle &sample, double skew)
+{
+    int64_t min_d = std::numeric_limits<int64_t>::max();
+    int64_t max_d = std::numeric_limits<int64_t>::min();
+    for (LIST_OF_MSGS::const_iterator it=lc.msgs.begin(); it!=lc.msgs.end(); ++it){
+        DltMessage *m = *it;
+        int64_t d = (usecs_per_sec*m->storageheader->seconds)+m->storageheader->microseconds;
+        d -= multiply(usecs_per_tmsp*m->headerextra.tmsp, skew);
+        if (d<min_d) min_d = d;
+        if (d>max_d) max_d = d;
+    }
+    int64_t sample_begin = sample.determine_begin(skew);
+    int64_t sample_lat = sample.determine_max_latency(sample_begin, skew);
+    lc.set_clock_skew(skew, min_d);
+    // the sample is a subset. So it can only be later and shorter:
+    return std::max(sample_begin - min_d, (max_d - min_d) - sample_lat);
+}
+
+int64_t determine_clock_skew(ECU_Info &ecu, ThreadPool *pool)
+{
+    if (ecu.lcs.size()==0) return 0;
+    if (ecu.msgs.size()==0) return 0;
+
+    // the lcs are independent so the passes over their msgs run in parallel:
+    std::vector<Lifecycle *> lcs_v;
+    for (LIST_OF_LCS::iterator it=ecu.lcs.begin(); it!=ecu.lcs.end(); ++it)
+        lcs_v.push_back(&(*it));
+    std::function<void(const std::function<void(size_t)> &)> for_each_lc = [&](const std::function<void(size_t)> &f){
+        if (pool)
+            pool->parallel_for(lcs_v.size(), f);
+        else
+            for (size_t i=0; i<lcs_v.size(); ++i) f(i);
+    };
+
+    // the lcs the search runs on:
+    ECU_Info sampled;
+    std::vector<Lifecycle *> search_v(lcs_v);
+    if (use_fast_skew){
+        sampled.lcs.resize(lcs_v.size());
+        size_t i=0;
+        for (LIST_OF_LCS::iterator it=sampled.lcs.begin(); it!=sampled.lcs.end(); ++it, ++i)
+            search_v[i] = &(*it);
+        for_each_lc([&](size_t i){ sample_lc(*lcs_v[i], *search_v[i]); });
+    }
+
+    std::vector<double> skews(lcs_v.size(), 0.0); // 0.0 = use the ECU skew
+    if (use_skew_per_lc){
+        /* each lifecycle on its own (the skew changes e.g. with the temperature).
+         The short ones are too unreliable and get the one of the ECU: */
+        for_each_lc([&](size_t i){
+            const Lifecycle &lc = *lcs_v[i];
+            if (lc.msgs.size() >= min_skew_lc_msgs && lc.rel_offset_valid && (lc.max_tmsp-lc.min_tmsp) >= min_skew_lc_tmsps)
+                skews[i] = search_v[i]->determine_clock_skew();
+        });
     }
 
-    if (verbose>=1) cout << "\npossible clock skew = " << ((last_skew-1.0f)*100.0) << "%" << endl;
+    // It needs to be determined before any lc is adjusted:
+    double ecu_skew = 0.0;
+    if (std::find(skews.begin(), skews.end(), 0.0)!=skews.end())
+        ecu_skew = determine_ecu_clock_skew(use_fast_skew ? sampled : ecu);
+    std::vector<bool> of_ecu(lcs_v.size());
+    for (size_t i=0; i<lcs_v.size(); ++i){
+        of_ecu[i] = skews[i]==0.0;
+        if (of_ecu[i]) skews[i] = ecu_skew;
+    }
+
+    // adjust each lc:
+    std::vector<int64_t> errors(lcs_v.size(), 0);
+    if (use_fast_skew)
+        for_each_lc([&](size_t i){ errors[i] = apply_sampled_skew(*lcs_v[i], *search_v[i], skews[i]); });
+    else
+        for (size_t i=0; i<lcs_v.size(); ++i) lcs_v[i]->set_clock_skew(skews[i]);
 
+    if (verbose>=1){
+        if (!use_skew_per_lc)
+            cout << "\npossible clock skew = " << ((ecu_skew-1.0f)*100.0) << "%" << endl;
+        else for (size_t i=0; i<lcs_v.size(); ++i)
+            cout << "\npossible clock skew of lc " << i << " = " << ((skews[i]-1.0f)*100.0) << "%" << (of_ecu[i] ? " (of the ECU)" : "") << endl;
+    }
+    int64_t max_error = *std::max_element(errors.begin(), errors.end());
+    if (verbose>=1 && use_fast_skew) cout << "fast skew: max. error of the sample " << max_error << "us" << endl;
+    return max_error;
 }
 
 double Lifecycle::determine_clock_skew() const
@@ -444,6 +596,13 @@ void Lifecycle::set_clock_skew(double new_skew)
     usec_end = determine_end();
 }
 
+void Lifecycle::set_clock_skew(double new_skew, int64_t new_begin)
+{
+    usec_begin = new_begin;
+    clock_skew = new_skew;
+    usec_end = determine_end();
+}
+
 bool Lifecycle::expand_if_intersects(Lifecycle &lc)
 {
     if (lc.usec_begin > usec_end) return false;
@@ -462,26 +621,39 @@ bool Lifecycle::expand_if_intersects(Lifecycle &lc)
 }
 
 
-void Lifecycle::debug_print() const
+void Lifecycle::debug_print(std::ostream &os) const
 {
     time_t sbeg, send;
     sbeg = usec_begin / usecs_per_sec;
     send = usec_end / usecs_per_sec;
+    char buf[26];
     
-    cout << " LC from " << ctime(&sbeg) << "      to ";
-    cout << ctime(&send);
-    cout << "  min_tmsp=" << min_tmsp << " max_tmsp=" << max_tmsp << endl;
-    cout << "  num_msgs = " << msgs.size() << endl;
+    os << " LC from " << ctime_r(&sbeg, buf) << "      to "; // ctime_r as we might run in parallel for multiple ECUs
+    os << ctime_r(&send, buf);
+    os << "  min_tmsp=" << min_tmsp << " max_tmsp=" << max_tmsp << endl;
+    os << "  num_msgs = " << msgs.size() << endl;
     if (verbose>=1)
-        cout << "  max latency = " << determine_max_latency() << endl;
+        os << "  max latency = " << determine_max_latency() << endl;
     // cout << "  possible clock skew = " << ((determine_clock_skew()-1.0f)*100.0) << "%" << endl;
 }
 
 const char DLT_ID4_ID[4] = {'D', 'L', 'T', 0x01};
 
-int process_input(std::ifstream &fin)
+int process_input(std::istream &fin, Parse_Stats *stats, int file_idx)
+{
+    return process_input(fin, stats, file_idx, map_ecus, msg_arena);
+}
+
+int process_input(std::istream &fin, Parse_Stats *stats, int file_idx, MAP_OF_ECUS &ecus, MsgArena &arena)
 {
+    /* file_idx is the index of this file for open_payload_files. It's needed to keep
+     payload refs only instead of the payloads if the mem_limit is near. */
     int64_t nr_msgs=0;
+    int64_t nr_filtered=0;
+    int64_t nr_skipped=0;
+    int64_t resync_bytes=0;
+    int64_t nr_payload_refs=0;
+    Payload_Block_Writer blocks(arena); // used if use_payload_blocks
     // fin is already open and valid
     
     // determine file length:
@@ -490,9 +662,13 @@ int process_input(std::ifstream &fin)
     fin.seekg(0, fin.beg);
     
     int64_t remaining = file_length;
+    DltMessage *msg=0; // the msg is reused if it wasn't stored
+    // a file uses mostly the same header layout. So we keep the last one:
+    unsigned int last_htyp_idx = 0;
+    const Htyp_Codec *codec = &htyp_codecs[0];
+    char extra_headers[max_htyp_layout_size];
     while(remaining>=(int64_t)sizeof(DltStorageHeader)){
-        DltMessage *msg=new DltMessage;
-        init_DltMessage(*msg);
+        if (!msg) msg=arena.alloc_msg(); else init_DltMessage(*msg);
         
         // read until dlt pattern (DLT0x01) is found:
         bool found_pattern=false;
@@ -515,8 +691,10 @@ int process_input(std::ifstream &fin)
         
         if (found_pattern){
             
-            if (skipped_bytes)
+            if (skipped_bytes){
                 cerr << "skipped " << skipped_bytes << " bytes of data to find next storageheader pattern.\n";
+                resync_bytes += skipped_bytes;
+            }
             
             memcpy((char*)msg->storageheader, pattern, sizeof(pattern)); // we need to copy it as it will be used on export
             // read the rest of the dlt storage header:
@@ -531,53 +709,73 @@ int process_input(std::ifstream &fin)
                 int header_version = (msg->standardheader->htyp & DLT_HTYP_VERS) >> 5; // need a constant for 5
                 if ((header_version<DLT_HEADER_VERSION_MIN) || (header_version > DLT_HEADER_VERSION_MAX)){
                     cerr << "msg #" << nr_msgs << " has wrong header version (" << header_version << "). skipping! ";
+                    nr_skipped++;
                 }else{
                     uint16_t len = DLT_BETOH_16(msg->standardheader->len); // why that? the macro should work! DLT_ENDIAN_GET_16(hstd.htyp, hstd.len); // len is without storage header (but with stdh)
                     if (len<=sizeof(*msg->standardheader)){
                         cerr << "msg len (" << len << ") <= sizeof(DltStandardHeader). skipping!\n";
+                        nr_skipped++;
                         // keep remaining untouched. pattern search will find next msg
                     }else{
                         len -= sizeof(*msg->standardheader); // standard header already read from this message
                         
-                        // extended header?
-                        if (DLT_IS_HTYP_WEID(msg->standardheader->htyp))
-                        {
-                            fin.read(msg->headerextra.ecu, DLT_SIZE_WEID); // DLT_ID_SIZE);
-                            remaining -= DLT_SIZE_WEID; // DLT_ID_SIZE;
-                            len -= DLT_SIZE_WEID; // DLT_ID_SIZE;
-                        }
-                        
-                        if (DLT_IS_HTYP_WSID(msg->standardheader->htyp))
-                        {
-                            fin.read((char*)&(msg->headerextra.seid), DLT_SIZE_WSID);
-                            msg->headerextra.seid = DLT_BETOH_32(msg->headerextra.seid);
-                            remaining -= DLT_SIZE_WSID;
-                            len -= DLT_SIZE_WSID;
-                        }
-                        
-                        if (DLT_IS_HTYP_WTMS(msg->standardheader->htyp))
-                        {
-                            fin.read((char*)&(msg->headerextra.tmsp), DLT_SIZE_WTMS);
-                            msg->headerextra.tmsp = DLT_BETOH_32(msg->headerextra.tmsp);
-                            remaining -= DLT_SIZE_WTMS;
-                            len -= DLT_SIZE_WTMS;
-                        } else msg->headerextra.tmsp = 0;
-                        
-                        // has extended header?
-                        if (DLT_IS_HTYP_UEH(msg->standardheader->htyp)){
-                            fin.read((char*)msg->extendedheader, sizeof(*msg->extendedheader));
-                            remaining -= sizeof(*msg->extendedheader);
-                            len -= sizeof(*msg->extendedheader);
+                        // extra and extended header (as given by the htyp flags) with a single read:
+                        unsigned int htyp_idx = htyp_index(msg->standardheader->htyp);
+                        if (htyp_idx != last_htyp_idx){
+                            codec = &htyp_codecs[htyp_idx];
+                            last_htyp_idx = htyp_idx;
                         }
+                        fin.read(extra_headers, codec->size);
+                        codec->decode(extra_headers, *msg);
+                        remaining -= codec->size;
+                        len -= codec->size;
                         
                         // read remaining message:
                         if (remaining >= len){
-                            msg->databuffer = new unsigned char [len];
-                            msg->databuffersize = len;
-                            fin.read((char*)msg->databuffer, len);
-                            (void)process_message(msg);
-                            // delete msg.databuffer;
-                            // delete msg // not necessary. process_message takes care
+                            Filter_Result filter = filter_message(*msg);
+                            if (filter == FILTER_KEEP){
+                                if (use_payload_refs && file_idx>=0 && (len>sizeof(Payload_Ref) || use_in_place)){
+                                    // keep only the position. The payload is read again at output time:
+                                    Payload_Ref ref;
+                                    ref.file_idx = (uint32_t)file_idx;
+                                    ref.offset = (int64_t)fin.tellg();
+                                    msg->databuffer = arena.alloc_payload(sizeof(ref));
+                                    memcpy(msg->databuffer, &ref, sizeof(ref));
+                                    msg->found_serialheader |= DLT_SORT_MSG_PAYLOAD_REF;
+                                    fin.seekg(len, ios_base::cur);
+                                    nr_payload_refs++;
+                                }else if (use_payload_blocks && len>payload_block_ref_size){
+                                    // collect it with the next ones. The block is compressed once full:
+                                    fin.read((char*)blocks.add(*msg, len), len);
+                                }else{
+                                    msg->databuffer = arena.alloc_payload(len);
+                                    fin.read((char*)msg->databuffer, len);
+                                }
+                                msg->databuffersize = len;
+                                (void)process_message(msg, ecus);
+                                msg = 0; // stored now. the arena takes care of freeing
+                                if (mem_limit && ((nr_msgs & 0xfff)==0) && &ecus==&map_ecus) check_mem_limit();
+                            }else{
+                                // skip the payload. we never store it:
+                                fin.seekg(len, ios_base::cur);
+                                if (filter == FILTER_HEADER_ONLY){
+                                    msg->databuffer = 0;
+                                    msg->databuffersize = 0;
+                                    if (use_in_place && file_idx>=0){
+                                        // the position is needed to move the msg:
+                                        Payload_Ref ref;
+                                        ref.file_idx = (uint32_t)file_idx;
+                                        ref.offset = (int64_t)fin.tellg() - (int64_t)len;
+                                        msg->databuffer = arena.alloc_payload(sizeof(ref));
+                                        memcpy(msg->databuffer, &ref, sizeof(ref));
+                                        msg->found_serialheader |= DLT_SORT_MSG_PAYLOAD_REF;
+                                    }
+                                    msg->found_serialheader |= DLT_SORT_MSG_FILTERED;
+                                    (void)process_message(msg, ecus);
+                                    msg = 0;
+                                } // else: dropped. we reuse the msg
+                                nr_filtered++;
+                            }
                             remaining -= len;
                             nr_msgs++;
                         }else{
@@ -592,17 +790,136 @@ int process_input(std::ifstream &fin)
             }
         }else{
             cerr << "no proper DLT pattern found! Stop processing this file! Skipped " << skipped_bytes << " bytes\n";
+            resync_bytes += skipped_bytes;
             cerr << " found: <" << pattern[0] << pattern[1] << pattern[2] << pattern[3] << ">\n";
             remaining = -1;
         }
         
     }
+    blocks.flush();
     if (verbose && remaining!=0) cout << "remaining != 0. parsing errors within that file!\n";
     if (verbose) cout << "processed " << nr_msgs << " msgs\n";
+    if (verbose && nr_filtered) cout << "filtered " << nr_filtered << " msgs\n";
+    if (verbose && nr_payload_refs) cout << "kept the payload of " << nr_payload_refs << " msgs in the file\n";
+    if (verbose && blocks.nr_bytes_raw()) cout << "compressed " << (blocks.nr_bytes_raw()>>10) << "kB of payloads to " << (blocks.nr_bytes_compressed()>>10) << "kB\n";
+    if (stats){
+        stats->nr_payload_refs += nr_payload_refs;
+        stats->payload_bytes_raw += blocks.nr_bytes_raw();
+        stats->payload_bytes_compressed += blocks.nr_bytes_compressed();
+        stats->nr_msgs += nr_msgs;
+        stats->nr_filtered += nr_filtered;
+        stats->nr_skipped += nr_skipped;
+        stats->resync_bytes += resync_bytes;
+    }
     return (int)remaining; // 0 = success, <0 error in processing
 }
 
+uint32_t get_ecu_id(const DltMessage &msg)
+{
+    uint32_t ecu_i;
+    if (DLT_IS_HTYP_WEID(msg.standardheader->htyp)){
+        memcpy(&ecu_i, msg.headerextra.ecu, sizeof(ecu_i));
+    }else{
+        memcpy(&ecu_i, msg.storageheader->ecu, sizeof(ecu_i));
+    }
+    return ecu_i;
+}
+
+bool add_filter_ids(SET_OF_IDS &ids, const char *list)
+{
+    // list is a comma separated list of ids with max. 4 chars each (e.g. "APP1,SYS")
+    // shorter ids are padded with 0 as the dlt lib does.
+    assert(list);
+    const char *p = list;
+    do{
+        const char *e = strchr(p, ',');
+        size_t len = e ? (size_t)(e-p) : strlen(p);
+        if (len==0 || len>DLT_ID_SIZE){
+            cerr << "invalid id <" << std::string(p, len) << "> in <" << list << ">. Ids need 1-4 chars!\n";
+            return false;
+        }
+        char id[DLT_ID_SIZE];
+        memset(id, 0, sizeof(id));
+        memcpy(id, p, len);
+        uint32_t id_i;
+        memcpy(&id_i, id, sizeof(id_i));
+        ids.insert(id_i);
+        p = e ? e+1 : 0;
+    }while(p);
+    return true;
+}
+
+static bool id_passes(const SET_OF_IDS &incl, const SET_OF_IDS &excl, const char *id)
+{
+    uint32_t id_i;
+    memcpy(&id_i, id, sizeof(id_i));
+    if (incl.size() && !incl.count(id_i)) return false;
+    if (excl.size() && excl.count(id_i)) return false;
+    return true;
+}
+
+Filter_Result filter_message(const DltMessage &msg)
+{
+    /* decide based on the headers only (payload not read yet) whether we need the msg.
+     Msgs from filtered ECUs are dropped completely.
+     All other filtered msgs are kept as header-only records as they still contain
+     valid timing info for the lifecycle detection/clock skew of their ECU.
+     Msgs without tmsp are thrown away by the lifecycle detection anyhow so we
+     don't need to keep them. */
+    uint32_t ecu_i = get_ecu_id(msg);
+    if (!id_passes(msg_filter.incl_ecus, msg_filter.excl_ecus, (const char *)&ecu_i)) return FILTER_DROP;
+    
+    bool keep = true;
+    if (DLT_IS_HTYP_UEH(msg.standardheader->htyp)){
+        keep = id_passes(msg_filter.incl_apids, msg_filter.excl_apids, msg.extendedheader->apid) &&
+            id_passes(msg_filter.incl_ctids, msg_filter.excl_ctids, msg.extendedheader->ctid);
+        if (keep && msg_filter.max_log_level>0 && DLT_GET_MSIN_MSTP(msg.extendedheader->msin)==DLT_TYPE_LOG){
+            int log_level = DLT_GET_MSIN_MTIN(msg.extendedheader->msin);
+            if (log_level > msg_filter.max_log_level) keep = false;
+        }
+    }else{
+        // no apid/ctid available. only pass if no include list is set:
+        keep = msg_filter.incl_apids.empty() && msg_filter.incl_ctids.empty();
+    }
+    if (keep) return FILTER_KEEP;
+    return msg.headerextra.tmsp ? FILTER_HEADER_ONLY : FILTER_DROP;
+}
+
+int remove_filtered_msgs(ECU_Info &ecu)
+{
+    /* remove the header-only records of filtered msgs after the lifecycle detection
+     and clock skew determination. Lifecycles that contain filtered msgs only are removed. */
+    int nr_removed = 0;
+    for (LIST_OF_LCS::iterator it = ecu.lcs.begin(); it!=ecu.lcs.end();){
+        LIST_OF_MSGS &msgs = (*it).msgs;
+        for (LIST_OF_MSGS::iterator j = msgs.begin(); j!=msgs.end();){
+            if ((*j)->found_serialheader & DLT_SORT_MSG_FILTERED)
+                j = msgs.erase(j);
+            else
+                ++j;
+        }
+        if (msgs.size()==0)
+            it = ecu.lcs.erase(it);
+        else
+            ++it;
+    }
+    for (LIST_OF_MSGS::iterator j = ecu.msgs.begin(); j!=ecu.msgs.end();){
+        DltMessage *m = *j;
+        if (m->found_serialheader & DLT_SORT_MSG_FILTERED){
+            j = ecu.msgs.erase(j); // the msg itself is freed with the arena
+            ++nr_removed;
+        }else
+            ++j;
+    }
+    return nr_removed;
+}
+
 int process_message(DltMessage *msg)
+{
+    return process_message(msg, map_ecus);
+}
+
+int process_message(DltMessage *msg, MAP_OF_ECUS &ecus)
 {
     // we do sort by:
     // ECU, APID, CTID
@@ -645,96 +962,251 @@ int process_message(DltMessage *msg)
     // here all data available to sort them:
 	uint32_t ecu_i;
 	memcpy (&ecu_i, ecu, sizeof(ecu_i));
-    LIST_OF_MSGS &list_of_msg = map_ecus[ecu_i].msgs;
-    list_of_msg.push_back(msg);
+    ECU_Info &info = ecus[ecu_i];
+    info.msgs.push_back(msg);
+    if (on_msg_added) on_msg_added(info, msg);
     if (verbose>=3)
         debug_print_message(*msg);
     
     return 0; // success
 }
 
-int output_message(DltMessage *msg, std::ofstream &f)
+int output_message(const DltMessage *msg, std::ofstream &f, const unsigned char *payload)
 {
     assert(msg);
     // output storageheader
     f.write((char*)(msg->storageheader), sizeof(*msg->storageheader));
     // output standard header
     f.write((char*)(msg->standardheader), sizeof(*msg->standardheader));
-    // output extraheader
-    if (DLT_IS_HTYP_WEID(msg->standardheader->htyp))
-    {
-        f.write(msg->headerextra.ecu, DLT_SIZE_WEID); // DLT_ID_SIZE);
+    // output extraheader and extended header
+    char extra_headers[max_htyp_layout_size];
+    const Htyp_Codec &codec = get_htyp_codec(msg->standardheader->htyp);
+    codec.encode(*msg, extra_headers);
+    f.write(extra_headers, codec.size);
+    // output data
+    if (msg->databuffersize){
+        if (payload)
+            f.write((const char*)payload, msg->databuffersize); // read (or decompressed) by the caller already
+        else if (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF){
+            std::vector<unsigned char> buf((size_t)msg->databuffersize);
+            if (!read_payload(*msg, &buf[0])) cerr << "can't read payload from input file!\n";
+            f.write((char*)&buf[0], msg->databuffersize);
+        }else if (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK){
+            std::vector<unsigned char> buf((size_t)msg->databuffersize);
+            if (!read_block_payload(*msg, &buf[0])) cerr << "can't decompress payload!\n";
+            f.write((char*)&buf[0], msg->databuffersize);
+        }else
+            f.write((char*)msg->databuffer, msg->databuffersize);
     }
     
-    if (DLT_IS_HTYP_WSID(msg->standardheader->htyp))
-    {
-        msg->headerextra.seid = DLT_HTOBE_32(msg->headerextra.seid);
-        f.write((char*)&(msg->headerextra.seid), DLT_SIZE_WSID);
+    return 0; // success
+}
+
+size_t get_message_size(const DltMessage &msg)
+{
+    // size of the msg as written by output_message/serialize_message:
+    size_t size = sizeof(*msg.storageheader) + sizeof(*msg.standardheader);
+    size += get_htyp_codec(msg.standardheader->htyp).size;
+    if (msg.databuffersize>0) size += (size_t)msg.databuffersize;
+    return size;
+}
+
+int64_t get_adjusted_time(const Out_Msg &o)
+{
+    // the time the msg was sent in the lifecycle time (as used with -t):
+    return o.usec_begin + multiply(usecs_per_tmsp*((int64_t)o.msg->headerextra.tmsp), o.clock_skew);
+}
+
+void adjust_storage_header(const Out_Msg &o, DltStorageHeader &sh)
+{
+    int64_t t = get_adjusted_time(o);
+    sh.seconds = (uint32_t)(t / usecs_per_sec);
+    sh.microseconds = t % usecs_per_sec;
+}
+
+size_t serialize_message(const Out_Msg &o, bool timeadjust, char *dst, const unsigned char *payload)
+{
+    /* same byte sequence as output_message (plus the timeadjust from
+     output_to_fstream) but into memory and without changing the msg.
+     dst needs to have get_message_size() bytes. */
+    const DltMessage *msg = o.msg;
+    char *p = dst;
+    memcpy(p, msg->storageheader, sizeof(*msg->storageheader));
+    if (timeadjust) adjust_storage_header(o, *(DltStorageHeader *)p);
+    p += sizeof(*msg->storageheader);
+    memcpy(p, msg->standardheader, sizeof(*msg->standardheader));
+    p += sizeof(*msg->standardheader);
+    p = get_htyp_codec(msg->standardheader->htyp).encode(*msg, p);
+    if (msg->databuffersize>0){
+        if (payload)
+            memcpy(p, payload, (size_t)msg->databuffersize); // read (or decompressed) by the caller already
+        else if (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF){
+            if (!read_payload(*msg, (unsigned char *)p)){
+                cerr << "can't read payload from input file!\n";
+                memset(p, 0, (size_t)msg->databuffersize);
+            }
+        }else if (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK){
+            if (!read_block_payload(*msg, (unsigned char *)p)){
+                cerr << "can't decompress payload!\n";
+                memset(p, 0, (size_t)msg->databuffersize);
+            }
+        }else
+            memcpy(p, msg->databuffer, (size_t)msg->databuffersize);
+        p += msg->databuffersize;
     }
-    
-    if (DLT_IS_HTYP_WTMS(msg->standardheader->htyp))
-    {
-        msg->headerextra.tmsp = DLT_HTOBE_32(msg->headerextra.tmsp);
-        f.write((char*)&(msg->headerextra.tmsp), DLT_SIZE_WTMS);
+    return (size_t)(p-dst);
+}
+
+void LC_Detector::add(DltMessage *msg)
+{
+    if (cur_l == lcs.end()){
+        // init with the first message:
+        lcs.push_back(Lifecycle(*msg));
+        cur_l = lcs.begin();
+        prev_msg = msg;
+        return;
     }
-    // output extended header
-    if (DLT_IS_HTYP_UEH(msg->standardheader->htyp)){
-        f.write((char*)msg->extendedheader, sizeof(*msg->extendedheader));
+    // to optimize performance we always check with the last matching (cur_l) one:
+    if (!((*cur_l).fitsin(*msg))){
+        // check whether it fits into any other lifecyle:
+        bool found_other=false;
+        for(LIST_OF_LCS::iterator lit = lcs.begin(); !found_other && lit!=lcs.end(); ++lit){
+            if (lit!=cur_l && (((*lit).fitsin(*msg)))){
+                found_other=true;
+                cur_l = lit;
+            }
+        }
+        // create a new lifecycle based on the msg and set l to this one
+        if (!found_other){
+            if (verbose>=2){
+                // show the msg that lead to a new lifecycle and the previous one.
+                if (prev_msg){
+                    cout << "\nprev:";
+                    debug_print_message(*prev_msg);
+                }
+                cout << "new :";
+                debug_print_message(*msg);
+            }
+            Lifecycle new_lc(*msg);
+            lcs.push_back(new_lc); // will be sorted later. so it doesn't matter where we add them
+            cur_l = lcs.end(); // get the one inserted
+            --cur_l; // end points to a non existing element.
+        }
+    } // else fits in cur_l -> next msg
+    prev_msg = msg;
+}
+
+/* recalculates usec_begin/usec_end of a lifecycle from its msgs (in order of
+ arrival) the same way the constructor and fitsin do it. The end depends on the
+ begin known at the time a msg arrived. So a lifecycle joined from the parts
+ of multiple chunks gets the same bounds as if it was detected in one go. */
+static void replay_lc_bounds(Lifecycle &lc)
+{
+    bool first=true;
+    for (LIST_OF_MSGS::const_iterator it = lc.msgs.begin(); it!=lc.msgs.end(); ++it){
+        const DltMessage &m = **it;
+        int64_t usec_tx = m.storageheader->seconds;
+        usec_tx *= usecs_per_sec;
+        usec_tx += m.storageheader->microseconds;
+        int64_t msg_timestamp = ((int64_t)m.headerextra.tmsp) * usecs_per_tmsp;
+        if (first){
+            lc.usec_begin = usec_tx - msg_timestamp;
+            lc.usec_end = usec_tx;
+            first=false;
+            continue;
+        }
+        if (usec_tx - msg_timestamp < lc.usec_begin) lc.usec_begin = usec_tx - msg_timestamp;
+        int64_t m_tx = trust_logger_time ? usec_tx : lc.usec_begin + msg_timestamp;
+        if (m_tx > lc.usec_end) lc.usec_end = m_tx;
     }
-    // output data
-    if (msg->databuffersize)
-        f.write((char*)msg->databuffer, msg->databuffersize);
-    
-    return 0; // success
 }
 
-int determine_lcs(ECU_Info &ecu)
+// whether fitsin would accept the msg. Without modifying the lifecycle:
+static bool would_fit(const Lifecycle &lc, const DltMessage &m)
+{
+    Lifecycle probe; // without the msgs
+    probe.usec_begin = lc.usec_begin;
+    probe.usec_end = lc.usec_end;
+    probe.rel_offset_valid = lc.rel_offset_valid;
+    probe.min_tmsp = lc.min_tmsp;
+    probe.max_tmsp = lc.max_tmsp;
+    return probe.fitsin(m);
+}
+
+int determine_lcs(ECU_Info &ecu, ThreadPool *pool, size_t chunk_msgs)
 {
     assert(ecu.lcs.size()==0);
     assert(ecu.msgs.size()>0);
     
-    // init with the first message:
-    Lifecycle lc(**ecu.msgs.begin());
-    ecu.lcs.push_back(lc);
-    
-    // now go through each message and adjust/insert new lifecycles:
-    if (ecu.msgs.size()>1){
-        LIST_OF_LCS::iterator cur_l = ecu.lcs.begin();
-        LIST_OF_MSGS::iterator it = ecu.msgs.begin();
-        DltMessage *prev_msg = *it;
-        ++it; // we skip the first msgs as we treated this already above
-        for (; it!=ecu.msgs.end(); ++it){
-            // to optimize performance we always check with the last matching (cur_l) one:
-            if (!((*cur_l).fitsin(**it))){
-                // check whether it fits into any other lifecyle:
-                bool found_other=false;
-                for(LIST_OF_LCS::iterator lit = ecu.lcs.begin(); !found_other && lit!=ecu.lcs.end(); ++lit){
-                    if (lit!=cur_l && (((*lit).fitsin(**it)))){
-                        found_other=true;
-                        cur_l = lit;
-                    }
-                }
-                // create a new lifecycle based on the msg and set l to this one
-                if (!found_other){
-                    if (verbose>=2){
-                        // show the msg that lead to a new lifecycle and the previous one.
-                        if (prev_msg){
-                            cout << "\nprev:";
-                            debug_print_message(*prev_msg);
-                        }
-                        cout << "new :";
-                        debug_print_message(**it);
-                    }
-                    Lifecycle new_lc(**it);
-                    ecu.lcs.push_back(new_lc); // will be sorted later. so it doesn't matter where we add them
-                    cur_l = ecu.lcs.end(); // get the one inserted
-                    --cur_l; // end points to a non existing element.
-                }
-            } // else fits in cur_l -> next msg
-            prev_msg = *it;
-        }
+    if (!pool || ecu.msgs.size() < 2*chunk_msgs){
+        // go through each message and adjust/insert new lifecycles:
+        LC_Detector detector(ecu.lcs);
+        for (LIST_OF_MSGS::iterator it = ecu.msgs.begin(); it!=ecu.msgs.end(); ++it)
+            detector.add(*it);
+        return 0; // success
     }
     
+    /* split the msgs into chunks and detect the lcs of each chunk on its own.
+     A lifecycle that spans multiple chunks is detected in each of them. Those
+     parts intersect and are joined (in the order of the chunks) the same way
+     merge_lcs does it. The chunks don't depend on the nr of threads so the
+     result is the same for any pool.
+     This is an approximation of the sequential detection: a chunk-lc is matched
+     to the earlier lcs only by its first msg. A later msg of the chunk that didn't
+     fit the (shorter) chunk-lc is not re-tested against the joined one. As fitsin
+     accepts more for wider bounds this can only differ if a msg fits two lcs.
+     (see the determine_lcs_chunks tests for lcs crossing the chunk bounds) */
+    std::vector<LIST_OF_MSGS::iterator> bounds;
+    size_t i=0;
+    for (LIST_OF_MSGS::iterator it = ecu.msgs.begin(); it!=ecu.msgs.end(); ++it, ++i)
+        if ((i%chunk_msgs)==0 && (ecu.msgs.size()-i) >= chunk_msgs) bounds.push_back(it); // the last chunk takes the rest
+    bounds.push_back(ecu.msgs.end());
+    std::vector<LIST_OF_LCS> chunk_lcs(bounds.size()-1);
+    std::vector<const DltMessage *> last_msgs(chunk_lcs.size());
+    pool->parallel_for(chunk_lcs.size(), [&](size_t c){
+        Trace_Span span("lcs_chunk", "task");
+        LIST_OF_MSGS::iterator it = bounds[c];
+        // a msg without tmsp would start a new lc only as first msg of the ECU. Otherwise it's ignored:
+        if (c>0)
+            while (it!=bounds[c+1] && (*it)->headerextra.tmsp==0) ++it;
+        LC_Detector detector(chunk_lcs[c]);
+        for (; it!=bounds[c+1]; ++it)
+            detector.add(*it);
+        last_msgs[c] = detector.last_msg();
+    });
+    
+    ecu.lcs.swap(chunk_lcs[0]);
+    const DltMessage *prev_msg = last_msgs[0];
+    for (size_t c=1; c<chunk_lcs.size(); ++c){
+        LIST_OF_LCS &lcs = chunk_lcs[c];
+        // the lc the sequential detection would check first (see LC_Detector::add):
+        LIST_OF_LCS::iterator prev_l = ecu.lcs.end();
+        for (LIST_OF_LCS::iterator lit = ecu.lcs.begin(); prev_l==ecu.lcs.end() && lit!=ecu.lcs.end(); ++lit)
+            if ((*lit).msgs.size() && (*lit).msgs.back()==prev_msg) prev_l = lit;
+        while (lcs.size()){
+            LIST_OF_LCS::iterator it = lcs.begin();
+            const DltMessage &first_msg = *(*it).msgs.front();
+            /* join only if the sequential detection would have added the first msg
+             to the earlier part. Otherwise it would have started a new lc as well: */
+            LIST_OF_LCS::iterator join_l = ecu.lcs.end();
+            if (prev_l!=ecu.lcs.end() && would_fit(*prev_l, first_msg)) join_l = prev_l;
+            for (LIST_OF_LCS::iterator lit = ecu.lcs.begin(); join_l==ecu.lcs.end() && lit!=ecu.lcs.end(); ++lit)
+                if (would_fit(*lit, first_msg)) join_l = lit;
+            prev_l = ecu.lcs.end(); // only the first lc of the chunk follows the previous chunk directly
+            // the earlier part is joined into the later one. So the msgs stay in order of arrival:
+            if (join_l!=ecu.lcs.end() && (*it).expand_if_intersects(*join_l)){
+                std::swap(*join_l, *it);
+                lcs.erase(it);
+            }else
+                ecu.lcs.splice(ecu.lcs.end(), lcs, it);
+        }
+        if (last_msgs[c]) prev_msg = last_msgs[c];
+    }
+    // the bounds of the joined ones depend on the order. For the others the replay doesn't change anything:
+    std::vector<Lifecycle *> lcs_v;
+    for (LIST_OF_LCS::iterator it = ecu.lcs.begin(); it!=ecu.lcs.end(); ++it)
+        lcs_v.push_back(&(*it));
+    pool->parallel_for(lcs_v.size(), [&](size_t i){ replay_lc_bounds(*lcs_v[i]); });
     return 0; // success
 }
 
@@ -751,11 +1223,24 @@ bool compare_usecbegin(const OverallLC &first, const OverallLC &second)
     return false;
 }
 
-int sort_msgs_lcs(ECU_Info &ecu)
+int sort_msgs_lcs(ECU_Info &ecu, ThreadPool *pool)
 {
     if (verbose>1) cout << "sorting...\n";
-    for (LIST_OF_LCS::iterator it = ecu.lcs.begin(); it!=ecu.lcs.end(); ++it){
-        (*it).msgs.sort(compare_tmsp);
+    if (pool){
+        // the lcs differ a lot in size. So let the pool balance them:
+        Task_Group group(*pool);
+        for (LIST_OF_LCS::iterator it = ecu.lcs.begin(); it!=ecu.lcs.end(); ++it){
+            LIST_OF_MSGS *msgs = &(*it).msgs;
+            group.run([msgs](){
+                Trace_Span span("sort_lc", "task");
+                msgs->sort(compare_tmsp);
+            });
+        }
+        group.wait();
+    }else{
+        for (LIST_OF_LCS::iterator it = ecu.lcs.begin(); it!=ecu.lcs.end(); ++it){
+            (*it).msgs.sort(compare_tmsp);
+        }
     }
     if (verbose>1) cout << "...done\n";
     return 0; // success
@@ -786,11 +1271,11 @@ int merge_lcs(ECU_Info &ecu)
     return 0; // success
 }
 
-void debug_print(const LIST_OF_LCS &lcs)
+void debug_print(const LIST_OF_LCS &lcs, std::ostream &os)
 {
     // cout << lcs.size() << " lifecycle\n";
     for (LIST_OF_LCS::const_iterator it = lcs.begin(); it!=lcs.end(); ++it){
-        (*it).debug_print();
+        (*it).debug_print(os);
     }
 }
 
@@ -837,17 +1322,16 @@ bool OverallLC::expand_if_intersects(const Lifecycle &lc)
     return true;
 }
 
-bool OverallLC::output_to_fstream(std::ofstream &f, bool timeadjust)
+void OverallLC::determine_output_order(VEC_OF_OUT_MSGS &order)
 {
-    /* this is the main function to output/merge the different lifecycles
+    /* this is the main function to merge the different lifecycles
      belonging to an overall lifecycle.
      The lifecycles itself are sorted already but they have different
      initial offsets. The time-offset between ECUs is determined by:
      lc sec_begin minus min_tmsp plus the timestamp
+     The msgs are appended to order in the sequence they need to be output.
      */
     
-    assert(f.is_open());
-    
     /* for each lifecycle/associated msg list we keep in a vector
      iterator current and end
      next_time in us resolution */
@@ -905,14 +1389,12 @@ bool OverallLC::output_to_fstream(std::ofstream &f, bool timeadjust)
         // now output msgs from index until time >next time:
         do{
             DltMessage *msg=*(index->it);
-            int64_t tmsp = multiply((int64_t)(msg->headerextra.tmsp)*usecs_per_tmsp, index->clock_skew); // this needs to be done before output_message!
-            if (timeadjust){
-                // change the DltMessage
-                int64_t t = index->usec_begin + multiply((((int64_t)msg->headerextra.tmsp) * usecs_per_tmsp),index->clock_skew);
-                msg->storageheader->seconds = (uint32_t)(t / usecs_per_sec);
-                msg->storageheader->microseconds = t % usecs_per_sec;
-            }
-            output_message(msg, f); // see below!
+            int64_t tmsp = multiply((int64_t)(msg->headerextra.tmsp)*usecs_per_tmsp, index->clock_skew);
+            Out_Msg o;
+            o.msg = msg;
+            o.usec_begin = index->usec_begin;
+            o.clock_skew = index->clock_skew;
+            order.push_back(o);
             ++(index->it);
             if (index->it != index->end){
                 msg = *(index->it); // in case somebody uses it from now on.
@@ -951,44 +1433,78 @@ bool OverallLC::output_to_fstream(std::ofstream &f, bool timeadjust)
         // output the msgs sequentially:
         LC_it &l=vec[0];
         for(; l.it!=l.end; ++l.it){
-            DltMessage *msg = *(l.it);
-            if (timeadjust){
-                // change the DltMessage
-                int64_t t = l.usec_begin + multiply(usecs_per_tmsp*((int64_t)msg->headerextra.tmsp), l.clock_skew);
-                msg->storageheader->seconds = (uint32_t)(t / usecs_per_sec);
-                msg->storageheader->microseconds = t % usecs_per_sec;
-            }
-            output_message(msg, f); // take care. after this call the message is corrupt! (endianess...)
+            Out_Msg o;
+            o.msg = *(l.it);
+            o.usec_begin = l.usec_begin;
+            o.clock_skew = l.clock_skew;
+            order.push_back(o);
         }
         vec.erase(vec.begin());
     }
+}
+
+size_t OverallLC::nr_msgs() const
+{
+    size_t ret=0;
+    for (LIST_OF_LCS::const_iterator it = lcs.begin(); it!=lcs.end(); ++it)
+        ret += (*it).msgs.size();
+    return ret;
+}
+
+bool OverallLC::output_to_fstream(std::ofstream &f, bool timeadjust, Nav_Index_Writer *index)
+{
+    assert(f.is_open());
+    
+    VEC_OF_OUT_MSGS order;
+    order.reserve(nr_msgs());
+    determine_output_order(order);
+    
+    // the payloads kept in the input files are read ahead in the output order:
+    Payload_Planner *planner = use_payload_refs ? new Payload_Planner(order, 0, order.size()) : 0;
+    Payload_Block_Cache blocks; // the compressed ones
+    std::vector<char> buf; // the msgs aren't changed (e.g. by timeadjust). So they can be output again
+    for (size_t i=0; i<order.size(); ++i){
+        const DltMessage *msg = order[i].msg;
+        const unsigned char *payload = 0;
+        if (planner && (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF)) payload = planner->payload(i);
+        else if (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK) payload = blocks.payload(*msg);
+        buf.resize(get_message_size(*msg));
+        f.write(&buf[0], serialize_message(order[i], timeadjust, &buf[0], payload));
+        if (index) index->add(order[i]);
+    }
+    delete planner;
     
     return true; // success
 }
 
 int determine_overall_lcs()
 {
-    assert(list_olcs.size()==0);
+    return determine_overall_lcs(map_ecus, list_olcs);
+}
+
+int determine_overall_lcs(MAP_OF_ECUS &ecus, LIST_OF_OLCS &olcs)
+{
+    assert(olcs.size()==0);
     
-    // populate list_olcs with the merged/intersected lcs from map_ecus
-    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!= map_ecus.end(); ++it){
+    // populate olcs with the merged/intersected lcs from ecus
+    for (MAP_OF_ECUS::iterator it=ecus.begin(); it!= ecus.end(); ++it){
         ECU_Info &info = it->second;
         for (LIST_OF_LCS::iterator lit=info.lcs.begin(); lit!=info.lcs.end(); ++lit){
             bool found_intersect=false;
             // iterate throug all olcs: this has O(n^2) complexity but we expect always very few lcs
-            for(LIST_OF_OLCS::iterator oit=list_olcs.begin(); !found_intersect && (oit!=list_olcs.end()); ++oit){
+            for(LIST_OF_OLCS::iterator oit=olcs.begin(); !found_intersect && (oit!=olcs.end()); ++oit){
                 if ((*oit).expand_if_intersects(*lit))
                     found_intersect=true;
             }
             // if not found then add new one:
             if (!found_intersect){
                 OverallLC nlc((*lit));
-                list_olcs.push_front(nlc);
+                olcs.push_front(nlc);
             }
         }
     }
     // now quickly sort them by start time:
-    list_olcs.sort(compare_usecbegin);
+    olcs.sort(compare_usecbegin);
     
     return 0; // success
 }
@@ -1012,17 +1528,17 @@ std::string get_ofstream_name(int cnt, std::string const &templ)
     return name;
 }
 
-std::ofstream *get_ofstream(int cnt, std::string const &templ)
+std::ofstream *get_ofstream(int cnt, std::string const &templ, char *buf, size_t buf_size)
 {
     std::string name(get_ofstream_name(cnt, templ));
     // now open the file:
     std::ofstream *f=new std::ofstream;
+    if (buf) f->rdbuf()->pubsetbuf(buf, buf_size); // needs to be done before open
     f->open(name.c_str(), ios_base::out | ios_base::binary | ios_base::trunc);
     if (!(f->is_open())){
         delete f;
         f=NULL;
-        cerr << "can't open <" << name << "> for writing! Aborting!";
-        abort();
+        cerr << "can't open <" << name << "> for writing!\n";
     }
     return f;
 }
@@ -1060,3 +1576,860 @@ int64_t multiply(int64_t a, double b)
     a >>= shift_bits;
     return a;
 }
+
+int output_split(LIST_OF_OLCS &olcs, std::string const &templ, bool timeadjust, ThreadPool &pool)
+{
+    /* output each overall lifecycle into its own file.
+     The olcs are independent from each other (each msg belongs to exactly one olc)
+     so we can write them concurrently. Each writer uses its own output buffer.
+     The file names depend only on the position within olcs so the result is the
+     same regardless of the number of threads. */
+    std::vector<OverallLC *> vec;
+    for (LIST_OF_OLCS::iterator it=olcs.begin(); it!= olcs.end(); ++it)
+        vec.push_back(&(*it));
+    
+    const size_t buf_size = 1<<20; // 1MB per writer
+    std::atomic<int> error(0);
+    pool.parallel_for(vec.size(), [&](size_t i){
+        Trace_Span span("output_olc", "task");
+        std::vector<char> buf(buf_size);
+        std::ofstream *f = get_ofstream((int)i+1, templ, &buf[0], buf.size());
+        if (!f){
+            error = -1;
+            return;
+        }
+        Nav_Index_Writer *index = use_nav_index ? new Nav_Index_Writer(get_ofstream_name((int)i+1, templ)) : 0;
+        vec[i]->output_to_fstream(*f, timeadjust, index);
+        f->close();
+        if (f->fail()){
+            cerr << "error writing <" << get_ofstream_name((int)i+1, templ) << ">!\n";
+            error = -1;
+        }
+        delete f;
+        if (index && index->close()) error = -1;
+        delete index;
+    });
+    return error.load(); // 0 = success
+}
+
+#ifndef WIN32
+static int preallocate(int fd, uint64_t size)
+{
+    /* reserves the blocks for the file. 0 or the errno (e.g. ENOSPC or
+     EOPNOTSUPP if the file system doesn't support it). */
+#if defined(__linux__)
+    return posix_fallocate(fd, 0, (off_t)size);
+#elif defined(__APPLE__)
+    fstore_t store;
+    memset(&store, 0, sizeof(store));
+    store.fst_flags = F_ALLOCATECONTIG;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_length = (off_t)size;
+    if (fcntl(fd, F_PREALLOCATE, &store)==-1){
+        store.fst_flags = F_ALLOCATEALL;
+        if (fcntl(fd, F_PREALLOCATE, &store)==-1) return errno;
+    }
+    return 0;
+#else
+    (void)fd; (void)size;
+    return EOPNOTSUPP;
+#endif
+}
+#endif
+
+int output_mmap(LIST_OF_OLCS &olcs, std::string const &name, bool timeadjust, ThreadPool &pool)
+{
+    /* output all olcs into a single file.
+     The output order and the size of each msg is known upfront. So we determine
+     the offset of each msg in the file (prefix sum), preallocate the file, map
+     it into memory and let all threads fill disjoint ranges.
+     The result is byte identical to output_to_fstream.
+     Returns <0 if the file could not be preallocated or mapped. Nothing is written in that case
+     and the caller needs to use the output_to_fstream way. -3 if just the nav
+     index couldn't be written (the output itself is complete). */
+#ifdef WIN32
+    (void)olcs; (void)name; (void)timeadjust; (void)pool;
+    return -1;
+#else
+    // 1. determine the output order (each olc on its own):
+    std::vector<OverallLC *> vec_olcs;
+    for (LIST_OF_OLCS::iterator it=olcs.begin(); it!= olcs.end(); ++it)
+        vec_olcs.push_back(&(*it));
+    std::vector<VEC_OF_OUT_MSGS> orders(vec_olcs.size());
+    pool.parallel_for(vec_olcs.size(), [&](size_t i){
+        Trace_Span span("output_order", "task");
+        orders[i].reserve(vec_olcs[i]->nr_msgs());
+        vec_olcs[i]->determine_output_order(orders[i]);
+    });
+    VEC_OF_OUT_MSGS order;
+    size_t nr_msgs=0;
+    for (size_t i=0; i<orders.size(); ++i) nr_msgs += orders[i].size();
+    order.reserve(nr_msgs);
+    for (size_t i=0; i<orders.size(); ++i){
+        order.insert(order.end(), orders[i].begin(), orders[i].end());
+        VEC_OF_OUT_MSGS().swap(orders[i]); // free it
+    }
+    
+    // 2. prefix sum of the msg sizes:
+    std::vector<uint64_t> offsets(order.size()+1);
+    offsets[0]=0;
+    for (size_t i=0; i<order.size(); ++i)
+        offsets[i+1] = offsets[i] + get_message_size(*order[i].msg);
+    const uint64_t file_size = offsets[order.size()];
+    
+    // 3. preallocate and map the file:
+    int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd<0){
+        cerr << "can't open <" << name << "> for writing!\n";
+        return -1;
+    }
+    if (file_size==0){
+        close(fd);
+        return (use_nav_index && write_nav_index(name, order)) ? -3 : 0;
+    }
+    // without the blocks reserved writing via the mapping fails with SIGBUS (e.g. no space left):
+    int ret = preallocate(fd, file_size);
+    if (ret!=0){
+        cerr << "can't preallocate <" << name << "> (" << strerror(ret) << ")\n";
+        close(fd);
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)file_size)!=0){
+        cerr << "can't resize <" << name << "> to " << file_size << " bytes!\n";
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED){
+        cerr << "can't map <" << name << "> (" << strerror(errno) << ")\n";
+        close(fd);
+        return -1;
+    }
+    char *dst = (char *)map;
+    
+    // 4. fill the ranges:
+    const size_t nr_chunks = std::min(order.size(), (size_t)pool.size()*8);
+    pool.parallel_for(nr_chunks, [&](size_t c){
+        Trace_Span span("output_chunk", "task");
+        size_t beg = (order.size() * c) / nr_chunks;
+        size_t end = (order.size() * (c+1)) / nr_chunks;
+        Payload_Planner *planner = use_payload_refs ? new Payload_Planner(order, beg, end) : 0;
+        Payload_Block_Cache blocks;
+        for (size_t i=beg; i<end; ++i){
+            const unsigned char *payload = 0;
+            if (planner && (order[i].msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF)) payload = planner->payload(i);
+            else if (order[i].msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK) payload = blocks.payload(*order[i].msg);
+            size_t size = serialize_message(order[i], timeadjust, dst+offsets[i], payload);
+            assert(size == offsets[i+1]-offsets[i]);
+            (void)size;
+        }
+        delete planner;
+    });
+    
+    int toret = 0;
+    if (munmap(map, (size_t)file_size)!=0) toret = -2;
+    if (close(fd)!=0) toret = -2;
+    if (toret) cerr << "error writing <" << name << ">!\n";
+    else if (use_nav_index && write_nav_index(name, order)) toret = -3;
+    return toret;
+#endif
+}
+
+const char * const sort_stage_names[NR_STAGES] = {"parse", "lifecycles", "skew", "merge", "sort", "overall_lcs", "output"};
+
+void init_Sort_Stats(Sort_Stats &stats)
+{
+    stats.nr_msgs = 0;
+    stats.nr_duplicates = 0;
+    stats.bytes_read = 0;
+    stats.bytes_written = 0;
+    stats.nr_olcs = 0;
+    stats.peak_rss_bytes = 0;
+    memset(&stats.parse, 0, sizeof(stats.parse));
+    memset(stats.stages, 0, sizeof(stats.stages));
+    memset(&stats.total, 0, sizeof(stats.total));
+    stats.ecus.clear();
+}
+
+double get_wall_secs()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+double get_cpu_secs()
+{
+#ifdef WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru)!=0) return 0.0;
+    return (double)ru.ru_utime.tv_sec + (double)ru.ru_stime.tv_sec + ((double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000000.0);
+#endif
+}
+
+int64_t get_peak_rss()
+{
+#ifdef WIN32
+    return 0; // unknown
+#else
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru)!=0) return 0;
+#ifdef __APPLE__
+    return (int64_t)ru.ru_maxrss; // in bytes on OSX
+#else
+    return (int64_t)ru.ru_maxrss * 1024; // in kbytes on Linux
+#endif
+#endif
+}
+
+Stage_Clock::Stage_Clock(Sort_Stats *stats, Sort_Stage stage, const char *detail) : time(stats ? &stats->stages[stage] : 0), wall_begin(0.0), cpu_begin(0.0), span(sort_stage_names[stage], "stage", detail)
+{
+    if (!time) return;
+    wall_begin = get_wall_secs();
+    cpu_begin = get_cpu_secs();
+}
+
+Stage_Clock::~Stage_Clock()
+{
+    if (!time) return;
+    static std::mutex mutex; // the per ECU stages run in parallel
+    double wall = get_wall_secs() - wall_begin;
+    double cpu = get_cpu_secs() - cpu_begin;
+    std::lock_guard<std::mutex> lock(mutex);
+    time->wall_secs += wall;
+    time->cpu_secs += cpu;
+}
+
+Run_Clock::Run_Clock(Sort_Stats *stats) : time(stats ? &stats->total : 0), wall_begin(get_wall_secs()), cpu_begin(get_cpu_secs())
+{
+}
+
+Run_Clock::~Run_Clock()
+{
+    if (!time) return;
+    time->wall_secs = get_wall_secs() - wall_begin;
+    time->cpu_secs = get_cpu_secs() - cpu_begin;
+}
+
+static void set_stage_mem(Sort_Stats *stats, Sort_Stage stage, const Mem_Usage &usage)
+{
+    if (stats) stats->stages[stage].mem = usage;
+}
+
+int64_t get_file_size(std::string const &name)
+{
+    std::ifstream f(name.c_str(), ios::in|ios::binary);
+    if (!f.is_open()) return 0;
+    f.seekg(0, f.end);
+    return (int64_t)f.tellg();
+}
+
+static int parse_files_parallel(std::vector<std::string> const &ifiles, Sort_Stats *stats, ThreadPool &pool)
+{
+    /* each file is parsed into its own map and arena. Appending the msgs of
+     each file to map_ecus in the order of the files afterwards results in the
+     same order as parsing one file after the other. */
+    for (size_t i=0; i<ifiles.size(); i++){
+        if (!std::ifstream(ifiles[i].c_str(), ios::in|ios::binary).is_open()){
+            cerr << "can't open <" << ifiles[i] << "> as file for input!\n";
+            return -1;
+        }
+        printf("Processing file %s:\n", ifiles[i].c_str());
+    }
+    std::vector<MAP_OF_ECUS> maps(ifiles.size());
+    std::vector<MsgArena *> arenas(ifiles.size());
+    std::vector<Parse_Stats> parse_stats(ifiles.size());
+    pool.parallel_for(ifiles.size(), [&](size_t i){
+        Trace_Span span("parse_file", "task", ifiles[i].c_str());
+        memset(&parse_stats[i], 0, sizeof(parse_stats[i]));
+        arenas[i] = new MsgArena;
+        std::ifstream fin(ifiles[i].c_str(), ios::in|ios::binary);
+        (void)process_input(fin, &parse_stats[i], (int)i, maps[i], *arenas[i]); // and ignore parsing errors
+    });
+    for (size_t i=0; i<ifiles.size(); i++){
+        for (MAP_OF_ECUS::iterator it=maps[i].begin(); it!=maps[i].end(); ++it){
+            LIST_OF_MSGS &msgs = map_ecus[it->first].msgs;
+            msgs.splice(msgs.end(), it->second.msgs);
+        }
+        msg_arena.take_over(*arenas[i]);
+        delete arenas[i];
+        if (stats){
+            stats->parse.nr_msgs += parse_stats[i].nr_msgs;
+            stats->parse.nr_filtered += parse_stats[i].nr_filtered;
+            stats->parse.nr_skipped += parse_stats[i].nr_skipped;
+            stats->parse.resync_bytes += parse_stats[i].resync_bytes;
+            stats->parse.payload_bytes_raw += parse_stats[i].payload_bytes_raw;
+            stats->parse.payload_bytes_compressed += parse_stats[i].payload_bytes_compressed;
+            stats->bytes_read += get_file_size(ifiles[i]);
+        }
+    }
+    return 0;
+}
+
+typedef struct{
+    uint32_t ecu_id;
+    char ecu[5];
+    ECU_Info *info;
+    size_t nr_lcs; // detected
+    std::string lcs_detected; // debug_print of the lcs as detected
+    int nr_filtered;
+    int64_t skew_error; // of --fast_skew
+    int64_t nr_duplicates; // removed by --dedup
+    size_t nr_lcs_unmerged; // before the merge (after the filtered msgs are removed)
+    std::string lcs_merged; // debug_print after the merge (if changed)
+} ECU_Task;
+
+static void analyse_ecu(ECU_Task &t, Sort_Stage stage, ThreadPool &pool)
+{
+    /* one of lifecycle detection, clock skew, merge and sort for one ECU.
+     The output is kept in t and printed in the order of the ECUs later. */
+    ECU_Info &info = *t.info;
+    Trace_Span ecu_span(sort_stage_names[stage], "ecu", t.ecu);
+    switch (stage){
+        case STAGE_LCS:{
+            if (!info.lcs.size()) determine_lcs(info, &pool); // otherwise done by the pipeline already
+            // now we expect at least one lc!
+            assert(info.lcs.size()>0);
+            t.nr_lcs = info.lcs.size();
+            std::ostringstream os;
+            debug_print(info.lcs, os);
+            t.lcs_detected = os.str();
+            break;
+        }
+        case STAGE_SKEW:
+            t.skew_error = determine_clock_skew(info, &pool);
+            break;
+        case STAGE_MERGE:
+            // the filtered msgs were needed for the timing only:
+            t.nr_filtered = remove_filtered_msgs(info);
+            t.nr_lcs_unmerged = info.lcs.size();
+            // now see whether they overlap (the detection does not always work 100%
+            // esp. on short lifecycles):
+            merge_lcs(info);
+            // duplicates from overlapping captures are in the same lc now:
+            if (use_dedup) t.nr_duplicates = remove_duplicates(info, &pool);
+            break;
+        case STAGE_SORT:
+            sort_msgs_lcs(info, &pool);
+            if (info.lcs.size() != t.nr_lcs_unmerged){
+                std::ostringstream os_merged;
+                debug_print(info.lcs, os_merged);
+                t.lcs_merged = os_merged.str();
+            }
+            break;
+        default:
+            assert(false);
+    }
+}
+
+static void analyse_ecus_stage(std::vector<ECU_Task> &ecu_tasks, Sort_Stage stage, Sort_Stats *stats, ThreadPool &pool)
+{
+    /* the ECUs are independent from each other. The work per ECU differs a lot
+     (e.g. one chatty ECU) so each ECU is a task (and e.g. each lc within for
+     sorting). The stage is timed once around all ECUs as they overlap. */
+    Stage_Clock stage_clock(stats, stage);
+    Task_Group group(pool);
+    for (size_t i=0; i<ecu_tasks.size(); ++i){
+        ECU_Task *t = &ecu_tasks[i];
+        group.run([t, stage, &pool](){ analyse_ecu(*t, stage, pool); });
+    }
+    group.wait();
+}
+
+int analyse_ecus(std::vector<std::string> const &ifiles, Sort_Stats *stats, ThreadPool &pool)
+{
+    /* parsing and all per ECU stages. The result is in the lcs of map_ecus (and the msgs in msg_arena).
+     The payload files are open if use_payload_refs. */
+    
+    // let's process the input files:
+    if (use_pipeline){
+        Stage_Clock stage_clock(stats, STAGE_PARSE, "pipeline");
+        if (parse_pipelined(ifiles, stats)) return -1;
+    }else if (use_io_uring){
+        Stage_Clock stage_clock(stats, STAGE_PARSE, "io_uring");
+        if (parse_read_ahead(ifiles, stats)) return -1;
+    }else if (pool.size()>1 && ifiles.size()>1 && !mem_limit){ // the payload refs need the order of the files
+        Stage_Clock stage_clock(stats, STAGE_PARSE, "parallel");
+        if (parse_files_parallel(ifiles, stats, pool)) return -1;
+    }else for (size_t i=0; i<ifiles.size(); i++){
+        Stage_Clock stage_clock(stats, STAGE_PARSE, ifiles[i].c_str());
+        printf("Processing file %s:\n", ifiles[i].c_str());
+        std::ifstream fin;
+        fin.open(ifiles[i].c_str(), ios::in|ios::binary);
+        if (fin.is_open()){
+            
+            (void)process_input(fin, stats ? &stats->parse : 0, (int)i); // and ignore parsing errors. just continue with next file
+            
+            if (stats) stats->bytes_read += get_file_size(ifiles[i]);
+            fin.close();
+        } else {
+            cerr << "can't open <" << ifiles[i] << "> as file for input!\n";
+            return -1;
+        }
+    }
+    
+    Mem_Usage usage;
+    get_mem_usage(usage);
+    set_stage_mem(stats, STAGE_PARSE, usage);
+    if (verbose) print_mem_usage("parsing", usage);
+    // --dedup compares the payloads as well:
+    if (use_payload_refs && open_payload_files(ifiles)){
+        map_ecus.clear();
+        msg_arena.release();
+        return -1;
+    }
+    
+    analyse_ecus(map_ecus, stats, pool);
+    get_mem_usage(usage);
+    for (int stage=STAGE_LCS; stage<=STAGE_SORT; ++stage) set_stage_mem(stats, (Sort_Stage)stage, usage);
+    if (verbose) print_mem_usage("lifecycle detection", usage);
+    return 0;
+}
+
+int analyse_ecus(MAP_OF_ECUS &ecus, Sort_Stats *stats, ThreadPool &pool)
+{
+    // all per ECU stages on the parsed msgs. Afterwards the msgs of each ECU are in its lcs.
+    
+    // now print some stats:
+    // iterate through the list of ECUs:
+    std::vector<ECU_Task> ecu_tasks;
+    for (MAP_OF_ECUS::iterator it=ecus.begin(); it!= ecus.end(); ++it){
+        ECU_Task t;
+        t.ecu_id = it->first;
+        t.ecu[4]=0;
+        memcpy(t.ecu, (char*) &it->first, sizeof(uint32_t));
+        t.info = &it->second;
+        t.nr_lcs = 0;
+        t.nr_filtered = 0;
+        t.skew_error = 0;
+        t.nr_duplicates = 0;
+        t.nr_lcs_unmerged = 0;
+        ecu_tasks.push_back(t);
+        cout << "ECU <" << t.ecu << "> contains " << it->second.msgs.size() << " msgs\n";
+    }
+    
+    /* determine lifecycles for each ECU:
+     A new lifecycle is determined by the time distance between abs and rel timestamps.
+     Then the clock skew per ECU, the merge and the sort. Each stage for all ECUs.
+     */
+    analyse_ecus_stage(ecu_tasks, STAGE_LCS, stats, pool);
+    if (use_clock_drift_detection) analyse_ecus_stage(ecu_tasks, STAGE_SKEW, stats, pool);
+    analyse_ecus_stage(ecu_tasks, STAGE_MERGE, stats, pool);
+    analyse_ecus_stage(ecu_tasks, STAGE_SORT, stats, pool);
+    for (size_t i=0; i<ecu_tasks.size(); ++i){
+        const ECU_Task &t = ecu_tasks[i];
+        ECU_Info &info = *t.info;
+        cout << "ECU <" << t.ecu << "> contains " << t.nr_lcs << " lifecycle\n";
+        cout << t.lcs_detected;
+        
+        size_t nr_lcs = t.nr_lcs;
+        if (t.nr_filtered){
+            if (verbose) cout << "ECU <" << t.ecu << "> removed " << t.nr_filtered << " filtered msgs\n";
+        }
+        if (t.nr_duplicates){
+            cout << "ECU <" << t.ecu << "> removed " << t.nr_duplicates << " duplicate msgs\n";
+        }
+        if (t.lcs_merged.length()){
+            cout << "ECU <" << t.ecu << "> contains " << info.lcs.size() << " lifecycle after merge:\n";
+            cout << t.lcs_merged;
+        }
+        if (stats){
+            ECU_Stats es;
+            es.ecu = t.ecu_id;
+            es.nr_msgs = info.msgs.size();
+            es.nr_lcs = nr_lcs;
+            es.nr_lcs_merged = info.lcs.size();
+            es.clock_skew = info.lcs.size() ? info.lcs.front().clock_skew : 1.0;
+            if (use_skew_per_lc){
+                for (LIST_OF_LCS::const_iterator it=info.lcs.begin(); it!=info.lcs.end(); ++it)
+                    es.lc_clock_skews.push_back((*it).clock_skew);
+            }
+            es.skew_error_usecs = t.skew_error;
+            es.nr_duplicates = t.nr_duplicates;
+            stats->ecus.push_back(es);
+            stats->nr_msgs += es.nr_msgs;
+            stats->nr_duplicates += es.nr_duplicates;
+        }
+        // all msgs are in the lcs now:
+        LIST_OF_MSGS().swap(info.msgs);
+    }
+    return 0;
+}
+
+static void reset_sort_state()
+{
+    // all msgs and payloads are kept in the arena so we just need to release its chunks:
+    list_olcs.clear();
+    map_ecus.clear();
+    msg_arena.release();
+    close_payload_files();
+}
+
+int analyse_dlt_files(std::vector<std::string> const &ifiles, Sort_Stats *stats, ThreadPool &pool)
+{
+    /* all stages but the output. The result is in list_olcs (and the msgs in msg_arena).
+     On errors nothing is kept so that it can be called again. */
+    if (analyse_ecus(ifiles, stats, pool)){
+        reset_sort_state();
+        return -1;
+    }
+    
+    /* now determine the set of lifecycles that belong to each other 
+     */
+    {
+        Stage_Clock stage_clock(stats, STAGE_OVERALL_LCS);
+        determine_overall_lcs();
+    }
+    Mem_Usage usage;
+    get_mem_usage(usage);
+    set_stage_mem(stats, STAGE_OVERALL_LCS, usage);
+    if (verbose) print_mem_usage("overall lifecycle detection", usage);
+    // the lcs are copied into the overall lcs. So we don't need the ECUs any longer:
+    map_ecus.clear();
+    
+    // print them:
+    if (verbose>0){
+        cout << "Overall lifecycles detected (" << list_olcs.size() << ")\n";
+        debug_print(list_olcs);
+    }
+    return 0;
+}
+
+static int output_olcs(LIST_OF_OLCS &olcs, std::string const &ofilename, bool do_split, bool do_timeadjust, ThreadPool &pool)
+{
+    /* if do_split is set we have to maintain a new file for each olc.
+     otherwise just output to a single file.
+     returns 0 on success, -1 if a file can't be opened or written.
+     */
+    if (do_split) return output_split(olcs, ofilename, do_timeadjust, pool);
+    if (use_mmap_output){
+        int ret = output_mmap(olcs, ofilename, do_timeadjust, pool);
+        if (ret==0) return 0;
+        if (ret==-3) return -1; // the output is complete. Writing it again wouldn't help the index
+        cerr << "mmap output failed. Falling back to default output.\n";
+    }
+    std::ofstream *f=get_ofstream(0, ofilename);
+    if (!f) return -1;
+    Nav_Index_Writer *index = use_nav_index ? new Nav_Index_Writer(ofilename) : 0;
+    for (LIST_OF_OLCS::iterator it=olcs.begin(); it!= olcs.end(); ++it){
+        (*it).output_to_fstream(*f, do_timeadjust, index);
+    }
+    f->close();
+    int toret = 0;
+    if (f->fail()){
+        cerr << "error writing <" << ofilename << ">!\n";
+        toret = -1;
+    }
+    delete f;
+    if (index && index->close()) toret = -1;
+    delete index;
+    return toret;
+}
+
+int sort_dlt_files(std::vector<std::string> const &ifiles, std::string const &ofilename, bool do_split, bool do_timeadjust, Sort_Stats *stats)
+{
+    std::vector<Output_Spec> outputs(1);
+    init_Output_Spec(outputs[0]);
+    outputs[0].name = ofilename;
+    outputs[0].split = do_split;
+    outputs[0].timeadjust = do_timeadjust;
+    return sort_dlt_files(ifiles, outputs, stats);
+}
+
+int sort_dlt_files(std::vector<std::string> const &ifiles, std::vector<Output_Spec> const &outputs, Sort_Stats *stats)
+{
+    if (stats) init_Sort_Stats(*stats);
+    Run_Clock run_clock(stats);
+    init_mem_budget();
+    // used by all stages. Each stage splits its work into tasks:
+    ThreadPool pool((unsigned int)nr_jobs);
+    if (verbose) cout << " using " << pool.size() << " threads\n";
+    
+    if (analyse_dlt_files(ifiles, stats, pool)) return -1;
+    
+    // now output to file(s). A single one can use the parallel ways:
+    const bool single = outputs.size()==1 && !outputs[0].per_ecu;
+    const std::string &ofilename = outputs[0].name;
+    const bool do_split = outputs[0].split;
+    int64_t bytes_written = 0;
+    int ret = 0;
+    {
+        Stage_Clock stage_clock(stats, STAGE_OUTPUT);
+        if (single) ret = output_olcs(list_olcs, ofilename, do_split, outputs[0].timeadjust, pool);
+        else ret = output_fan_out(list_olcs, outputs, &bytes_written);
+        close_payload_files();
+    }
+    Mem_Usage usage;
+    get_mem_usage(usage);
+    set_stage_mem(stats, STAGE_OUTPUT, usage);
+    if (stats){
+        stats->nr_olcs = list_olcs.size();
+        if (!single)
+            stats->bytes_written = bytes_written;
+        else if (do_split){
+            for (size_t i=0; i<list_olcs.size(); ++i)
+                stats->bytes_written += get_file_size(get_ofstream_name((int)i+1, ofilename));
+        }else
+            stats->bytes_written = get_file_size(ofilename);
+        stats->peak_rss_bytes = get_peak_rss();
+    }
+    
+    // free memory. Afterwards the state is reset so that it can be called again.
+    if (verbose>=2) cout << "deallocating " << msg_arena.nr_chunks() << " chunks with " << msg_arena.bytes_used() << " bytes\n";
+    reset_sort_state();
+    
+    return ret;
+}
+
+int get_file_stamp(std::string const &name, File_Stamp &stamp)
+{
+    struct stat st;
+    if (stat(name.c_str(), &st)) return -1;
+    stamp.size = (int64_t)st.st_size;
+    stamp.mtime = (int64_t)st.st_mtime;
+    return 0;
+}
+
+void init_Output_Selection(Output_Selection &sel)
+{
+    sel.ecus.clear();
+    sel.usec_from = 0;
+    sel.usec_to = 0;
+}
+
+int Sort_Context::analyse(std::vector<std::string> const &ifiles_, ThreadPool &pool)
+{
+    // check all files first. So on errors the current content is kept:
+    std::vector<File_Stamp> new_stamps(ifiles_.size());
+    for (size_t i=0; i<ifiles_.size(); ++i){
+        if (get_file_stamp(ifiles_[i], new_stamps[i]) || !std::ifstream(ifiles_[i].c_str(), ios::in|ios::binary).is_open()){
+            cerr << "can't open <" << ifiles_[i] << "> as file for input!\n";
+            return -1;
+        }
+    }
+    /* keep the unchanged files parsed already. The ECUs with msgs in the files
+     added, changed or removed need to be analysed again. As do the ECUs of a
+     file that moved before another one (the msgs are kept in the order of the files). */
+    SET_OF_IDS changed;
+    std::vector<Context_File *> files(ifiles_.size(), (Context_File *)0);
+    size_t max_kept = 0;
+    for (size_t i=0; i<ifiles_.size(); ++i){
+        for (size_t j=0; !files[i] && j<parsed.size(); ++j){
+            Context_File *f = parsed[j];
+            if (f && f->name==ifiles_[i] && f->stamp.size==new_stamps[i].size && f->stamp.mtime==new_stamps[i].mtime){
+                files[i] = f;
+                parsed[j] = 0;
+                if (j<max_kept){
+                    for (MAP_OF_ECUS::const_iterator it=f->ecus.begin(); it!=f->ecus.end(); ++it) changed.insert(it->first);
+                }else
+                    max_kept = j;
+            }
+        }
+    }
+    for (size_t j=0; j<parsed.size(); ++j){
+        if (!parsed[j]) continue;
+        for (MAP_OF_ECUS::const_iterator it=parsed[j]->ecus.begin(); it!=parsed[j]->ecus.end(); ++it) changed.insert(it->first);
+        delete parsed[j];
+    }
+    parsed.swap(files);
+    ifiles = ifiles_;
+    
+    // parse the new and changed files each into its own map and arena (like parse_files_parallel):
+    std::vector<size_t> to_parse;
+    for (size_t i=0; i<parsed.size(); ++i){
+        if (parsed[i]) continue;
+        parsed[i] = new Context_File;
+        parsed[i]->name = ifiles[i];
+        parsed[i]->stamp = new_stamps[i];
+        to_parse.push_back(i);
+        printf("Processing file %s:\n", ifiles[i].c_str());
+    }
+    // the payloads are needed for each output. So we keep them in memory:
+    int64_t prev_mem_limit = mem_limit;
+    mem_limit = 0;
+    init_mem_budget();
+    pool.parallel_for(to_parse.size(), [&](size_t k){
+        Context_File &f = *parsed[to_parse[k]];
+        Trace_Span span("parse_file", "task", f.name.c_str());
+        std::ifstream fin(f.name.c_str(), ios::in|ios::binary);
+        (void)process_input(fin, 0, (int)to_parse[k], f.ecus, f.arena); // and ignore parsing errors
+    });
+    mem_limit = prev_mem_limit;
+    nr_parsed = to_parse.size();
+    for (size_t k=0; k<to_parse.size(); ++k){
+        const MAP_OF_ECUS &f_ecus = parsed[to_parse[k]]->ecus;
+        for (MAP_OF_ECUS::const_iterator it=f_ecus.begin(); it!=f_ecus.end(); ++it) changed.insert(it->first);
+    }
+    if (!changed.size()) return 0;
+    
+    // the msgs of the changed ECUs from all files (in the order of the files):
+    MAP_OF_ECUS changed_ecus;
+    for (size_t i=0; i<parsed.size(); ++i){
+        for (MAP_OF_ECUS::const_iterator it=parsed[i]->ecus.begin(); it!=parsed[i]->ecus.end(); ++it){
+            if (!changed.count(it->first) || !it->second.msgs.size()) continue;
+            LIST_OF_MSGS &msgs = changed_ecus[it->first].msgs;
+            msgs.insert(msgs.end(), it->second.msgs.begin(), it->second.msgs.end());
+        }
+    }
+    analyse_ecus(changed_ecus, 0, pool);
+    for (SET_OF_IDS::const_iterator it=changed.begin(); it!=changed.end(); ++it) ecus.erase(*it); // incl. the ones without msgs now
+    for (MAP_OF_ECUS::iterator it=changed_ecus.begin(); it!=changed_ecus.end(); ++it)
+        ecus[it->first].lcs.swap(it->second.lcs);
+    
+    olcs.clear();
+    determine_overall_lcs(ecus, olcs);
+    if (verbose>0){
+        cout << "Overall lifecycles detected (" << olcs.size() << ")\n";
+        debug_print(olcs);
+    }
+    return 0;
+}
+
+bool Sort_Context::is_stale() const
+{
+    for (size_t i=0; i<parsed.size(); ++i){
+        File_Stamp stamp;
+        if (get_file_stamp(ifiles[i], stamp) || stamp.size!=parsed[i]->stamp.size || stamp.mtime!=parsed[i]->stamp.mtime)
+            return true;
+    }
+    return false;
+}
+
+int Sort_Context::refresh(ThreadPool &pool)
+{
+    // only the changed files are parsed again (see analyse):
+    if (!is_stale()) return 0;
+    std::vector<std::string> files(ifiles);
+    return analyse(files, pool) ? -1 : 1;
+}
+
+int Sort_Context::output(std::string const &ofilename, const Output_Selection &sel, bool do_split, bool do_timeadjust, ThreadPool &pool, int64_t *nr_msgs)
+{
+    if (!sel.ecus.size() && !sel.usec_from && !sel.usec_to){
+        if (output_olcs(olcs, ofilename, do_split, do_timeadjust, pool)) return -1;
+        if (nr_msgs) *nr_msgs = this->nr_msgs();
+        return 0;
+    }
+    // copy the lcs with the selected msgs only (the msgs themselves are shared):
+    LIST_OF_OLCS sel_olcs;
+    int64_t nr_sel = 0;
+    for (LIST_OF_OLCS::const_iterator oit=olcs.begin(); oit!=olcs.end(); ++oit){
+        sel_olcs.push_back(OverallLC());
+        OverallLC &olc = sel_olcs.back();
+        olc.usec_begin = (*oit).usec_begin;
+        olc.usec_end = (*oit).usec_end;
+        for (LIST_OF_LCS::const_iterator it=(*oit).lcs.begin(); it!=(*oit).lcs.end(); ++it){
+            const Lifecycle &lc = *it;
+            if (!lc.msgs.size()) continue;
+            if (sel.ecus.size() && !sel.ecus.count(get_ecu_id(*lc.msgs.front()))) continue;
+            if (sel.usec_to && lc.usec_begin >= sel.usec_to) continue; // all msgs are later
+            olc.lcs.push_back(Lifecycle());
+            Lifecycle &sel_lc = olc.lcs.back();
+            sel_lc.usec_begin = lc.usec_begin;
+            sel_lc.usec_end = lc.usec_end;
+            sel_lc.rel_offset_valid = lc.rel_offset_valid;
+            sel_lc.min_tmsp = lc.min_tmsp;
+            sel_lc.max_tmsp = lc.max_tmsp;
+            sel_lc.clock_skew = lc.clock_skew;
+            Out_Msg o;
+            o.usec_begin = lc.usec_begin;
+            o.clock_skew = lc.clock_skew;
+            for (LIST_OF_MSGS::const_iterator mit=lc.msgs.begin(); mit!=lc.msgs.end(); ++mit){
+                o.msg = *mit;
+                int64_t t = get_adjusted_time(o);
+                if ((sel.usec_from && t < sel.usec_from) || (sel.usec_to && t >= sel.usec_to)) continue;
+                sel_lc.msgs.push_back(*mit);
+            }
+            nr_sel += (int64_t)sel_lc.msgs.size();
+            if (!sel_lc.msgs.size()) olc.lcs.pop_back();
+        }
+        if (!olc.lcs.size()) sel_olcs.pop_back();
+    }
+    if (output_olcs(sel_olcs, ofilename, do_split, do_timeadjust, pool)) return -1;
+    if (nr_msgs) *nr_msgs = nr_sel;
+    return 0;
+}
+
+void Sort_Context::clear()
+{
+    ifiles.clear();
+    for (size_t i=0; i<parsed.size(); ++i) delete parsed[i];
+    parsed.clear();
+    ecus.clear();
+    olcs.clear();
+    nr_parsed = 0;
+}
+
+int64_t Sort_Context::nr_msgs() const
+{
+    int64_t ret = 0;
+    for (LIST_OF_OLCS::const_iterator it=olcs.begin(); it!=olcs.end(); ++it)
+        ret += (int64_t)(*it).nr_msgs();
+    return ret;
+}
+
+int write_stats_json(const Sort_Stats &stats, std::vector<std::string> const &ifiles, std::string const &name, int status)
+{
+    std::ofstream f(name.c_str(), ios::out|ios::trunc);
+    if (!f.is_open()){
+        cerr << "can't open <" << name << "> for writing!\n";
+        return -1;
+    }
+    f << "{\n \"version\": \"" << dlt_sort_version << "\",\n";
+    f << " \"status\": \"" << (status ? "failed" : "ok") << "\",\n \"exit_code\": " << status << ",\n";
+    f << " \"input_files\": [";
+    for (size_t i=0; i<ifiles.size(); ++i){
+        // escape the file names:
+        f << (i ? ", \"" : "\"");
+        for (size_t j=0; j<ifiles[i].length(); ++j){
+            char c = ifiles[i][j];
+            if (c=='"' || c=='\\') f << '\\';
+            f << c;
+        }
+        f << "\"";
+    }
+    f << "],\n";
+    f << " \"bytes_read\": " << stats.bytes_read << ",\n";
+    f << " \"bytes_written\": " << stats.bytes_written << ",\n";
+    f << " \"msgs_parsed\": " << stats.parse.nr_msgs << ",\n";
+    f << " \"msgs_filtered\": " << stats.parse.nr_filtered << ",\n";
+    f << " \"msgs_skipped\": " << stats.parse.nr_skipped << ",\n";
+    f << " \"resync_bytes\": " << stats.parse.resync_bytes << ",\n";
+    f << " \"msgs_output\": " << stats.nr_msgs << ",\n";
+    f << " \"msgs_duplicate\": " << stats.nr_duplicates << ",\n";
+    f << " \"overall_lcs\": " << stats.nr_olcs << ",\n";
+    f << " \"peak_rss_bytes\": " << stats.peak_rss_bytes << ",\n";
+    f << " \"mem_limit_bytes\": " << mem_limit << ",\n";
+    f << " \"payload_refs\": " << stats.parse.nr_payload_refs << ",\n";
+    f << " \"payload_blocks_raw_bytes\": " << stats.parse.payload_bytes_raw << ",\n";
+    f << " \"payload_blocks_bytes\": " << stats.parse.payload_bytes_compressed << ",\n";
+    f << " \"threads\": " << get_nr_threads(nr_jobs) << ",\n";
+    f << " \"stages\": {\n";
+    for (int i=0; i<NR_STAGES; ++i){
+        const Mem_Usage &m = stats.stages[i].mem;
+        f << "  \"" << sort_stage_names[i] << "\": {\"wall_secs\": " << stats.stages[i].wall_secs << ", \"cpu_secs\": " << stats.stages[i].cpu_secs;
+        f << ", \"mem\": {\"total\": " << get_mem_total(m) << ", \"msgs\": " << m.msgs << ", \"payloads\": " << m.payloads;
+        f << ", \"list_nodes\": " << m.list_nodes << ", \"lcs\": " << m.lcs << ", \"arena_reserved\": " << m.arena_reserved << "}},\n";
+    }
+    f << "  \"total\": {\"wall_secs\": " << stats.total.wall_secs << ", \"cpu_secs\": " << stats.total.cpu_secs << "}\n },\n";
+    f << " \"ecus\": [";
+    for (size_t i=0; i<stats.ecus.size(); ++i){
+        const ECU_Stats &e = stats.ecus[i];
+        char ecu[5];
+        ecu[4]=0;
+        memcpy(ecu, (char*) &e.ecu, sizeof(uint32_t));
+        for (int j=0; j<4; ++j) if (ecu[j] && (ecu[j]<0x20 || ecu[j]=='"' || ecu[j]=='\\' || ecu[j]>=0x7f)) ecu[j]='?';
+        f << (i ? ",\n" : "\n") << "  {\"ecu\": \"" << ecu << "\", \"msgs\": " << e.nr_msgs << ", \"lcs\": " << e.nr_lcs;
+        f << ", \"lcs_after_merge\": " << e.nr_lcs_merged << ", \"clock_skew\": " << setprecision(9) << e.clock_skew;
+        if (e.lc_clock_skews.size()){
+            f << ", \"lc_clock_skews\": [";
+            for (size_t j=0; j<e.lc_clock_skews.size(); ++j) f << (j ? ", " : "") << e.lc_clock_skews[j];
+            f << "]";
+        }
+        f << setprecision(6);
+        f << ", \"skew_error_usecs\": " << e.skew_error_usecs << ", \"duplicates\": " << e.nr_duplicates << "}";
+    }
+    f << "\n ]\n}\n";
+    f.close();
+    return f.fail() ? -1 : 0;
+}
@@ -0,0 +1,213 @@
+//
+//  fan_out.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <map>
+#include "fan_out.h"
+#include "mem_budget.h"
+#include "read_planner.h"
+#include "payload_blocks.h"
+#include "nav_index.h"
+#include "trace_events.h"
+
+using namespace std;
+
+const size_t fan_out_buf_size = 1<<20; // per output file
+
+void init_Output_Spec(Output_Spec &spec)
+{
+    spec.name.clear();
+    spec.split = false;
+    spec.timeadjust = false;
+    spec.per_ecu = false;
+}
+
+bool parse_output_spec(const char *arg, Output_Spec &spec)
+{
+    init_Output_Spec(spec);
+    std::string s(arg);
+    // without a valid prefix it's just the name (e.g. c:\sorted.dlt):
+    size_t colon = s.find(':');
+    if (colon!=std::string::npos && colon>0 && s.find_first_not_of("ste")>=colon){
+        for (size_t i=0; i<colon; ++i){
+            switch (s[i]){
+                case 's': spec.split = true; break;
+                case 't': spec.timeadjust = true; break;
+                case 'e': spec.per_ecu = true; break;
+            }
+        }
+        s.erase(0, colon+1);
+    }
+    spec.name = s;
+    return spec.name.length()>0;
+}
+
+std::string get_ecu_ofstream_name(uint32_t ecu_id, std::string const &templ)
+{
+    /* other chars than alnum are replaced to get a valid file name for any
+     ECU id. Then the id is appended in hex as e.g. "E/1" and "E 1" would
+     write to the same file otherwise. */
+    std::string name(templ);
+    if (name.length()>=4 && name.compare(name.length()-4, 4, ".dlt")==0) name.erase(name.length()-4, 4);
+    unsigned char ecu[4];
+    memcpy(ecu, &ecu_id, sizeof(ecu));
+    name.append("_");
+    size_t len = 0;
+    while (len<sizeof(ecu) && ecu[len]) ++len;
+    bool replaced = false;
+    for (size_t i=0; i<sizeof(ecu); ++i){
+        if (i<len && isalnum(ecu[i])) name.push_back((char)ecu[i]);
+        else if (i<len || ecu[i]){ // a char after the terminating 0 counts as well
+            if (i<len) name.push_back('_');
+            replaced = true;
+        }
+    }
+    if (replaced){
+        char hex[10];
+        snprintf(hex, sizeof(hex), "_%02X%02X%02X%02X", ecu[0], ecu[1], ecu[2], ecu[3]);
+        name.append(hex);
+    }
+    name.append(".dlt");
+    return name;
+}
+
+/* one output of output_fan_out. Opens its files on the first msg for them. */
+class Output_Sink{
+public:
+    explicit Output_Sink(const Output_Spec &spec);
+    ~Output_Sink() { close(); }
+    void begin_olc(int olc_nr); // with split the files of the previous olc are closed
+    void write(const Out_Msg &o, const char *msg, size_t len, const DltStorageHeader &adjusted); // msg as serialized without timeadjust
+    int close(); // 0 = success
+    // member vars:
+    int64_t bytes_written;
+private:
+    Output_Sink(const Output_Sink&); // not copyable
+    Output_Sink &operator=(const Output_Sink&);
+    typedef struct{
+        std::vector<char> buf;
+        std::ofstream *f;
+        Nav_Index_Writer *index;
+    } Out_File;
+    Out_File *get_file(uint32_t ecu_id); // NULL if it can't be opened
+    // member vars:
+    const Output_Spec &spec;
+    std::map<uint32_t, Out_File *> files; // by ECU id (0 if !per_ecu)
+    int olc_nr;
+    int error;
+};
+
+Output_Sink::Output_Sink(const Output_Spec &spec_) : bytes_written(0), spec(spec_), olc_nr(0), error(0)
+{
+    // the same as the single output: the file exists even without msgs
+    if (!spec.split && !spec.per_ecu) get_file(0);
+}
+
+Output_Sink::Out_File *Output_Sink::get_file(uint32_t ecu_id)
+{
+    if (!spec.per_ecu) ecu_id = 0;
+    std::map<uint32_t, Out_File *>::iterator it = files.find(ecu_id);
+    if (it!=files.end()) return it->second;
+    std::string templ = spec.per_ecu ? get_ecu_ofstream_name(ecu_id, spec.name) : spec.name;
+    int cnt = spec.split ? olc_nr : 0;
+    Out_File *file = new Out_File;
+    file->buf.resize(fan_out_buf_size);
+    file->f = get_ofstream(cnt, templ, &file->buf[0], file->buf.size());
+    if (!file->f){
+        error = -1;
+        delete file;
+        file = 0;
+    }else
+        file->index = use_nav_index ? new Nav_Index_Writer(get_ofstream_name(cnt, templ)) : 0;
+    files[ecu_id] = file; // NULL: the msgs for it are skipped
+    return file;
+}
+
+int Output_Sink::close()
+{
+    for (std::map<uint32_t, Out_File *>::iterator it=files.begin(); it!=files.end(); ++it){
+        Out_File *file = it->second;
+        if (!file) continue;
+        file->f->close();
+        if (file->f->fail()) error = -1;
+        delete file->f;
+        if (file->index && file->index->close()) error = -1;
+        delete file->index;
+        delete file;
+    }
+    files.clear();
+    return error;
+}
+
+void Output_Sink::begin_olc(int olc_nr_)
+{
+    olc_nr = olc_nr_;
+    if (spec.split) close();
+}
+
+void Output_Sink::write(const Out_Msg &o, const char *msg, size_t len, const DltStorageHeader &adjusted)
+{
+    Out_File *file = get_file(spec.per_ecu ? get_ecu_id(*o.msg) : 0);
+    if (!file) return; // can't be opened (reported at close)
+    if (spec.timeadjust){
+        file->f->write((const char *)&adjusted, sizeof(adjusted));
+        file->f->write(msg + sizeof(adjusted), len - sizeof(adjusted));
+    }else
+        file->f->write(msg, len);
+    if (file->index) file->index->add(o);
+    bytes_written += (int64_t)len;
+}
+
+int output_fan_out(LIST_OF_OLCS &olcs, std::vector<Output_Spec> const &outputs, int64_t *bytes_written)
+{
+    std::vector<Output_Sink *> sinks;
+    for (size_t i=0; i<outputs.size(); ++i) sinks.push_back(new Output_Sink(outputs[i]));
+
+    std::vector<char> buf;
+    int olc_nr = 0;
+    for (LIST_OF_OLCS::iterator it=olcs.begin(); it!=olcs.end(); ++it){
+        Trace_Span span("output_olc", "task");
+        ++olc_nr;
+        for (size_t s=0; s<sinks.size(); ++s) sinks[s]->begin_olc(olc_nr);
+        VEC_OF_OUT_MSGS order;
+        order.reserve(it->nr_msgs());
+        it->determine_output_order(order);
+        // each payload is read (or decompressed) once for all outputs:
+        Payload_Planner *planner = use_payload_refs ? new Payload_Planner(order, 0, order.size()) : 0;
+        Payload_Block_Cache blocks;
+        for (size_t i=0; i<order.size(); ++i){
+            const DltMessage *msg = order[i].msg;
+            const unsigned char *payload = 0;
+            if (planner && (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF)) payload = planner->payload(i);
+            else if (msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK) payload = blocks.payload(*msg);
+            buf.resize(get_message_size(*msg));
+            size_t len = serialize_message(order[i], false, &buf[0], payload);
+            // the -t variant differs in the storage header only:
+            DltStorageHeader adjusted;
+            memcpy(&adjusted, &buf[0], sizeof(adjusted));
+            adjust_storage_header(order[i], adjusted);
+            for (size_t s=0; s<sinks.size(); ++s) sinks[s]->write(order[i], &buf[0], len, adjusted);
+        }
+        delete planner;
+    }
+
+    int ret = 0;
+    int64_t bytes = 0;
+    for (size_t s=0; s<sinks.size(); ++s){
+        if (sinks[s]->close()){
+            cerr << "error writing <" << outputs[s].name << ">!\n";
+            ret = -1;
+        }
+        bytes += sinks[s]->bytes_written;
+        delete sinks[s];
+    }
+    if (bytes_written) *bytes_written = bytes;
+    return ret;
+}
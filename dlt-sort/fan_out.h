@@ -0,0 +1,37 @@
+//
+//  fan_out.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_fan_out_h
+#define dlt_sort_fan_out_h
+
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+
+/* multiple outputs from one run (--out):
+ The overall lifecycles are merged once. Each msg is serialized once (its
+ payload read or decompressed once) and written to all outputs. As the msgs
+ aren't changed by the output the -t and the raw variant can be written
+ side by side. */
+typedef struct{
+    std::string name; // output file name. The template for split/per_ecu
+    bool split; // one file per overall lifecycle (as -s)
+    bool timeadjust; // as -t
+    bool per_ecu; // one file per ECU: <name>_<ECU>.dlt
+} Output_Spec;
+void init_Output_Spec(Output_Spec &);
+bool parse_output_spec(const char *arg, Output_Spec &spec); // "[s][t][e]:name" or "name". false if invalid
+std::string get_ecu_ofstream_name(uint32_t ecu_id, std::string const &templ); // <templ>_<ECU>.dlt. Unique per ECU id (see fan_out.cpp)
+
+/* writes olcs to all outputs in a single pass. bytes_written (can be NULL)
+ gets the size of all files written. 0 = success */
+int output_fan_out(LIST_OF_OLCS &olcs, std::vector<Output_Spec> const &outputs, int64_t *bytes_written);
+
+int sort_dlt_files(std::vector<std::string> const &ifiles, std::vector<Output_Spec> const &outputs, Sort_Stats *stats=0);
+
+#endif
@@ -0,0 +1,53 @@
+//
+//  htyp_codec.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <string.h>
+#include "htyp_codec.h"
+
+template<unsigned int IDX> static void decode_htyp(const char *src, DltMessage &msg)
+{
+    typedef Htyp_Layout<IDX> L;
+    if (L::weid) memcpy(msg.headerextra.ecu, src + L::weid_offset, DLT_SIZE_WEID);
+    if (L::wsid){
+        uint32_t seid;
+        memcpy(&seid, src + L::wsid_offset, DLT_SIZE_WSID);
+        msg.headerextra.seid = DLT_BETOH_32(seid);
+    }
+    if (L::wtms){
+        uint32_t tmsp;
+        memcpy(&tmsp, src + L::wtms_offset, DLT_SIZE_WTMS);
+        msg.headerextra.tmsp = DLT_BETOH_32(tmsp);
+    }else
+        msg.headerextra.tmsp = 0;
+    if (L::ueh) memcpy(msg.extendedheader, src + L::ueh_offset, sizeof(DltExtendedHeader));
+}
+
+template<unsigned int IDX> static char *encode_htyp(const DltMessage &msg, char *dst)
+{
+    typedef Htyp_Layout<IDX> L;
+    if (L::weid) memcpy(dst + L::weid_offset, msg.headerextra.ecu, DLT_SIZE_WEID);
+    if (L::wsid){
+        uint32_t seid = DLT_HTOBE_32(msg.headerextra.seid);
+        memcpy(dst + L::wsid_offset, &seid, DLT_SIZE_WSID);
+    }
+    if (L::wtms){
+        uint32_t tmsp = DLT_HTOBE_32(msg.headerextra.tmsp);
+        memcpy(dst + L::wtms_offset, &tmsp, DLT_SIZE_WTMS);
+    }
+    if (L::ueh) memcpy(dst + L::ueh_offset, msg.extendedheader, sizeof(DltExtendedHeader));
+    return dst + L::size;
+}
+
+#define HTYP_CODEC(IDX) {Htyp_Layout<IDX>::size, decode_htyp<IDX>, encode_htyp<IDX>}
+
+const Htyp_Codec htyp_codecs[nr_htyp_layouts] = {
+    HTYP_CODEC(0), HTYP_CODEC(1), HTYP_CODEC(2), HTYP_CODEC(3),
+    HTYP_CODEC(4), HTYP_CODEC(5), HTYP_CODEC(6), HTYP_CODEC(7),
+    HTYP_CODEC(8), HTYP_CODEC(9), HTYP_CODEC(10), HTYP_CODEC(11),
+    HTYP_CODEC(12), HTYP_CODEC(13), HTYP_CODEC(14), HTYP_CODEC(15)
+};
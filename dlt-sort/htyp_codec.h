@@ -0,0 +1,55 @@
+//
+//  htyp_codec.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_htyp_codec_h
+#define dlt_sort_htyp_codec_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <dlt/dlt_common.h>
+
+/* the headers following the standard header (ecu id, session id, timestamp
+ and extended header) depend on 4 flags of htyp. Instead of checking each flag
+ per msg there is a decoder/encoder for each of the 16 combinations. They are
+ looked up in a table indexed by the flag bits (see htyp_index). */
+
+const unsigned int nr_htyp_layouts = 16;
+
+// UEH -> bit 0, WEID -> bit 1, WSID -> bit 2, WTMS -> bit 3:
+inline unsigned int htyp_index(uint8_t htyp)
+{
+    return (htyp & DLT_HTYP_UEH) | ((htyp & (DLT_HTYP_WEID|DLT_HTYP_WSID|DLT_HTYP_WTMS)) >> 1);
+}
+
+// offsets relative to the end of the standard header:
+template<unsigned int IDX> struct Htyp_Layout{
+    static constexpr bool ueh = (IDX & 0x1) != 0;
+    static constexpr bool weid = (IDX & 0x2) != 0;
+    static constexpr bool wsid = (IDX & 0x4) != 0;
+    static constexpr bool wtms = (IDX & 0x8) != 0;
+    static constexpr size_t weid_offset = 0;
+    static constexpr size_t wsid_offset = weid_offset + (weid ? DLT_SIZE_WEID : 0);
+    static constexpr size_t wtms_offset = wsid_offset + (wsid ? DLT_SIZE_WSID : 0);
+    static constexpr size_t ueh_offset = wtms_offset + (wtms ? DLT_SIZE_WTMS : 0);
+    static constexpr size_t size = ueh_offset + (ueh ? sizeof(DltExtendedHeader) : 0);
+};
+
+const size_t max_htyp_layout_size = Htyp_Layout<nr_htyp_layouts-1>::size;
+
+typedef struct{
+    size_t size; // of the headers after the standard header
+    void (*decode)(const char *src, DltMessage &msg); // src in file byte order. Sets tmsp to 0 if there is none
+    char *(*encode)(const DltMessage &msg, char *dst); // returns dst+size. Doesn't modify the msg
+} Htyp_Codec;
+
+extern const Htyp_Codec htyp_codecs[nr_htyp_layouts];
+
+inline const Htyp_Codec &get_htyp_codec(uint8_t htyp) { return htyp_codecs[htyp_index(htyp)]; }
+
+#endif
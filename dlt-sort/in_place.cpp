@@ -0,0 +1,806 @@
+//
+//  in_place.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <string.h>
+#include <stddef.h>
+#include <algorithm>
+#include <map>
+#include <sys/stat.h>
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "in_place.h"
+#include "thread_pool.h"
+#include "msg_arena.h"
+#include "mem_budget.h"
+#include "nav_index.h"
+#include "htyp_codec.h"
+
+using namespace std;
+
+int use_in_place = 0; // by default the output is written to a separate file
+int in_place_keep_journal = 0;
+
+/* <file>.inplace: the header (64 bytes. At in_place_permuted_offset a u64 that
+ is set to 1 once all moves are applied and only the truncation is left), the plan (20 bytes per msg: src,
+ len, usecs) and 2 slots for the journaled batches (used alternately so the
+ last complete one survives a crash while writing the next one).
+ A slot: magic, batch nr, nr of moves, data bytes and the checksum (40 bytes).
+ Then the moves (12 bytes each: dst, len) and their data. All values in host
+ byte order. */
+const char in_place_magic[8] = {'D','L','T','S','I','N','P','L'};
+const char in_place_slot_magic[8] = {'D','L','T','S','B','A','T','1'};
+const uint32_t in_place_version = 1;
+const size_t in_place_header_size = 64;
+const size_t in_place_permuted_offset = 48;
+const size_t in_place_msg_size = 20;
+const size_t in_place_slot_header_size = 40;
+const size_t in_place_move_size = 12;
+const size_t in_place_slot_size = in_place_slot_header_size + in_place_batch_moves*in_place_move_size + in_place_batch_bytes;
+const size_t in_place_io_size = 1<<20;
+
+int64_t get_input_offset(const DltMessage &msg)
+{
+    // the ref points to the payload. The headers are in front of it:
+    assert(msg.found_serialheader & DLT_SORT_MSG_PAYLOAD_REF);
+    Payload_Ref ref;
+    memcpy(&ref, msg.databuffer, sizeof(ref));
+    return ref.offset - (int64_t)(sizeof(DltStorageHeader) + sizeof(DltStandardHeader) + get_htyp_codec(msg.standardheader->htyp).size);
+}
+
+#ifndef WIN32
+
+template<typename T> static inline void put(unsigned char *&p, T v)
+{
+    memcpy(p, &v, sizeof(v));
+    p += sizeof(v);
+}
+
+template<typename T> static inline T get(const unsigned char *&p)
+{
+    T v;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return v;
+}
+
+static uint64_t checksum(const unsigned char *p, size_t len, uint64_t h)
+{
+    // as FNV-1a but 8 bytes at once. Detects torn slots:
+    const uint64_t prime = 1099511628211ULL;
+    size_t i=0;
+    for (; i+sizeof(uint64_t)<=len; i+=sizeof(uint64_t)){
+        uint64_t w;
+        memcpy(&w, p+i, sizeof(w));
+        h = (h ^ w) * prime;
+    }
+    for (; i<len; ++i) h = (h ^ p[i]) * prime;
+    return h;
+}
+
+static bool pwrite_all(int fd, const void *buf, size_t len, uint64_t offset)
+{
+    const char *p = (const char *)buf;
+    while (len){
+        ssize_t w = pwrite(fd, p, len, (off_t)offset);
+        if (w<0 && errno==EINTR) continue;
+        if (w<=0) return false;
+        p += w;
+        len -= (size_t)w;
+        offset += (uint64_t)w;
+    }
+    return true;
+}
+
+static bool pread_all(int fd, void *buf, size_t len, uint64_t offset)
+{
+    char *p = (char *)buf;
+    while (len){
+        ssize_t r = pread(fd, p, len, (off_t)offset);
+        if (r<0 && errno==EINTR) continue;
+        if (r<=0) return false;
+        p += r;
+        len -= (size_t)r;
+        offset += (uint64_t)r;
+    }
+    return true;
+}
+
+typedef struct{
+    uint64_t dst;
+    uint32_t len;
+} In_Place_Move;
+
+typedef struct{
+    uint64_t batch_nr;
+    std::vector<In_Place_Move> moves;
+    std::vector<unsigned char> data;
+} In_Place_Batch;
+
+typedef struct{
+    uint64_t pos;
+    uint32_t len;
+} In_Place_Piece;
+
+/* writes the output front to back. The msgs still needed whose bytes are in
+ the way are parked in the unused bytes behind the frontier (not part of the
+ output or of msgs written already). There is always enough room for them as
+ the output isn't larger than the input. The moves are generated in a fixed
+ order from the plan only. So after a crash the batches done already can be
+ skipped (dry) by running it again. */
+class In_Place_Permuter{
+public:
+    In_Place_Permuter(std::vector<In_Place_Msg> const &plan, bool timeadjust, unsigned char *file, uint64_t file_size, int journal_fd, uint64_t slots_offset);
+    int run(const In_Place_Batch *done); // done: the last batch applied already (or NULL)
+    // stats:
+    uint64_t nr_batches;
+    uint64_t nr_moves;
+    uint64_t bytes_moved;
+    uint64_t nr_parked;
+private:
+    In_Place_Permuter(const In_Place_Permuter&); // not copyable
+    In_Place_Permuter &operator=(const In_Place_Permuter&);
+    void add_hole(uint64_t a, uint64_t b);
+    void remove_holes(uint64_t a, uint64_t b);
+    bool alloc(uint32_t len, std::vector<In_Place_Piece> &pieces); // from the last holes (the frontier reaches them last)
+    void read(uint64_t pos, uint32_t len, unsigned char *dst) const; // incl. the moves of the current batch
+    void read_msg(size_t i, unsigned char *dst) const;
+    void release_msg(size_t i, uint64_t frontier); // its bytes behind the frontier are holes now
+    void park(size_t j, uint64_t frontier);
+    void add_move(uint64_t to, uint32_t len, const unsigned char *src);
+    void commit();
+    // member vars:
+    std::vector<In_Place_Msg> const &plan;
+    std::vector<uint64_t> dst; // output offset of each msg of the plan. dst[plan.size()] = output size
+    std::vector<size_t> by_src; // msg indices sorted by their source
+    bool timeadjust;
+    unsigned char *file; // mapped
+    uint64_t file_size;
+    int journal_fd;
+    uint64_t slots_offset;
+    std::map<uint64_t, uint64_t> holes; // begin -> end of the unused bytes behind the frontier
+    std::map<size_t, std::vector<In_Place_Piece> > parked; // msg -> its pieces
+    std::map<uint64_t, std::pair<size_t, uint32_t> > parked_at; // pos -> msg, len of the piece
+    std::map<uint64_t, std::pair<uint64_t, size_t> > pending; // the latest bytes of the current batch: pos -> end, offset in data
+    std::vector<unsigned char> msg_buf;
+    std::vector<unsigned char> park_buf;
+    std::vector<In_Place_Move> moves; // of the current batch
+    std::vector<unsigned char> data;
+    size_t data_used;
+    uint64_t batch_nr;
+    const In_Place_Batch *done;
+    bool dry; // batches up to done are generated only
+    int error;
+};
+
+In_Place_Permuter::In_Place_Permuter(std::vector<In_Place_Msg> const &plan_, bool timeadjust_, unsigned char *file_, uint64_t file_size_, int journal_fd_, uint64_t slots_offset_) :
+    nr_batches(0), nr_moves(0), bytes_moved(0), nr_parked(0), plan(plan_), dst(plan_.size()+1), by_src(plan_.size()), timeadjust(timeadjust_), file(file_), file_size(file_size_),
+    journal_fd(journal_fd_), slots_offset(slots_offset_), data(in_place_batch_bytes), data_used(0), batch_nr(0), done(0), dry(false), error(0)
+{
+    dst[0] = 0;
+    uint32_t max_len = 0;
+    for (size_t i=0; i<plan.size(); ++i){
+        dst[i+1] = dst[i] + plan[i].len;
+        max_len = std::max(max_len, plan[i].len);
+    }
+    msg_buf.resize(max_len);
+    park_buf.resize(max_len);
+    for (size_t i=0; i<by_src.size(); ++i) by_src[i] = i;
+    std::sort(by_src.begin(), by_src.end(), [this](size_t a, size_t b){ return plan[a].src < plan[b].src; });
+    // the bytes that are no source of any msg (e.g. corrupt or filtered ones) are unused from the start:
+    uint64_t pos = 0;
+    for (size_t i=0; i<by_src.size(); ++i){
+        const In_Place_Msg &m = plan[by_src[i]];
+        if (m.src > pos) add_hole(pos, m.src);
+        pos = std::max(pos, m.src + m.len);
+    }
+    if (pos < file_size) add_hole(pos, file_size);
+}
+
+void In_Place_Permuter::add_hole(uint64_t a, uint64_t b)
+{
+    // merged with the neighbours so the map stays small:
+    std::map<uint64_t, uint64_t>::iterator next = holes.find(b);
+    if (next!=holes.end()){
+        b = next->second;
+        holes.erase(next);
+    }
+    std::map<uint64_t, uint64_t>::iterator it = holes.lower_bound(a);
+    if (it!=holes.begin()){
+        --it;
+        if (it->second==a){
+            it->second = b;
+            return;
+        }
+    }
+    holes[a] = b;
+}
+
+void In_Place_Permuter::remove_holes(uint64_t a, uint64_t b)
+{
+    std::map<uint64_t, uint64_t>::iterator it = holes.lower_bound(a);
+    if (it!=holes.begin()){
+        std::map<uint64_t, uint64_t>::iterator prev = it;
+        --prev;
+        if (prev->second > a){
+            uint64_t end = prev->second;
+            prev->second = a;
+            if (end > b) holes[b] = end;
+            return;
+        }
+    }
+    while (it!=holes.end() && it->first < b){
+        uint64_t end = it->second;
+        holes.erase(it++);
+        if (end > b){
+            holes[b] = end;
+            break;
+        }
+    }
+}
+
+bool In_Place_Permuter::alloc(uint32_t len, std::vector<In_Place_Piece> &pieces)
+{
+    while (len){
+        if (!holes.size()) return false;
+        std::map<uint64_t, uint64_t>::iterator it = holes.end();
+        --it;
+        In_Place_Piece p;
+        p.len = (uint32_t)std::min<uint64_t>(len, it->second - it->first);
+        p.pos = it->second - p.len;
+        if (p.pos == it->first) holes.erase(it); else it->second = p.pos;
+        pieces.push_back(p);
+        len -= p.len;
+    }
+    return true;
+}
+
+void In_Place_Permuter::read(uint64_t pos, uint32_t len, unsigned char *to) const
+{
+    const uint64_t end = pos + len;
+    std::map<uint64_t, std::pair<uint64_t, size_t> >::const_iterator it = pending.upper_bound(pos);
+    if (it!=pending.begin()){
+        --it;
+        if (it->second.first <= pos) ++it;
+    }
+    for (uint64_t cur=pos; cur<end; ){
+        if (it==pending.end() || it->first >= end){
+            memcpy(to + (cur-pos), file + cur, (size_t)(end-cur));
+            break;
+        }
+        if (it->first > cur){
+            memcpy(to + (cur-pos), file + cur, (size_t)(it->first-cur));
+            cur = it->first;
+        }
+        uint64_t stop = std::min(end, it->second.first);
+        memcpy(to + (cur-pos), &data[it->second.second + (size_t)(cur - it->first)], (size_t)(stop-cur));
+        cur = stop;
+        ++it;
+    }
+}
+
+void In_Place_Permuter::read_msg(size_t i, unsigned char *to) const
+{
+    std::map<size_t, std::vector<In_Place_Piece> >::const_iterator it = parked.find(i);
+    if (it==parked.end()){
+        read(plan[i].src, plan[i].len, to);
+        return;
+    }
+    for (size_t k=0; k<it->second.size(); ++k){
+        read(it->second[k].pos, it->second[k].len, to);
+        to += it->second[k].len;
+    }
+}
+
+void In_Place_Permuter::release_msg(size_t i, uint64_t frontier)
+{
+    // the bytes before the frontier are part of the output already:
+    std::map<size_t, std::vector<In_Place_Piece> >::iterator it = parked.find(i);
+    if (it==parked.end()){
+        uint64_t end = plan[i].src + plan[i].len;
+        if (end > frontier) add_hole(std::max(plan[i].src, frontier), end);
+        return;
+    }
+    for (size_t k=0; k<it->second.size(); ++k){
+        const In_Place_Piece &p = it->second[k];
+        parked_at.erase(p.pos);
+        if (p.pos + p.len > frontier) add_hole(std::max(p.pos, frontier), p.pos + p.len);
+    }
+    parked.erase(it);
+}
+
+void In_Place_Permuter::park(size_t j, uint64_t frontier)
+{
+    if (!dry) read_msg(j, &park_buf[0]);
+    release_msg(j, frontier);
+    std::vector<In_Place_Piece> pieces;
+    if (!alloc(plan[j].len, pieces)){
+        cerr << "no room left to park a msg!\n";
+        error = -1;
+        return;
+    }
+    uint32_t off = 0;
+    for (size_t k=0; k<pieces.size(); ++k){
+        add_move(pieces[k].pos, pieces[k].len, dry ? 0 : &park_buf[off]);
+        parked_at[pieces[k].pos] = std::make_pair(j, pieces[k].len);
+        off += pieces[k].len;
+    }
+    parked[j].swap(pieces);
+    nr_parked++;
+}
+
+void In_Place_Permuter::add_move(uint64_t to, uint32_t len, const unsigned char *src)
+{
+    In_Place_Move m;
+    m.dst = to;
+    m.len = len;
+    moves.push_back(m);
+    if (!dry){
+        memcpy(&data[data_used], src, len);
+        // the latest bytes of a pos for read:
+        const uint64_t end = to + len;
+        std::map<uint64_t, std::pair<uint64_t, size_t> >::iterator it = pending.lower_bound(to);
+        if (it!=pending.begin()){
+            std::map<uint64_t, std::pair<uint64_t, size_t> >::iterator prev = it;
+            --prev;
+            if (prev->second.first > to){
+                if (prev->second.first > end)
+                    pending[end] = std::make_pair(prev->second.first, prev->second.second + (size_t)(end - prev->first));
+                prev->second.first = to;
+            }
+        }
+        while (it!=pending.end() && it->first < end){
+            if (it->second.first > end)
+                pending[end] = std::make_pair(it->second.first, it->second.second + (size_t)(end - it->first));
+            pending.erase(it++);
+        }
+        pending[to] = std::make_pair(end, data_used);
+    }
+    data_used += len;
+    nr_moves++;
+    bytes_moved += len;
+}
+
+void In_Place_Permuter::commit()
+{
+    if (!moves.size() || error) return;
+    if (dry){
+        if (batch_nr == done->batch_nr){
+            if (moves.size()!=done->moves.size() || data_used!=done->data.size()){
+                cerr << "the in place journal doesn't match its plan!\n";
+                error = -1;
+                return;
+            }
+            dry = false;
+        }
+    }else{
+        // the journal first. After a crash the batch is applied again from there:
+        std::vector<unsigned char> moves_buf(moves.size()*in_place_move_size);
+        unsigned char *p = &moves_buf[0];
+        for (size_t i=0; i<moves.size(); ++i){
+            put(p, moves[i].dst);
+            put(p, moves[i].len);
+        }
+        unsigned char header[in_place_slot_header_size];
+        p = header;
+        memcpy(p, in_place_slot_magic, sizeof(in_place_slot_magic));
+        p += sizeof(in_place_slot_magic);
+        put(p, batch_nr);
+        put(p, (uint64_t)moves.size());
+        put(p, (uint64_t)data_used);
+        uint64_t sum = checksum(header, (size_t)(p-header), 0);
+        sum = checksum(&moves_buf[0], moves_buf.size(), sum);
+        sum = checksum(&data[0], data_used, sum);
+        put(p, sum);
+        uint64_t slot = slots_offset + (batch_nr%2)*in_place_slot_size;
+        bool ok = pwrite_all(journal_fd, &moves_buf[0], moves_buf.size(), slot + in_place_slot_header_size);
+        ok = ok && pwrite_all(journal_fd, &data[0], data_used, slot + in_place_slot_header_size + moves_buf.size());
+        ok = ok && pwrite_all(journal_fd, header, sizeof(header), slot);
+        ok = ok && fdatasync(journal_fd)==0;
+        if (!ok){
+            cerr << "can't write the in place journal!\n";
+            error = -1;
+            return;
+        }
+        // now the file. Synced before the next batch overwrites the older slot:
+        size_t off = 0;
+        for (size_t i=0; i<moves.size(); ++i){
+            memcpy(file + moves[i].dst, &data[off], moves[i].len);
+            off += moves[i].len;
+        }
+        if (msync(file, (size_t)file_size, MS_SYNC)){
+            cerr << "can't write the in place sorted file!\n";
+            error = -1;
+            return;
+        }
+        nr_batches++;
+    }
+    moves.clear();
+    pending.clear();
+    data_used = 0;
+    batch_nr++;
+}
+
+int In_Place_Permuter::run(const In_Place_Batch *done_)
+{
+    done = done_;
+    dry = done!=0;
+    std::vector<size_t> in_the_way;
+    for (size_t i=0; i<plan.size() && !error; ++i){
+        const uint64_t a = dst[i], e = dst[i+1];
+        const uint32_t len = plan[i].len;
+        if (plan[i].src==a && !parked.count(i)){
+            // at its place already. With -t only the time is changed:
+            remove_holes(a, e);
+            if (!timeadjust) continue;
+            if (moves.size()+1 > in_place_batch_moves || data_used+sizeof(uint64_t) > data.size()) commit();
+            DltStorageHeader sh;
+            sh.seconds = (uint32_t)(plan[i].usecs / usecs_per_sec);
+            sh.microseconds = (int32_t)(plan[i].usecs % usecs_per_sec);
+            add_move(a + offsetof(DltStorageHeader, seconds), sizeof(sh.seconds)+sizeof(sh.microseconds), ((const unsigned char *)&sh) + offsetof(DltStorageHeader, seconds));
+            continue;
+        }
+
+        // the msgs with bytes in [a,e) (at their source or parked):
+        in_the_way.clear();
+        std::vector<size_t>::const_iterator s = std::upper_bound(by_src.begin(), by_src.end(), a, [this](uint64_t v, size_t m){ return v < plan[m].src; });
+        if (s!=by_src.begin()) --s;
+        for (; s!=by_src.end() && plan[*s].src < e; ++s){
+            size_t j = *s;
+            if (j>i && plan[j].src + plan[j].len > a && !parked.count(j)) in_the_way.push_back(j);
+        }
+        std::map<uint64_t, std::pair<size_t, uint32_t> >::const_iterator pa = parked_at.upper_bound(a);
+        if (pa!=parked_at.begin()){
+            --pa;
+            if (pa->first + pa->second.second <= a) ++pa;
+        }
+        for (; pa!=parked_at.end() && pa->first < e; ++pa)
+            if (pa->second.first!=i) in_the_way.push_back(pa->second.first);
+        std::sort(in_the_way.begin(), in_the_way.end());
+        in_the_way.erase(std::unique(in_the_way.begin(), in_the_way.end()), in_the_way.end());
+
+        // all moves of a msg are in one batch. So a continued run never needs the bytes read in a batch done already:
+        uint64_t need = len;
+        for (size_t k=0; k<in_the_way.size(); ++k) need += plan[in_the_way[k]].len;
+        if (moves.size()+need+1 > in_place_batch_moves || data_used+need > data.size()) commit();
+        if (need > data.size()){
+            cerr << "too many msgs in the way to sort in place!\n";
+            error = -1;
+            break;
+        }
+
+        if (!dry) read_msg(i, &msg_buf[0]);
+        release_msg(i, e);
+        remove_holes(a, e);
+        for (size_t k=0; k<in_the_way.size() && !error; ++k) park(in_the_way[k], e);
+        if (!dry && timeadjust){
+            DltStorageHeader sh;
+            sh.seconds = (uint32_t)(plan[i].usecs / usecs_per_sec);
+            sh.microseconds = (int32_t)(plan[i].usecs % usecs_per_sec);
+            memcpy(&msg_buf[offsetof(DltStorageHeader, seconds)], &sh.seconds, sizeof(sh.seconds));
+            memcpy(&msg_buf[offsetof(DltStorageHeader, microseconds)], &sh.microseconds, sizeof(sh.microseconds));
+        }
+        add_move(a, len, &msg_buf[0]);
+    }
+    commit();
+    if (!error && dry){
+        cerr << "the in place journal doesn't match its plan!\n";
+        error = -1;
+    }
+    return error;
+}
+
+static bool read_batch(int fd, uint64_t slot, In_Place_Batch &b)
+{
+    // false if the slot is empty or incomplete:
+    unsigned char header[in_place_slot_header_size];
+    if (!pread_all(fd, header, sizeof(header), slot)) return false;
+    if (memcmp(header, in_place_slot_magic, sizeof(in_place_slot_magic))) return false;
+    const unsigned char *p = header + sizeof(in_place_slot_magic);
+    b.batch_nr = get<uint64_t>(p);
+    uint64_t nr_moves = get<uint64_t>(p);
+    uint64_t data_bytes = get<uint64_t>(p);
+    uint64_t sum = get<uint64_t>(p);
+    if (nr_moves>in_place_batch_moves || data_bytes>in_place_batch_bytes) return false;
+    std::vector<unsigned char> moves_buf((size_t)nr_moves*in_place_move_size);
+    b.data.resize((size_t)data_bytes);
+    uint64_t pos = slot + in_place_slot_header_size;
+    if (moves_buf.size() && !pread_all(fd, &moves_buf[0], moves_buf.size(), pos)) return false;
+    pos += moves_buf.size();
+    if (b.data.size() && !pread_all(fd, &b.data[0], b.data.size(), pos)) return false;
+    uint64_t expected = checksum(header, in_place_slot_header_size-sizeof(sum), 0);
+    expected = checksum(moves_buf.size() ? &moves_buf[0] : 0, moves_buf.size(), expected);
+    expected = checksum(b.data.size() ? &b.data[0] : 0, b.data.size(), expected);
+    if (sum!=expected) return false;
+    b.moves.resize((size_t)nr_moves);
+    p = moves_buf.size() ? &moves_buf[0] : 0;
+    uint64_t len = 0;
+    for (size_t i=0; i<b.moves.size(); ++i){
+        b.moves[i].dst = get<uint64_t>(p);
+        b.moves[i].len = get<uint32_t>(p);
+        len += b.moves[i].len;
+    }
+    return len==data_bytes;
+}
+
+static int permute(std::string const &name, int journal_fd, std::vector<In_Place_Msg> const &plan, bool timeadjust, const In_Place_Batch *done, Sort_Stats *stats)
+{
+    uint64_t out_size = 0;
+    for (size_t i=0; i<plan.size(); ++i) out_size += plan[i].len;
+    int fd = open(name.c_str(), O_RDWR);
+    struct stat st;
+    if (fd<0 || fstat(fd, &st) || (uint64_t)st.st_size<out_size){
+        cerr << "can't open <" << name << "> for in place sorting!\n";
+        if (fd>=0) close(fd);
+        return -1;
+    }
+    const uint64_t file_size = (uint64_t)st.st_size;
+    unsigned char *file = 0;
+    if (file_size){
+        void *p = mmap(0, (size_t)file_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p==MAP_FAILED){
+            cerr << "can't map <" << name << ">!\n";
+            close(fd);
+            return -1;
+        }
+        file = (unsigned char *)p;
+    }
+    int ret = 0;
+    if (done){
+        // it might have been applied partly only:
+        size_t off = 0;
+        for (size_t i=0; i<done->moves.size(); ++i){
+            if (done->moves[i].dst + done->moves[i].len > file_size){
+                ret = -1;
+                break;
+            }
+            memcpy(file + done->moves[i].dst, &done->data[off], done->moves[i].len);
+            off += done->moves[i].len;
+        }
+        if (ret) cerr << "the in place journal doesn't match <" << name << ">!\n";
+        else if (msync(file, (size_t)file_size, MS_SYNC)) ret = -1;
+    }
+    uint64_t slots_offset = in_place_header_size + plan.size()*in_place_msg_size;
+    In_Place_Permuter permuter(plan, timeadjust, file, file_size, journal_fd, slots_offset);
+    if (!ret) ret = permuter.run(done);
+    if (file){
+        if (msync(file, (size_t)file_size, MS_SYNC)) ret = -1;
+        munmap(file, (size_t)file_size);
+    }
+    // the journal can't be replayed after the truncation (its moves might be behind the end):
+    if (!ret){
+        const uint64_t permuted = 1;
+        if (!pwrite_all(journal_fd, &permuted, sizeof(permuted), in_place_permuted_offset) || fdatasync(journal_fd)) ret = -1;
+    }
+    // the bytes after the output aren't needed any longer:
+    if (!ret && file_size>out_size && ftruncate(fd, (off_t)out_size)) ret = -1;
+    if (!ret && fsync(fd)) ret = -1;
+    close(fd);
+    if (verbose) cout << "in place: " << permuter.nr_moves << " moves of " << (permuter.bytes_moved>>20) << "MB in " << permuter.nr_batches << " batches, " << permuter.nr_parked << " msgs parked\n";
+    if (ret) cerr << "in place sorting of <" << name << "> failed! Run again to continue it.\n";
+    if (stats) stats->bytes_written = (int64_t)out_size;
+    return ret;
+}
+
+#endif
+
+int permute_in_place(std::string const &name, std::vector<In_Place_Msg> const &plan, bool timeadjust, std::string const &journal_name, Sort_Stats *stats)
+{
+#ifdef WIN32
+    (void)name; (void)plan; (void)timeadjust; (void)journal_name; (void)stats;
+    cerr << "in place sorting is not supported on this OS!\n";
+    return -1;
+#else
+    int fd = open(journal_name.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fd<0){
+        cerr << "can't open <" << journal_name << "> for writing!\n";
+        return -1;
+    }
+    struct stat st;
+    if (stat(name.c_str(), &st)){
+        cerr << "can't open <" << name << "> as file for input!\n";
+        close(fd);
+        return -1;
+    }
+    // the plan first. Then the header. Without both the file isn't touched:
+    bool ok = true;
+    uint64_t out_size = 0;
+    std::vector<unsigned char> buf(in_place_io_size);
+    size_t used = 0;
+    uint64_t pos = in_place_header_size;
+    for (size_t i=0; i<plan.size() && ok; ++i){
+        unsigned char *p = &buf[used];
+        put(p, plan[i].src);
+        put(p, plan[i].len);
+        put(p, plan[i].usecs);
+        used += in_place_msg_size;
+        out_size += plan[i].len;
+        if (used+in_place_msg_size > buf.size() || i+1==plan.size()){
+            ok = pwrite_all(fd, &buf[0], used, pos);
+            pos += used;
+            used = 0;
+        }
+    }
+    unsigned char header[in_place_header_size];
+    memset(header, 0, sizeof(header));
+    unsigned char *p = header;
+    memcpy(p, in_place_magic, sizeof(in_place_magic));
+    p += sizeof(in_place_magic);
+    put(p, in_place_version);
+    put(p, (uint32_t)(timeadjust ? 1 : 0));
+    put(p, (uint64_t)st.st_size);
+    put(p, out_size);
+    put(p, (uint64_t)plan.size());
+    put(p, (uint64_t)in_place_slot_size);
+    ok = ok && fdatasync(fd)==0 && pwrite_all(fd, header, sizeof(header), 0) && fdatasync(fd)==0;
+    if (!ok){
+        cerr << "can't write <" << journal_name << ">!\n";
+        close(fd);
+        unlink(journal_name.c_str());
+        return -1;
+    }
+    int ret = permute(name, fd, plan, timeadjust, 0, stats);
+    close(fd);
+    if (!ret && !in_place_keep_journal) unlink(journal_name.c_str());
+    return ret;
+#endif
+}
+
+int resume_in_place(std::string const &name, std::string const &journal_name, Sort_Stats *stats)
+{
+    /* 1 if the journal is incomplete. Then the file wasn't changed and the
+     journal is removed. */
+#ifdef WIN32
+    (void)name; (void)journal_name; (void)stats;
+    cerr << "in place sorting is not supported on this OS!\n";
+    return -1;
+#else
+    int fd = open(journal_name.c_str(), O_RDWR);
+    if (fd<0){
+        cerr << "can't open <" << journal_name << ">!\n";
+        return -1;
+    }
+    unsigned char header[in_place_header_size];
+    if (!pread_all(fd, header, sizeof(header), 0) || memcmp(header, in_place_magic, sizeof(in_place_magic))){
+        if (verbose) cout << " <" << journal_name << "> is incomplete. Removing it\n";
+        close(fd);
+        unlink(journal_name.c_str());
+        return 1;
+    }
+    const unsigned char *p = header + sizeof(in_place_magic);
+    uint32_t version = get<uint32_t>(p);
+    bool timeadjust = get<uint32_t>(p)!=0;
+    uint64_t in_size = get<uint64_t>(p);
+    uint64_t out_size = get<uint64_t>(p);
+    uint64_t nr_msgs = get<uint64_t>(p);
+    uint64_t slot_size = get<uint64_t>(p);
+    bool permuted = get<uint64_t>(p)!=0;
+    if (version!=in_place_version || slot_size!=in_place_slot_size){
+        cerr << "<" << journal_name << "> was written by a different version!\n";
+        close(fd);
+        return -1;
+    }
+    struct stat st;
+    if (stat(name.c_str(), &st) || ((uint64_t)st.st_size!=in_size && (uint64_t)st.st_size!=out_size)){
+        cerr << "<" << journal_name << "> doesn't belong to <" << name << ">!\n";
+        close(fd);
+        return -1;
+    }
+    if (permuted){
+        // all moves were applied. Only the truncation might be missing:
+        close(fd);
+        if (verbose) cout << " all moves were applied already\n";
+        int ffd = open(name.c_str(), O_RDWR);
+        int ret = 0;
+        if (ffd<0 || ((uint64_t)st.st_size>out_size && ftruncate(ffd, (off_t)out_size)) || fsync(ffd)) ret = -1;
+        if (ffd>=0) close(ffd);
+        if (ret) cerr << "can't truncate <" << name << ">! Run again to continue it.\n";
+        else if (!in_place_keep_journal) unlink(journal_name.c_str());
+        if (stats) stats->bytes_written = (int64_t)out_size;
+        return ret;
+    }
+    std::vector<In_Place_Msg> plan((size_t)nr_msgs);
+    std::vector<unsigned char> buf(in_place_io_size - in_place_io_size%in_place_msg_size);
+    uint64_t pos = in_place_header_size;
+    for (size_t i=0; i<plan.size(); ){
+        size_t n = std::min(plan.size()-i, buf.size()/in_place_msg_size);
+        if (!pread_all(fd, &buf[0], n*in_place_msg_size, pos)){
+            cerr << "can't read <" << journal_name << ">!\n";
+            close(fd);
+            return -1;
+        }
+        pos += n*in_place_msg_size;
+        const unsigned char *q = &buf[0];
+        for (size_t j=0; j<n; ++j, ++i){
+            plan[i].src = get<uint64_t>(q);
+            plan[i].len = get<uint32_t>(q);
+            plan[i].usecs = get<int64_t>(q);
+        }
+    }
+    // the last complete batch:
+    In_Place_Batch batches[2];
+    bool valid[2];
+    for (int i=0; i<2; ++i) valid[i] = read_batch(fd, pos + i*in_place_slot_size, batches[i]);
+    const In_Place_Batch *done = 0;
+    for (int i=0; i<2; ++i)
+        if (valid[i] && (!done || batches[i].batch_nr > done->batch_nr)) done = &batches[i];
+    if (verbose){
+        if (done) cout << " continuing after batch " << done->batch_nr << "\n";
+        else cout << " no batch was applied yet\n";
+    }
+    int ret = permute(name, fd, plan, timeadjust, done, stats);
+    close(fd);
+    if (!ret && !in_place_keep_journal) unlink(journal_name.c_str());
+    return ret;
+#endif
+}
+
+int sort_dlt_file_in_place(std::vector<std::string> const &ifiles, bool do_split, bool do_timeadjust, Sort_Stats *stats)
+{
+    if (ifiles.size()!=1){
+        cerr << "in place sorting needs exactly one input file!\n";
+        return -1;
+    }
+    if (do_split){
+        cerr << "in place sorting can't split the output!\n";
+        return -1;
+    }
+    if (stats) init_Sort_Stats(*stats);
+    Run_Clock run_clock(stats);
+    std::string journal_name = ifiles[0] + ".inplace";
+    struct stat st;
+    if (stat(journal_name.c_str(), &st)==0){
+        cout << "continuing the interrupted in place sorting of <" << ifiles[0] << ">\n";
+        int ret;
+        {
+            Stage_Clock stage_clock(stats, STAGE_OUTPUT, "in place");
+            ret = resume_in_place(ifiles[0], journal_name, stats);
+        }
+        if (ret<=0) return ret;
+    }
+
+    init_mem_budget();
+    use_payload_refs = 1; // for the offset of each msg. The payloads aren't needed
+    ThreadPool pool((unsigned int)nr_jobs);
+    if (verbose) cout << " using " << pool.size() << " threads\n";
+    if (analyse_dlt_files(ifiles, stats, pool)) return -1;
+    close_payload_files();
+
+    int ret = 0;
+    {
+        Stage_Clock stage_clock(stats, STAGE_OUTPUT, "in place");
+        std::vector<In_Place_Msg> plan;
+        Nav_Index_Writer *index = use_nav_index ? new Nav_Index_Writer(ifiles[0]) : 0;
+        for (LIST_OF_OLCS::iterator it=list_olcs.begin(); it!=list_olcs.end(); ++it){
+            VEC_OF_OUT_MSGS order;
+            order.reserve(it->nr_msgs());
+            it->determine_output_order(order);
+            for (size_t i=0; i<order.size(); ++i){
+                In_Place_Msg m;
+                m.src = (uint64_t)get_input_offset(*order[i].msg);
+                m.len = (uint32_t)get_message_size(*order[i].msg);
+                m.usecs = get_adjusted_time(order[i]);
+                plan.push_back(m);
+                if (index) index->add(order[i]);
+            }
+        }
+        if (index && index->close()) ret = -1;
+        delete index;
+        if (stats) stats->nr_olcs = list_olcs.size();
+        // only the plan is needed from here on:
+        list_olcs.clear();
+        map_ecus.clear();
+        msg_arena.release();
+        if (!ret) ret = permute_in_place(ifiles[0], plan, do_timeadjust, journal_name, stats);
+    }
+    if (stats) stats->peak_rss_bytes = get_peak_rss();
+    return ret;
+}
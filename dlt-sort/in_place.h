@@ -0,0 +1,56 @@
+//
+//  in_place.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_in_place_h
+#define dlt_sort_in_place_h
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+
+/* in place sorting of a single input file (--in_place):
+ The output order is determined as usual (the payloads stay in the file as
+ Payload_Refs) and stored as a plan (source offset, size and -t time of each
+ msg in output order) in <file>.inplace. Then the output is written front to
+ back within the file. Msgs still needed whose bytes are in the way are parked
+ in the bytes behind the frontier that aren't needed any longer (e.g. corrupt
+ or filtered ones or the sources of msgs written already) until it's their
+ turn. As the output isn't larger than the input there is always room for them.
+ All moves are collected into batches of up to in_place_batch_bytes that are
+ written to the journal (in <file>.inplace as well) and synced before they
+ are applied to the file. So after a crash the same command continues after
+ the last journaled batch. Once all moves are applied this is marked in the
+ journal. Then the file is truncated to the output size and the .inplace
+ file is removed.
+ The extra disk space needed is about 20 bytes per msg plus 2 batches. */
+
+extern int use_in_place;
+extern int in_place_keep_journal; // keeps the journal after the truncation as if killed before removing it (to test resume_in_place)
+
+const size_t in_place_batch_bytes = 16<<20;
+const size_t in_place_batch_moves = 1<<20;
+
+typedef struct{
+    uint64_t src; // offset in the input file
+    uint32_t len;
+    int64_t usecs; // lifecycle time for -t
+} In_Place_Msg;
+
+int64_t get_input_offset(const DltMessage &msg); // of a msg with a Payload_Ref (as kept with use_in_place)
+
+/* permutes the file according to plan (in output order). Writes the journal
+ to journal_name and removes it once done. stats can be NULL */
+int permute_in_place(std::string const &name, std::vector<In_Place_Msg> const &plan, bool timeadjust, std::string const &journal_name, Sort_Stats *stats);
+int resume_in_place(std::string const &name, std::string const &journal_name, Sort_Stats *stats); // continues an interrupted permute_in_place
+
+/* sorts the single file ifiles[0] in place. If <file>.inplace exists the
+ interrupted run is continued instead (without parsing). */
+int sort_dlt_file_in_place(std::vector<std::string> const &ifiles, bool do_split, bool do_timeadjust, Sort_Stats *stats=0);
+
+#endif
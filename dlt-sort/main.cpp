@@ -9,11 +9,20 @@
 #include <getopt.h>
 
 #include "dlt-sort.h"
+#include "msg_arena.h"
+#include "mem_budget.h"
+#include "pipeline.h"
+#include "async_read.h"
+#include "payload_blocks.h"
+#include "nav_index.h"
+#include "in_place.h"
+#include "fan_out.h"
+#include "dedup.h"
+#include "server.h"
+#include "shard.h"
 
 using namespace std;
 
-const char* const dlt_sort_version="1.3";
-
 void print_usage();
 
 void print_usage()
@@ -24,11 +33,38 @@ void print_usage()
     cout << " -t --timestamps adjust time in storageheader to detected lifecycle time. Changes the orig. logs!\n";
     cout << "--disable_check_max_earlier disable a sanity check for corrupted timestamps (needs to be disabled if logger latency >120s!\n";
     cout << "--disable_clock_drift disable clock drift detection\n";
+    cout << "--skew_per_lc determine the clock drift for each lifecycle on its own (short ones use the one of their ECU)\n";
+    cout << "--fast_skew   determine the clock drift from a sample of the msgs and check it with a single pass over all\n";
+    cout << "--dedup       remove duplicate msgs (e.g. of overlapping captures from two loggers)\n";
     cout << "--trust_logger_timestamp do trust the logger timestamp. Disabled by default (due to some faulty loggers)\n";
+    cout << " -e --ecu ECU1[,ECU2,...] keep only msgs from these ECUs\n";
+    cout << "--exclude_ecu ECU1[,...] drop msgs from these ECUs\n";
+    cout << " -a --apid APID[,...] keep only msgs from these APIDs\n";
+    cout << "--exclude_apid APID[,...] drop msgs from these APIDs\n";
+    cout << " -c --ctid CTID[,...] keep only msgs from these CTIDs\n";
+    cout << "--exclude_ctid CTID[,...] drop msgs from these CTIDs\n";
+    cout << " -l --loglevel level keep only log msgs up to this level (1=fatal ... 6=verbose)\n";
+    cout << " -j --jobs nr  number of threads to use for all stages (default: number of cpus)\n";
+    cout << "--mmap_output write the output file (if not split) via a memory mapped file from all threads\n";
+    cout << "--pipeline    read, parse and detect the lifecycles concurrently\n";
+    cout << "--io_uring    read the input files ahead with many reads in flight via io_uring (Linux only)\n";
+    cout << "--map prefix  parse and sort the lifecycles only. Writes them to prefix_lcNNN.dlt and prefix.lcs for --reduce\n";
+    cout << "--reduce      merge the lifecycles of --map. The input files are the .lcs files\n";
+    cout << "--server socket keep the analysed files in memory and answer sort requests on this unix socket (see README)\n";
+    cout << "--hugepages   use transparent huge pages for the msg memory (Linux only)\n";
+    cout << "--compress_payloads keep the payloads compressed in blocks of 64kB until the output\n";
+    cout << "--in_place    sort the single input file in place (no output file). Continues an interrupted run (see README)\n";
+    cout << "--out [ste:]file write the output to file as well (in the same run). s: split, t: adjust timestamps, e: one file per ECU. Can be repeated\n";
+    cout << "--index       write a navigation index (offset, time, ecu and apid per msg) to <output file>.idx\n";
+    cout << "--mem_limit MB keep the memory for the msgs below MB. Close to the limit payloads are re-read from the input files at output\n";
+    cout << "--stats file.json write per stage timings and counters as json to file.json\n";
+    cout << "--trace_events file.json write a timeline of the stages and tasks per thread in chrome trace format (e.g. for perfetto)\n";
     cout << " -h --help     show usage/help\n";
     cout << " -v --verbose  set verbose level to 1 (increase by adding more -v)\n";
 }
 
+static int do_reduce=0; // the input files are .lcs files of --map
+
 int main(int argc, char * argv[])
 {
     cout << "dlt-sort (v" << dlt_sort_version << ") (c) 2013, 2014 Matthias Behr\n";
@@ -42,6 +78,11 @@ int main(int argc, char * argv[])
     bool do_split=false; // by default don't split output files per lifecycle
     bool do_timeadjust=false; // by default don't adjust timestamps in generated dlt file
     std::string ofilename ("dlt_sorted.dlt");
+    std::string stats_filename; // empty = no stats
+    std::string trace_filename; // empty = no trace events
+    std::string server_socket; // empty = no server mode
+    std::string map_prefix; // empty = no map mode
+    std::vector<Output_Spec> extra_outputs; // --out. Written besides ofilename
     
     static struct option long_options[] =
     {
@@ -49,21 +90,98 @@ int main(int argc, char * argv[])
         {"verbose", no_argument,       &verbose, 1},
         {"disable_check_max_earlier", no_argument, &use_max_earlier_sanity_check, 0},
         {"disable_clock_drift", no_argument, &use_clock_drift_detection, 0},
+        {"skew_per_lc", no_argument, &use_skew_per_lc, 1},
+        {"fast_skew", no_argument, &use_fast_skew, 1},
+        {"dedup", no_argument, &use_dedup, 1},
         {"trust_logger_timestamp", no_argument, &trust_logger_time, 1},
+        {"mmap_output", no_argument, &use_mmap_output, 1},
+        {"hugepages", no_argument, &use_huge_pages, 1},
+        {"pipeline", no_argument, &use_pipeline, 1},
+        {"io_uring", no_argument, &use_io_uring, 1},
+        {"compress_payloads", no_argument, &use_payload_blocks, 1},
+        {"index", no_argument, &use_nav_index, 1},
+        {"in_place", no_argument, &use_in_place, 1},
+        {"reduce", no_argument, &do_reduce, 1},
         /* These options don't set a flag.
          We distinguish them by their indices. */
         {"split",     no_argument,       0, 's'},
         {"timestamps", no_argument, 0, 't'},
         {"file",    required_argument, 0, 'f'},
         {"help", no_argument, 0, 'h'},
+        {"ecu", required_argument, 0, 'e'},
+        {"apid", required_argument, 0, 'a'},
+        {"ctid", required_argument, 0, 'c'},
+        {"loglevel", required_argument, 0, 'l'},
+        {"jobs", required_argument, 0, 'j'},
+        {"exclude_ecu", required_argument, 0, 0},
+        {"exclude_apid", required_argument, 0, 0},
+        {"exclude_ctid", required_argument, 0, 0},
+        {"mem_limit", required_argument, 0, 0},
+        {"stats", required_argument, 0, 0},
+        {"trace_events", required_argument, 0, 0},
+        {"server", required_argument, 0, 0},
+        {"map", required_argument, 0, 0},
+        {"out", required_argument, 0, 0},
         {0, 0, 0, 0}
     };
-    while ((c = getopt_long (argc, argv, "vhstf:", long_options, &option_index))!= -1){
+    while ((c = getopt_long (argc, argv, "vhstf:e:a:c:l:j:", long_options, &option_index))!= -1){
         switch(c)
         {
             case 0:
                 if (long_options[option_index].flag != 0)
                     break;
+                if (!strcmp(long_options[option_index].name, "exclude_ecu")){
+                    if (!add_filter_ids(msg_filter.excl_ecus, optarg)) return -1;
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "exclude_apid")){
+                    if (!add_filter_ids(msg_filter.excl_apids, optarg)) return -1;
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "exclude_ctid")){
+                    if (!add_filter_ids(msg_filter.excl_ctids, optarg)) return -1;
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "trace_events")){
+                    trace_filename = std::string(optarg);
+                    use_trace_events = 1;
+                    if(verbose) cout << " writing trace events to <" << trace_filename << ">\n";
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "mem_limit")){
+                    int mb = atoi(optarg);
+                    if (mb<1){
+                        cerr << "invalid mem_limit <" << optarg << ">!\n";
+                        return -1;
+                    }
+                    mem_limit = ((int64_t)mb)<<20;
+                    if(verbose) cout << " using a memory limit of " << mb << "MB\n";
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "map")){
+                    map_prefix = std::string(optarg);
+                    if(verbose) cout << " writing the lifecycles to <" << map_prefix << ".lcs>\n";
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "out")){
+                    Output_Spec spec;
+                    if (!parse_output_spec(optarg, spec)){
+                        cerr << "invalid output <" << optarg << ">!\n";
+                        return -1;
+                    }
+                    extra_outputs.push_back(spec);
+                    if(verbose) cout << " writing the output to <" << spec.name << "> as well\n";
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "server")){
+                    server_socket = std::string(optarg);
+                    break;
+                }
+                if (!strcmp(long_options[option_index].name, "stats")){
+                    stats_filename = std::string(optarg);
+                    if(verbose) cout << " writing stats to <" << stats_filename << ">\n";
+                    break;
+                }
                 printf("option %s", long_options[option_index].name);
                 if (optarg)
                     printf(" with arg %s", optarg);
@@ -88,6 +206,29 @@ int main(int argc, char * argv[])
                 ofilename=std::string (optarg);
                 if(verbose) cout << " using <" << ofilename << "> as output file name\n";
                 break;
+            case 'e':
+                if (!add_filter_ids(msg_filter.incl_ecus, optarg)) return -1;
+                break;
+            case 'a':
+                if (!add_filter_ids(msg_filter.incl_apids, optarg)) return -1;
+                break;
+            case 'c':
+                if (!add_filter_ids(msg_filter.incl_ctids, optarg)) return -1;
+                break;
+            case 'j':
+                nr_jobs = atoi(optarg);
+                if (nr_jobs<1){
+                    cerr << "invalid number of jobs <" << optarg << ">!\n";
+                    return -1;
+                }
+                break;
+            case 'l':
+                msg_filter.max_log_level = atoi(optarg);
+                if (msg_filter.max_log_level<1 || msg_filter.max_log_level>6){
+                    cerr << "invalid loglevel <" << optarg << ">. Needs to be 1..6!\n";
+                    return -1;
+                }
+                break;
             default:
                 abort();
         }
@@ -110,103 +251,60 @@ int main(int argc, char * argv[])
             cout << " enabled trust logger time (as before v1.2)\n";
         if (!use_clock_drift_detection)
             cout << " disabled clock drift detection\n";
+        else if (use_skew_per_lc)
+            cout << " enabled clock drift detection per lifecycle\n";
+        if (use_clock_drift_detection && use_fast_skew)
+            cout << " enabled fast clock drift detection\n";
+        if (use_dedup)
+            cout << " enabled removal of duplicate msgs\n";
+        if (use_io_uring)
+            cout << " enabled reading via io_uring\n";
+        if (use_payload_blocks)
+            cout << " enabled compressed payloads\n";
+        if (use_nav_index)
+            cout << " enabled navigation index\n";
+        if (use_in_place)
+            cout << " enabled in place sorting\n";
     }
     
-    // let's process the input files:
-    for (option_index=0; option_index<argc; option_index++){
-        printf("Processing file %s:\n", argv[option_index]);
-        std::ifstream fin;
-        fin.open(argv[option_index], ios::in|ios::binary);
-        if (fin.is_open()){
-            
-            (void)process_input(fin); // and ignore parsing errors. just continue with next file
-            
-            fin.close();
-        } else {
-            cerr << "can't open <" << argv[option_index] << "> as file for input!\n";
-            return -1;
-        }
-    }
-    
-    // now print some stats:
-    // iterate through the list of ECUs:
-    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!= map_ecus.end(); ++it){
-        char ecu[5];
-        ecu[4]=0;
-        memcpy(ecu, (char*) &it->first, sizeof(uint32_t));
-        cout << "ECU <" << ecu << "> contains " << it->second.msgs.size() << " msgs\n";
+    if (server_socket.length()){
+        Sort_Server server((unsigned int)nr_jobs);
+        return server.run(server_socket);
     }
     
-    /* determine lifecycles for each ECU:
-     A new lifecycle is determined by the time distance between abs and rel timestamps.
-     */
-    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!= map_ecus.end(); ++it){
-        ECU_Info &info = it->second;
-        
-        determine_lcs(info);
-        // now we expect at least one lc!
-        assert(info.lcs.size()>0);
-        
-        char ecu[5];
-        ecu[4]=0;
-        memcpy(ecu, (char*) &it->first, sizeof(uint32_t));
-        size_t nr_lcs = info.lcs.size();
-        cout << "ECU <" << ecu << "> contains " << nr_lcs << " lifecycle\n";
-        debug_print(info.lcs);
-        
-        // determine clock skew per ecu:
-        if (use_clock_drift_detection)
-            determine_clock_skew(info);
-        
-        // now see whether they overlap (the detection does not always work 100%
-        // esp. on short lifecycles):
-        merge_lcs(info);
-        sort_msgs_lcs(info);
-        if (info.lcs.size() != nr_lcs){
-            cout << "ECU <" << ecu << "> contains " << info.lcs.size() << " lifecycle after merge:\n";
-            debug_print(info.lcs);
-        }
-    }
+    std::vector<std::string> ifiles;
+    for (option_index=0; option_index<argc; option_index++)
+        ifiles.push_back(std::string(argv[option_index]));
     
-    /* now determine the set of lifecycles that belong to each other 
-     */
-    determine_overall_lcs();
-    
-    // print them:
-    if (verbose>0){
-        cout << "Overall lifecycles detected (" << list_olcs.size() << ")\n";
-        debug_print(list_olcs);
-    }
-    
-    /* now output to file
-     if do_split is set we have to maintain a new file for each olc.
-     otherwise just output to a single file.
-     */
-    std::ofstream *f=0;
-    int f_cnt=1;
-    if (!do_split)
-        f=get_ofstream(0, ofilename);
-    
-    for (LIST_OF_OLCS::iterator it=list_olcs.begin(); it!= list_olcs.end(); ++it){
-        if (do_split){
-            if (f) f->close();
-            f=get_ofstream(f_cnt, ofilename);
-        }
-        (*it).output_to_fstream(*f, do_timeadjust); // todo error handling
-        ++f_cnt;
-    }
-    if (f) f->close();
-    
-    // free memory: (not really needed as we exit anyhow here but to make valgrind,... happy:
-    for (MAP_OF_ECUS::iterator it = map_ecus.begin(); it != map_ecus.end(); ++it){
-       if (verbose>=2) cout << "deallocating " << it->second.msgs.size() << " msgs\n";
-        for (LIST_OF_MSGS::iterator j = it->second.msgs.begin(); j != it->second.msgs.end(); ++j){
-            DltMessage *m = *j;
-            if (m->databuffer) delete m->databuffer;
-            delete m;
-        }
+    if (extra_outputs.size() && (map_prefix.length() || use_in_place || do_reduce)){
+        cerr << "--out can't be used with --map, --reduce or --in_place!\n";
+        return -1;
     }
     
-    return 0; // no error (<0 for error)
+    Sort_Stats stats;
+    int ret;
+    if (map_prefix.length())
+        ret = map_dlt_files(ifiles, map_prefix, stats_filename.length() ? &stats : 0);
+    else if (use_in_place)
+        ret = sort_dlt_file_in_place(ifiles, do_split, do_timeadjust, stats_filename.length() ? &stats : 0);
+    else if (do_reduce)
+        ret = reduce_dlt_files(ifiles, ofilename, do_split, do_timeadjust, stats_filename.length() ? &stats : 0);
+    else if (extra_outputs.size()){
+        // all outputs from one merge pass:
+        Output_Spec spec;
+        init_Output_Spec(spec);
+        spec.name = ofilename;
+        spec.split = do_split;
+        spec.timeadjust = do_timeadjust;
+        extra_outputs.insert(extra_outputs.begin(), spec);
+        ret = sort_dlt_files(ifiles, extra_outputs, stats_filename.length() ? &stats : 0);
+    }else
+        ret = sort_dlt_files(ifiles, ofilename, do_split, do_timeadjust, stats_filename.length() ? &stats : 0);
+    // a failed run is of interest as well. Its error is the exit code:
+    if (stats_filename.length() && write_stats_json(stats, ifiles, stats_filename, ret) && ret==0)
+        ret = -1;
+    if (ret==0 && trace_filename.length())
+        ret = write_trace_events(trace_filename);
+    return ret; // no error (<0 for error)
 }
 
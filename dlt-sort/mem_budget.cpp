@@ -0,0 +1,149 @@
+//
+//  mem_budget.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "mem_budget.h"
+#include "msg_arena.h"
+
+using namespace std;
+
+int64_t mem_limit = 0; // by default no limit
+int use_payload_refs = 0;
+static bool warned_mem_limit = false;
+
+#ifdef WIN32
+static std::vector<std::string> payload_files;
+#else
+static std::vector<int> payload_fds;
+#endif
+
+// the std containers don't tell their node sizes. So we estimate them:
+const int64_t msg_node_size = 3*sizeof(void*); // prev, next, DltMessage *
+const int64_t lc_node_size = sizeof(Lifecycle) + 2*sizeof(void*);
+const int64_t olc_node_size = sizeof(OverallLC) + 2*sizeof(void*);
+const int64_t ecu_node_size = sizeof(MAP_OF_ECUS::value_type) + 4*sizeof(void*); // rb-tree node
+
+static void add_lcs_usage(const LIST_OF_LCS &lcs, Mem_Usage &usage)
+{
+    for (LIST_OF_LCS::const_iterator it=lcs.begin(); it!=lcs.end(); ++it)
+        usage.list_nodes += msg_node_size * (int64_t)(*it).msgs.size();
+    usage.lcs += lc_node_size * (int64_t)lcs.size();
+}
+
+void get_mem_usage(Mem_Usage &usage, bool with_lcs)
+{
+    memset(&usage, 0, sizeof(usage));
+    usage.msgs = (int64_t)msg_arena.bytes_msgs();
+    usage.payloads = (int64_t)msg_arena.bytes_payloads();
+    usage.arena_reserved = (int64_t)msg_arena.bytes_reserved();
+    for (MAP_OF_ECUS::const_iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it){
+        usage.list_nodes += msg_node_size * (int64_t)it->second.msgs.size();
+        if (with_lcs) add_lcs_usage(it->second.lcs, usage);
+    }
+    usage.lcs += ecu_node_size * (int64_t)map_ecus.size();
+    for (LIST_OF_OLCS::const_iterator it=list_olcs.begin(); it!=list_olcs.end(); ++it)
+        add_lcs_usage((*it).lcs, usage);
+    usage.lcs += olc_node_size * (int64_t)list_olcs.size();
+}
+
+int64_t get_mem_total(const Mem_Usage &usage)
+{
+    return usage.msgs + usage.payloads + usage.list_nodes + usage.lcs;
+}
+
+void print_mem_usage(const char *stage, const Mem_Usage &usage)
+{
+    cout << "memory after " << stage << ": " << (get_mem_total(usage)>>10) << "kB (msgs " << (usage.msgs>>10);
+    cout << "kB, payloads " << (usage.payloads>>10) << "kB, list nodes " << (usage.list_nodes>>10);
+    cout << "kB, lifecycles " << (usage.lcs>>10) << "kB, arena reserved " << (usage.arena_reserved>>10) << "kB)\n";
+}
+
+void init_mem_budget()
+{
+    use_payload_refs = 0;
+    warned_mem_limit = false;
+}
+
+void check_mem_limit()
+{
+    if (!mem_limit) return;
+    Mem_Usage usage;
+    get_mem_usage(usage, false); // the lcs might be modified by the pipeline (and are empty otherwise)
+    int64_t total = get_mem_total(usage);
+    if (!use_payload_refs && total > (mem_limit/4)*3){
+        cerr << "memory usage " << (total>>20) << "MB close to mem_limit. Keeping the payloads in the input files from now on.\n";
+        use_payload_refs = 1;
+    }
+    if (!warned_mem_limit && total > mem_limit){
+        // we don't spill the msg records. So we can just continue and warn:
+        cerr << "memory usage " << (total>>20) << "MB exceeds mem_limit!\n";
+        warned_mem_limit = true;
+    }
+}
+
+int open_payload_files(std::vector<std::string> const &ifiles)
+{
+    close_payload_files();
+#ifdef WIN32
+    payload_files = ifiles;
+#else
+    for (size_t i=0; i<ifiles.size(); ++i){
+        int fd = open(ifiles[i].c_str(), O_RDONLY);
+        if (fd<0){
+            cerr << "can't open <" << ifiles[i] << "> to read the payloads!\n";
+            close_payload_files();
+            return -1;
+        }
+        payload_fds.push_back(fd);
+    }
+#endif
+    return 0;
+}
+
+void close_payload_files()
+{
+#ifdef WIN32
+    payload_files.clear();
+#else
+    for (size_t i=0; i<payload_fds.size(); ++i) close(payload_fds[i]);
+    payload_fds.clear();
+#endif
+}
+
+bool read_payload(const DltMessage &msg, unsigned char *dst)
+{
+    assert(msg.found_serialheader & DLT_SORT_MSG_PAYLOAD_REF);
+    Payload_Ref ref;
+    memcpy(&ref, msg.databuffer, sizeof(ref));
+    return read_payload_range(ref.file_idx, ref.offset, (size_t)msg.databuffersize, dst);
+}
+
+bool read_payload_range(uint32_t file_idx, int64_t offset, size_t len, unsigned char *dst)
+{
+#ifdef WIN32
+    if (file_idx >= payload_files.size()) return false;
+    // a stream per call keeps it thread-safe. This is the slow path anyhow.
+    std::ifstream f(payload_files[file_idx].c_str(), ios::in|ios::binary);
+    f.seekg(offset);
+    f.read((char*)dst, len);
+    if (!f.good()) return false;
+#else
+    if (file_idx >= payload_fds.size()) return false;
+    size_t done = 0;
+    while (done<len){
+        ssize_t r = pread(payload_fds[file_idx], dst+done, len-done, (off_t)(offset+(int64_t)done));
+        if (r<=0) break;
+        done += (size_t)r;
+    }
+    if (done<len) return false;
+#endif
+    return true;
+}
@@ -0,0 +1,40 @@
+//
+//  mem_budget.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_mem_budget_h
+#define dlt_sort_mem_budget_h
+
+#include "dlt-sort.h"
+
+/* accounting of the memory held by the sorting state and the degradation
+ if a memory limit is set (--mem_limit):
+ If the usage gets close to the limit during parsing the payloads of all
+ further msgs are not kept in memory any longer. Only a Payload_Ref (file
+ and offset) is kept and the payload is read again from the input file
+ at output time. */
+
+extern int64_t mem_limit; // in bytes. 0 = no limit
+extern int use_payload_refs; // set by check_mem_limit once the usage is close to the limit
+
+typedef struct{
+    uint32_t file_idx; // index into the files passed to open_payload_files
+    int64_t offset; // of the payload within that file
+} Payload_Ref;
+
+void get_mem_usage(Mem_Usage &usage, bool with_lcs=true); // of map_ecus, list_olcs and msg_arena. Without the lcs of the ECUs if !with_lcs
+int64_t get_mem_total(const Mem_Usage &usage); // without arena_reserved
+void print_mem_usage(const char *stage, const Mem_Usage &usage);
+void init_mem_budget(); // resets use_payload_refs and the warnings. Call before parsing
+void check_mem_limit(); // call periodically during parsing. Sets use_payload_refs if above 75% of the limit
+
+int open_payload_files(std::vector<std::string> const &ifiles); // 0 = success
+void close_payload_files();
+bool read_payload(const DltMessage &msg, unsigned char *dst); // dst needs databuffersize bytes. thread-safe
+bool read_payload_range(uint32_t file_idx, int64_t offset, size_t len, unsigned char *dst); // any range of the files. thread-safe
+
+#endif
@@ -0,0 +1,125 @@
+//
+//  msg_arena.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <new>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+#include "msg_arena.h"
+#include "dlt-sort.h"
+
+int use_huge_pages=0; // by default don't ask for transparent huge pages
+
+MsgArena msg_arena;
+
+const size_t huge_page_size = 2*1024*1024;
+
+MsgArena::MsgArena(size_t size) : chunk_size(size), cur(0), end(0), used(0), used_msgs(0), used_payloads(0)
+{
+}
+
+MsgArena::~MsgArena()
+{
+    release();
+}
+
+void MsgArena::free_chunk(Chunk &c)
+{
+#ifndef WIN32
+    if (c.mapped){
+        munmap(c.mem, c.size);
+        return;
+    }
+#endif
+    free(c.mem);
+}
+
+void MsgArena::new_chunk(size_t min_size)
+{
+    Chunk c;
+    c.size = chunk_size;
+    if (c.size < min_size) c.size = min_size;
+    c.mapped = false;
+    c.mem = 0;
+#ifndef WIN32
+    if (use_huge_pages) c.size = (c.size + huge_page_size - 1) & ~(huge_page_size-1);
+    void *m = mmap(NULL, c.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (m != MAP_FAILED){
+        c.mem = (char *)m;
+        c.mapped = true;
+#ifdef MADV_HUGEPAGE
+        if (use_huge_pages) (void)madvise(m, c.size, MADV_HUGEPAGE); // just a hint
+#endif
+    }
+#endif
+    if (!c.mem){
+        c.mem = (char *)malloc(c.size);
+        if (!c.mem) throw std::bad_alloc();
+    }
+    chunks.push_back(c);
+    cur = c.mem;
+    end = c.mem + c.size;
+}
+
+void *MsgArena::alloc(size_t size, size_t align)
+{
+    assert(align && !(align & (align-1))); // power of 2
+    uintptr_t p = ((uintptr_t)cur + (align-1)) & ~(uintptr_t)(align-1);
+    if (!cur || p + size > (uintptr_t)end){
+        // the rest of the current chunk is wasted. As we allocate only small objects that's <64kb
+        new_chunk(size + align);
+        p = ((uintptr_t)cur + (align-1)) & ~(uintptr_t)(align-1);
+    }
+    cur = (char *)(p + size);
+    used += size;
+    return (void *)p;
+}
+
+DltMessage *MsgArena::alloc_msg()
+{
+    DltMessage *msg = new (alloc(sizeof(DltMessage))) DltMessage;
+    used_msgs += sizeof(DltMessage);
+    init_DltMessage(*msg);
+    return msg;
+}
+
+void MsgArena::release()
+{
+    for (size_t i=0; i<chunks.size(); ++i)
+        free_chunk(chunks[i]);
+    chunks.clear();
+    cur = end = 0;
+    used = 0;
+    used_msgs = 0;
+    used_payloads = 0;
+}
+
+void MsgArena::take_over(MsgArena &other)
+{
+    // we keep allocating from our current chunk. The others are just kept to be freed later
+    if (!other.chunks.size()) return;
+    chunks.insert(chunks.begin(), other.chunks.begin(), other.chunks.end());
+    used += other.used;
+    used_msgs += other.used_msgs;
+    used_payloads += other.used_payloads;
+    other.chunks.clear();
+    other.cur = other.end = 0;
+    other.used = 0;
+    other.used_msgs = 0;
+    other.used_payloads = 0;
+}
+
+size_t MsgArena::bytes_reserved() const
+{
+    size_t ret=0;
+    for (size_t i=0; i<chunks.size(); ++i) ret += chunks[i].size;
+    return ret;
+}
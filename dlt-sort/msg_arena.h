@@ -0,0 +1,58 @@
+//
+//  msg_arena.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_msg_arena_h
+#define dlt_sort_msg_arena_h
+
+#include <stddef.h>
+#include <vector>
+
+#include <dlt/dlt_common.h>
+
+/* chunked arena for all msgs and payloads of a run.
+ Allocation is a pointer bump within the current chunk. Nothing is freed
+ individually. release() frees all chunks at once.
+ Not thread safe. Use one arena per thread. */
+class MsgArena{
+public:
+    MsgArena(size_t chunk_size = 64*1024*1024);
+    ~MsgArena();
+    void *alloc(size_t size, size_t align = sizeof(void *));
+    DltMessage *alloc_msg(); // returns an initialized (init_DltMessage) msg
+    unsigned char *alloc_payload(size_t size) { used_payloads += size; return (unsigned char *)alloc(size, 1); }
+    void release(); // frees all chunks. All msgs/payloads are invalid afterwards!
+    void take_over(MsgArena &other); // moves the chunks from other to this one
+    size_t nr_chunks() const { return chunks.size(); }
+    size_t bytes_reserved() const; // sum of the chunk sizes
+    size_t bytes_used() const { return used; }
+    size_t bytes_msgs() const { return used_msgs; } // part of bytes_used() for msg records
+    size_t bytes_payloads() const { return used_payloads; } // part of bytes_used() for payloads
+private:
+    MsgArena(const MsgArena&); // not copyable
+    MsgArena &operator=(const MsgArena&);
+    typedef struct{
+        char *mem;
+        size_t size;
+        bool mapped; // allocated via mmap (otherwise malloc)
+    } Chunk;
+    void new_chunk(size_t min_size);
+    static void free_chunk(Chunk &c);
+    // member vars:
+    size_t chunk_size;
+    std::vector<Chunk> chunks;
+    char *cur; // next free byte in the last chunk
+    char *end; // end of the last chunk
+    size_t used;
+    size_t used_msgs;
+    size_t used_payloads;
+};
+
+extern int use_huge_pages;
+extern MsgArena msg_arena; // the arena used by process_input
+
+#endif
@@ -0,0 +1,108 @@
+//
+//  nav_index.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <string.h>
+#include <limits>
+#include "nav_index.h"
+
+using namespace std;
+
+int use_nav_index = 0; // by default no index is written
+
+const char nav_index_magic[8] = {'D','L','T','S','I','D','X','1'};
+const uint32_t nav_index_version = 1;
+const uint32_t nav_index_record_size = 24;
+const size_t nav_index_header_size = 40;
+const size_t nav_index_buf_size = 1<<20;
+
+static inline void put_u32(char *&p, uint32_t v)
+{
+    for (int i=0; i<4; ++i) *p++ = (char)((v >> (8*i)) & 0xff);
+}
+
+static inline void put_u64(char *&p, uint64_t v)
+{
+    for (int i=0; i<8; ++i) *p++ = (char)((v >> (8*i)) & 0xff);
+}
+
+Nav_Index_Writer::Nav_Index_Writer(std::string const &ofilename) : name(ofilename + ".idx"), buf(nav_index_buf_size), nr_msgs(0), offset(0), max_usecs(std::numeric_limits<int64_t>::min()), closed(false)
+{
+    f.rdbuf()->pubsetbuf(&buf[0], buf.size());
+    f.open(name.c_str(), ios::out|ios::binary|ios::trunc);
+    if (!f.is_open()) cerr << "can't open <" << name << "> for writing!\n";
+    char header[nav_index_header_size];
+    memset(header, 0, sizeof(header)); // the counts are set by close
+    f.write(header, sizeof(header));
+}
+
+void Nav_Index_Writer::add(const Out_Msg &o)
+{
+    const DltMessage &msg = *o.msg;
+    uint32_t ecu = get_ecu_id(msg);
+    add(get_adjusted_time(o), (const char *)&ecu, DLT_IS_HTYP_UEH(msg.standardheader->htyp) ? msg.extendedheader->apid : 0, get_message_size(msg));
+}
+
+void Nav_Index_Writer::add(int64_t usecs, const char *ecu, const char *apid, size_t msg_size)
+{
+    if (usecs > max_usecs) max_usecs = usecs;
+    if (nr_msgs % nav_index_coarse_msgs == 0){
+        Coarse_Entry e;
+        e.usecs = max_usecs;
+        e.msg_nr = nr_msgs;
+        e.offset = offset;
+        coarse.push_back(e);
+    }
+    char rec[nav_index_record_size];
+    char *p = rec;
+    put_u64(p, offset);
+    put_u64(p, (uint64_t)usecs);
+    memcpy(p, ecu, 4);
+    p += 4;
+    if (apid) memcpy(p, apid, 4); else memset(p, 0, 4);
+    f.write(rec, sizeof(rec));
+    ++nr_msgs;
+    offset += msg_size;
+}
+
+int Nav_Index_Writer::close()
+{
+    if (closed) return f.good() ? 0 : -1;
+    closed = true;
+    for (size_t i=0; i<coarse.size(); ++i){
+        char entry[24];
+        char *p = entry;
+        put_u64(p, (uint64_t)coarse[i].usecs);
+        put_u64(p, coarse[i].msg_nr);
+        put_u64(p, coarse[i].offset);
+        f.write(entry, sizeof(entry));
+    }
+    char header[nav_index_header_size];
+    char *p = header;
+    memcpy(p, nav_index_magic, sizeof(nav_index_magic));
+    p += sizeof(nav_index_magic);
+    put_u32(p, nav_index_version);
+    put_u32(p, nav_index_record_size);
+    put_u64(p, nr_msgs);
+    put_u64(p, (uint64_t)coarse.size());
+    put_u64(p, nav_index_coarse_msgs);
+    f.seekp(0);
+    f.write(header, sizeof(header));
+    f.close();
+    if (f.fail()){
+        cerr << "error writing <" << name << ">!\n";
+        return -1;
+    }
+    return 0;
+}
+
+int write_nav_index(std::string const &ofilename, const VEC_OF_OUT_MSGS &order)
+{
+    Nav_Index_Writer index(ofilename);
+    for (size_t i=0; i<order.size(); ++i) index.add(order[i]);
+    return index.close();
+}
@@ -0,0 +1,64 @@
+//
+//  nav_index.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_nav_index_h
+#define dlt_sort_nav_index_h
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+
+/* navigation index of an output file (--index):
+ Written to <output file>.idx while the output is written, so viewers don't
+ need to scan the sorted file again. All values are little endian.
+ header (40 bytes):
+  char magic[8] "DLTSIDX1", uint32_t version (1), uint32_t record size (24),
+  uint64_t nr of msgs, uint64_t nr of coarse entries, uint64_t msgs per coarse entry
+ one record per msg (in output order):
+  uint64_t offset in the output file, int64_t time (usecs since 1.1.1970 in
+  the lifecycle time as with -t), char ecu[4], char apid[4] (0 if none)
+ coarse entries (one per nav_index_coarse_msgs msgs, after the records):
+  int64_t max. time up to this msg, uint64_t msg nr, uint64_t offset
+ The time isn't strictly increasing (e.g. at lifecycle borders) so the coarse
+ entries keep the max. time so far to allow a binary search. */
+
+extern int use_nav_index;
+
+const uint64_t nav_index_coarse_msgs = 1024;
+
+class Nav_Index_Writer{
+public:
+    explicit Nav_Index_Writer(std::string const &ofilename); // writes to ofilename.idx
+    ~Nav_Index_Writer() { close(); }
+    void add(const Out_Msg &o); // the next msg of the output file
+    void add(int64_t usecs, const char *ecu, const char *apid, size_t msg_size); // apid can be NULL
+    int close(); // writes the coarse entries and the header. 0 = success
+private:
+    Nav_Index_Writer(const Nav_Index_Writer&); // not copyable
+    Nav_Index_Writer &operator=(const Nav_Index_Writer&);
+    typedef struct{
+        int64_t usecs;
+        uint64_t msg_nr;
+        uint64_t offset;
+    } Coarse_Entry;
+    // member vars:
+    std::string name;
+    std::vector<char> buf;
+    std::ofstream f;
+    uint64_t nr_msgs;
+    uint64_t offset; // of the next msg
+    int64_t max_usecs;
+    std::vector<Coarse_Entry> coarse;
+    bool closed;
+};
+
+int write_nav_index(std::string const &ofilename, const VEC_OF_OUT_MSGS &order); // for an output file with these msgs. 0 = success
+
+#endif
@@ -0,0 +1,227 @@
+//
+//  payload_blocks.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <string.h>
+#include "payload_blocks.h"
+
+using namespace std;
+
+int use_payload_blocks = 0; // by default each payload is kept uncompressed
+
+/* the LZ4 block format: a sequence is a token (literal length in the upper and
+ match length-4 in the lower nibble, 15 = continued with bytes until one <255),
+ the literals, the 2 byte (little endian) offset of the match and the rest of
+ the match length. The last sequence has literals only. */
+const unsigned int lz_hash_log = 12;
+const size_t lz_min_match = 4;
+const size_t lz_last_literals = 5; // the last bytes are always literals
+const size_t lz_max_offset = 65535;
+
+static inline uint32_t lz_read32(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline unsigned char *lz_write_length(unsigned char *op, size_t len)
+{
+    // the part of a length >=15 that doesn't fit into the token:
+    for (; len>=255; len-=255) *op++ = 255;
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+static unsigned char *lz_write_sequence(unsigned char *op, const unsigned char *literals, size_t nr_literals, size_t offset, size_t match_len)
+{
+    unsigned char *token = op++;
+    *token = (unsigned char)(std::min<size_t>(nr_literals, 15)<<4);
+    if (nr_literals>=15) op = lz_write_length(op, nr_literals-15);
+    memcpy(op, literals, nr_literals);
+    op += nr_literals;
+    if (!match_len) return op; // last sequence
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    match_len -= lz_min_match;
+    *token |= (unsigned char)std::min<size_t>(match_len, 15);
+    if (match_len>=15) op = lz_write_length(op, match_len-15);
+    return op;
+}
+
+size_t lz_compress_bound(size_t len)
+{
+    return len + len/255 + 16;
+}
+
+size_t lz_compress(const unsigned char *src, size_t len, unsigned char *dst)
+{
+    unsigned char *op = dst;
+    size_t anchor = 0; // first literal not written yet
+    if (len > lz_min_match + 2*lz_last_literals){
+        std::vector<uint32_t> table(1<<lz_hash_log, 0); // last position+1 of each hash
+        const size_t match_limit = len - lz_last_literals;
+        const size_t ip_limit = match_limit - lz_min_match - lz_last_literals; // last start of a match
+        size_t ip = 0;
+        while (ip < ip_limit){
+            uint32_t seq = lz_read32(src+ip);
+            uint32_t h = (seq * 2654435761U) >> (32-lz_hash_log);
+            size_t ref = table[h];
+            table[h] = (uint32_t)(ip+1);
+            if (!ref || ip-(ref-1) > lz_max_offset || lz_read32(src+ref-1)!=seq){
+                ip += 1 + ((ip-anchor)>>6); // skip faster through incompressible data
+                continue;
+            }
+            --ref;
+            size_t match_len = lz_min_match;
+            while (ip+match_len < match_limit && src[ref+match_len]==src[ip+match_len]) ++match_len;
+            op = lz_write_sequence(op, src+anchor, ip-anchor, ip-ref, match_len);
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+    op = lz_write_sequence(op, src+anchor, len-anchor, 0, 0);
+    return (size_t)(op-dst);
+}
+
+bool lz_decompress(const unsigned char *src, size_t len, unsigned char *dst, size_t dst_len)
+{
+    size_t ip = 0, op = 0;
+    while (ip < len){
+        unsigned int token = src[ip++];
+        size_t nr_literals = token>>4;
+        if (nr_literals==15){
+            unsigned char b;
+            do{
+                if (ip>=len) return false;
+                b = src[ip++];
+                nr_literals += b;
+            }while (b==255);
+        }
+        if (nr_literals > len-ip || nr_literals > dst_len-op) return false;
+        memcpy(dst+op, src+ip, nr_literals);
+        ip += nr_literals;
+        op += nr_literals;
+        if (ip==len) break; // last sequence
+        if (len-ip < 2) return false;
+        size_t offset = src[ip] | ((size_t)src[ip+1]<<8);
+        ip += 2;
+        if (!offset || offset > op) return false;
+        size_t match_len = token & 15;
+        if (match_len==15){
+            unsigned char b;
+            do{
+                if (ip>=len) return false;
+                b = src[ip++];
+                match_len += b;
+            }while (b==255);
+        }
+        match_len += lz_min_match;
+        if (match_len > dst_len-op) return false;
+        // the match might overlap with the bytes it produces. So byte by byte:
+        for (size_t i=0; i<match_len; ++i, ++op) dst[op] = dst[op-offset];
+    }
+    return op==dst_len;
+}
+
+/* a block in the arena: uint32_t raw size, uint32_t stored size, stored bytes.
+ If both sizes are equal the block is stored uncompressed. */
+const size_t block_header_size = 2*sizeof(uint32_t);
+
+unsigned char *Payload_Block_Writer::add(DltMessage &msg, size_t len)
+{
+    if (buf.size() + len > payload_block_size) flush();
+    uint32_t offset = (uint32_t)buf.size();
+    // the block ptr is set by flush:
+    unsigned char *ref = arena.alloc_payload(payload_block_ref_size);
+    memset(ref, 0, sizeof(void*));
+    memcpy(ref+sizeof(void*), &offset, sizeof(offset));
+    refs.push_back(ref);
+    msg.databuffer = ref;
+    msg.found_serialheader |= DLT_SORT_MSG_PAYLOAD_BLOCK;
+    buf.resize(buf.size() + len);
+    return &buf[offset];
+}
+
+void Payload_Block_Writer::flush()
+{
+    if (!refs.size()) return;
+    uint32_t raw_size = (uint32_t)buf.size();
+    uint32_t stored_size = raw_size;
+    const unsigned char *stored = buf.size() ? &buf[0] : 0;
+    tmp.resize(lz_compress_bound(buf.size()));
+    size_t compressed_size = buf.size() ? lz_compress(&buf[0], buf.size(), &tmp[0]) : 0;
+    if (compressed_size < raw_size){
+        stored_size = (uint32_t)compressed_size;
+        stored = &tmp[0];
+    }
+    unsigned char *block = arena.alloc_payload(block_header_size + stored_size);
+    memcpy(block, &raw_size, sizeof(raw_size));
+    memcpy(block+sizeof(raw_size), &stored_size, sizeof(stored_size));
+    if (stored_size) memcpy(block+block_header_size, stored, stored_size);
+    for (size_t i=0; i<refs.size(); ++i) memcpy(refs[i], &block, sizeof(block));
+    bytes_raw += raw_size;
+    bytes_compressed += block_header_size + stored_size;
+    refs.clear();
+    buf.clear();
+}
+
+static void get_block_ref(const DltMessage &msg, const unsigned char *&block, uint32_t &offset)
+{
+    assert(msg.found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK);
+    memcpy(&block, msg.databuffer, sizeof(block));
+    memcpy(&offset, msg.databuffer+sizeof(block), sizeof(offset));
+}
+
+static bool decompress_block(const unsigned char *block, std::vector<unsigned char> &data)
+{
+    uint32_t raw_size, stored_size;
+    memcpy(&raw_size, block, sizeof(raw_size));
+    memcpy(&stored_size, block+sizeof(raw_size), sizeof(stored_size));
+    data.resize(raw_size);
+    if (!raw_size) return true;
+    if (stored_size==raw_size){
+        memcpy(&data[0], block+block_header_size, raw_size);
+        return true;
+    }
+    return lz_decompress(block+block_header_size, stored_size, &data[0], raw_size);
+}
+
+const unsigned char *Payload_Block_Cache::payload(const DltMessage &msg)
+{
+    const unsigned char *block;
+    uint32_t offset;
+    get_block_ref(msg, block, offset);
+    ++nr_uses;
+    Entry *lru = &entries[0];
+    for (size_t i=0; i<entries.size(); ++i){
+        Entry &e = entries[i];
+        if (e.block == block){
+            e.last_use = nr_uses;
+            return &e.data[offset];
+        }
+        if (e.last_use < lru->last_use) lru = &e;
+    }
+    lru->block = 0;
+    if (!decompress_block(block, lru->data)) return 0;
+    if ((size_t)offset + (size_t)msg.databuffersize > lru->data.size()) return 0;
+    lru->block = block;
+    lru->last_use = nr_uses;
+    return &lru->data[offset];
+}
+
+bool read_block_payload(const DltMessage &msg, unsigned char *dst)
+{
+    const unsigned char *block;
+    uint32_t offset;
+    get_block_ref(msg, block, offset);
+    std::vector<unsigned char> data;
+    if (!decompress_block(block, data)) return false;
+    if ((size_t)offset + (size_t)msg.databuffersize > data.size()) return false;
+    memcpy(dst, &data[offset], (size_t)msg.databuffersize);
+    return true;
+}
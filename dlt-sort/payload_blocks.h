@@ -0,0 +1,76 @@
+//
+//  payload_blocks.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_payload_blocks_h
+#define dlt_sort_payload_blocks_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "dlt-sort.h"
+#include "msg_arena.h"
+
+/* compressed payloads (--compress_payloads):
+ The payloads of consecutive msgs (in order of arrival) are collected into
+ blocks of up to payload_block_size bytes. Each full block is compressed
+ (LZ4 block format, see lz_compress) into the arena. The msg keeps only a
+ ref to its block and the offset within the uncompressed block. At output
+ the blocks are decompressed via a small cache of the last used blocks as
+ the output order uses only a few blocks at the same time. */
+
+extern int use_payload_blocks;
+
+const size_t payload_block_size = 64*1024;
+const size_t payload_block_ref_size = sizeof(void*) + sizeof(uint32_t); // block ptr and offset (unaligned)
+const size_t payload_block_cache_size = 16; // nr of decompressed blocks per Payload_Block_Cache
+
+size_t lz_compress_bound(size_t len); // max. size of lz_compress for len bytes
+size_t lz_compress(const unsigned char *src, size_t len, unsigned char *dst); // returns the compressed size
+bool lz_decompress(const unsigned char *src, size_t len, unsigned char *dst, size_t dst_len); // false if src is corrupt or doesn't decompress to dst_len bytes
+
+/* collects the payloads during process_input. Not thread safe. One per parsing thread. */
+class Payload_Block_Writer{
+public:
+    Payload_Block_Writer(MsgArena &a) : arena(a), bytes_raw(0), bytes_compressed(0) { buf.reserve(payload_block_size); }
+    ~Payload_Block_Writer() { flush(); }
+    unsigned char *add(DltMessage &msg, size_t len); // sets the ref of msg. Returns where the caller needs to put the len bytes of the payload
+    void flush(); // compresses the current block. The payloads of the msgs added are invalid until then!
+    int64_t nr_bytes_raw() const { return bytes_raw; }
+    int64_t nr_bytes_compressed() const { return bytes_compressed; }
+private:
+    Payload_Block_Writer(const Payload_Block_Writer&); // not copyable
+    Payload_Block_Writer &operator=(const Payload_Block_Writer&);
+    // member vars:
+    MsgArena &arena;
+    std::vector<unsigned char> buf; // the current block (uncompressed)
+    std::vector<unsigned char *> refs; // of the msgs in the current block
+    std::vector<unsigned char> tmp; // for the compression
+    int64_t bytes_raw;
+    int64_t bytes_compressed;
+};
+
+/* decompressed blocks. The least recently used one is replaced. Not thread safe. */
+class Payload_Block_Cache{
+public:
+    Payload_Block_Cache() : entries(payload_block_cache_size), nr_uses(0) {}
+    const unsigned char *payload(const DltMessage &msg); // of a PAYLOAD_BLOCK msg. Valid until the next call. NULL if corrupt
+private:
+    Payload_Block_Cache(const Payload_Block_Cache&); // not copyable
+    Payload_Block_Cache &operator=(const Payload_Block_Cache&);
+    typedef struct{
+        const unsigned char *block; // NULL = unused
+        uint64_t last_use;
+        std::vector<unsigned char> data;
+    } Entry;
+    std::vector<Entry> entries;
+    uint64_t nr_uses;
+};
+
+bool read_block_payload(const DltMessage &msg, unsigned char *dst); // dst needs databuffersize bytes. Decompresses the whole block (slow)
+
+#endif
@@ -0,0 +1,89 @@
+//
+//  pipeline.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include "pipeline.h"
+#include "async_read.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+int use_pipeline = 0; // by default parse and detect the lifecycles one after the other
+
+typedef struct{
+    ECU_Info *info;
+    DltMessage *msg;
+} LC_Item;
+
+const size_t lc_queue_items = 1<<16;
+
+static std::vector<SPSC_Queue<LC_Item> *> lc_queues; // one per detector thread
+static std::map<const ECU_Info *, size_t> lc_queue_of_ecu; // used by the parsing thread only
+
+static void add_to_pipeline(ECU_Info &info, DltMessage *msg)
+{
+    // each ECU is handled by one detector as the msgs need to be processed in order of arrival:
+    std::map<const ECU_Info *, size_t>::iterator it = lc_queue_of_ecu.find(&info);
+    if (it == lc_queue_of_ecu.end())
+        it = lc_queue_of_ecu.insert(std::make_pair(&info, lc_queue_of_ecu.size() % lc_queues.size())).first;
+    LC_Item item;
+    item.info = &info;
+    item.msg = msg;
+    lc_queues[it->second]->push(item);
+}
+
+static void detect_lcs(SPSC_Queue<LC_Item> *queue)
+{
+    Trace_Span span("detect_lcs", "task");
+    // only this thread modifies the lcs of its ECUs. The parsing thread only adds to the msgs.
+    std::map<ECU_Info *, LC_Detector> detectors;
+    LC_Item item;
+    while (queue->pop(item)){
+        std::map<ECU_Info *, LC_Detector>::iterator it = detectors.find(item.info);
+        if (it == detectors.end())
+            it = detectors.insert(std::make_pair(item.info, LC_Detector(item.info->lcs))).first;
+        it->second.add(item.msg);
+    }
+}
+
+int parse_pipelined(std::vector<std::string> const &ifiles, Sort_Stats *stats)
+{
+    std::vector<int64_t> sizes;
+    if (get_input_sizes(ifiles, sizes)) return -1;
+
+    // the reader and this (parsing) thread are busy all the time. The rest detects the lcs:
+    unsigned int nr_threads = get_nr_threads(nr_jobs);
+    unsigned int nr_detectors = nr_threads>2 ? nr_threads-2 : 1;
+    if (verbose) cout << " pipeline using 1 reader, 1 parser and " << nr_detectors << " lifecycle detector threads\n";
+
+    SPSC_Queue<Read_Block> read_queue(read_queue_blocks);
+    int read_error = 0;
+    std::vector<std::thread> threads;
+    threads.push_back(std::thread(read_files, &ifiles, &read_queue, &read_error));
+    for (unsigned int i=0; i<nr_detectors; ++i){
+        lc_queues.push_back(new SPSC_Queue<LC_Item>(lc_queue_items));
+        threads.push_back(std::thread(detect_lcs, lc_queues[i]));
+    }
+
+    on_msg_added = add_to_pipeline;
+    for (size_t i=0; i<ifiles.size(); ++i){
+        Trace_Span span("parse_file", "task", ifiles[i].c_str());
+        printf("Processing file %s:\n", ifiles[i].c_str());
+        Block_Streambuf buf(read_queue, sizes[i]);
+        std::istream fin(&buf);
+        (void)process_input(fin, stats ? &stats->parse : 0, (int)i); // and ignore parsing errors. just continue with next file
+        if (stats) stats->bytes_read += sizes[i];
+    }
+    on_msg_added = 0;
+
+    for (size_t i=0; i<lc_queues.size(); ++i) lc_queues[i]->close();
+    for (size_t i=0; i<threads.size(); ++i) threads[i].join();
+    for (size_t i=0; i<lc_queues.size(); ++i) delete lc_queues[i];
+    lc_queues.clear();
+    lc_queue_of_ecu.clear();
+    return read_error;
+}
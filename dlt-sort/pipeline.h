@@ -0,0 +1,112 @@
+//
+//  pipeline.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_pipeline_h
+#define dlt_sort_pipeline_h
+
+#include <stddef.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "dlt-sort.h"
+
+/* pipelined parsing (--pipeline):
+ A reader thread reads the input files in blocks, the calling thread parses
+ the blocks and the lifecycle detector threads assign the msgs of their ECUs
+ to lifecycles while the parsing continues. The stages are connected by
+ bounded SPSC_Queues. Afterwards map_ecus contains the same msgs and lcs
+ as after process_input and determine_lcs. */
+
+extern int use_pipeline;
+
+/* bounded single producer/single consumer queue.
+ lock-free: only the producer writes tail and only the consumer writes head.
+ push/pop wait if the queue is full/empty: first spinning (yield) for
+ spsc_spin_count tries, then blocking on a condition variable. So a stage
+ waiting for the disk doesn't use a core. The other side only takes the
+ mutex to wake it if it is blocked. */
+const int spsc_spin_count = 100;
+
+template<typename T> class SPSC_Queue{
+public:
+    explicit SPSC_Queue(size_t capacity) : buf(capacity+1), head(0), tail(0), closed(false), nr_blocked(0) {}
+    bool try_push(const T &v){
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t n = next(t);
+        if (n == head.load(std::memory_order_acquire)) return false; // full
+        buf[t] = v;
+        tail.store(n, std::memory_order_release);
+        wake();
+        return true;
+    }
+    void push(const T &v){
+        for (int i=0; !try_push(v); ++i){
+            if (i < spsc_spin_count) std::this_thread::yield();
+            else block([this]{ return !full(); });
+        }
+    }
+    bool push(const T &v, const std::atomic<bool> &stop){ // false if stop got set while full. The one setting stop calls wake()
+        for (int i=0; !try_push(v); ++i){
+            if (stop.load()) return false;
+            if (i < spsc_spin_count) std::this_thread::yield();
+            else block([this, &stop]{ return !full() || stop.load(); });
+        }
+        return true;
+    }
+    bool try_pop(T &v){
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false; // empty
+        v = buf[h];
+        head.store(next(h), std::memory_order_release);
+        wake();
+        return true;
+    }
+    bool pop(T &v){ // false if closed and empty
+        for (int i=0;; ++i){
+            if (try_pop(v)) return true;
+            if (closed.load(std::memory_order_acquire)) return try_pop(v); // pushed before the close
+            if (i < spsc_spin_count) std::this_thread::yield();
+            else block([this]{ return !empty() || closed.load(std::memory_order_acquire); });
+        }
+    }
+    void close(){ closed.store(true, std::memory_order_release); wake(); } // by the producer after the last push
+    void wake(){ // wakes a blocked push/pop to recheck its condition
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (nr_blocked.load(std::memory_order_relaxed)){
+            std::lock_guard<std::mutex> lock(mutex);
+            cond.notify_all();
+        }
+    }
+private:
+    SPSC_Queue(const SPSC_Queue&); // not copyable
+    SPSC_Queue &operator=(const SPSC_Queue&);
+    size_t next(size_t i) const { return (i+1)==buf.size() ? 0 : i+1; }
+    bool full() const { return next(tail.load(std::memory_order_acquire)) == head.load(std::memory_order_acquire); }
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+    template<typename Ready> void block(Ready ready){
+        std::unique_lock<std::mutex> lock(mutex);
+        nr_blocked.fetch_add(1); // seq_cst: seen by wake or we see the change in ready()
+        // the timeout is a safety net only:
+        while (!ready()) cond.wait_for(lock, std::chrono::milliseconds(10));
+        nr_blocked.fetch_sub(1);
+    }
+    std::vector<T> buf; // one slot is kept free to distinguish full from empty
+    std::atomic<size_t> head; // next slot to pop
+    std::atomic<size_t> tail; // next slot to push
+    std::atomic<bool> closed;
+    std::atomic<int> nr_blocked; // threads waiting on cond
+    std::mutex mutex;
+    std::condition_variable cond;
+};
+
+int parse_pipelined(std::vector<std::string> const &ifiles, Sort_Stats *stats=0); // 0 = success
+
+#endif
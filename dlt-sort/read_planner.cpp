@@ -0,0 +1,145 @@
+//
+//  read_planner.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include "read_planner.h"
+#include "mem_budget.h"
+
+using namespace std;
+
+typedef struct{
+    uint32_t file_idx;
+    int64_t offset;
+    size_t len;
+    size_t msg; // index within the window
+} Planned_Payload;
+
+static bool compare_file_offset(const Planned_Payload &a, const Planned_Payload &b)
+{
+    if (a.file_idx != b.file_idx) return a.file_idx < b.file_idx;
+    return a.offset < b.offset;
+}
+
+typedef struct{
+    uint32_t file_idx;
+    int64_t offset;
+    int64_t end;
+    size_t buf_pos;
+} Planned_Read;
+
+Payload_Planner::Payload_Planner(const VEC_OF_OUT_MSGS &o, size_t begin, size_t end) : order(o), order_begin(begin), order_end(end), queue(planner_windows_ahead), cur(0), stop(false), reads(0), bytes(0)
+{
+    thread = std::thread(&Payload_Planner::prefetch, this);
+}
+
+Payload_Planner::~Payload_Planner()
+{
+    stop.store(true); // the prefetcher might wait for a free slot
+    queue.wake();
+    thread.join();
+    Window *w;
+    while (queue.try_pop(w)) delete w;
+    delete cur;
+}
+
+const unsigned char *Payload_Planner::payload(size_t i)
+{
+    while (!cur || i >= cur->end){
+        delete cur;
+        cur = 0;
+        if (!queue.pop(cur)) return 0; // no more windows (can't happen for i<order_end)
+    }
+    assert(i >= cur->begin);
+    int64_t pos = cur->pos[i - cur->begin];
+    return pos<0 ? 0 : &cur->buf[(size_t)pos];
+}
+
+void Payload_Planner::prefetch()
+{
+    Trace_Span span("read_payloads", "task");
+    size_t begin = order_begin;
+    while (begin < order_end && !stop.load()){
+        Window *w = load_window(begin);
+        begin = w->end;
+        if (!queue.push(w, stop)) delete w; // stopped while waiting for a free slot
+    }
+    queue.close();
+}
+
+Payload_Planner::Window *Payload_Planner::load_window(size_t begin)
+{
+    Window *w = new Window;
+    w->begin = begin;
+    std::vector<Planned_Payload> payloads;
+    size_t payload_bytes = 0;
+    size_t i = begin;
+    for (; i<order_end && payload_bytes<planner_window_bytes && i-begin<planner_window_msgs; ++i){
+        const DltMessage *msg = order[i].msg;
+        if (!(msg->found_serialheader & DLT_SORT_MSG_PAYLOAD_REF) || msg->databuffersize<=0) continue;
+        Payload_Ref ref;
+        memcpy(&ref, msg->databuffer, sizeof(ref));
+        Planned_Payload p;
+        p.file_idx = ref.file_idx;
+        p.offset = ref.offset;
+        p.len = (size_t)msg->databuffersize;
+        p.msg = i - begin;
+        payloads.push_back(p);
+        payload_bytes += p.len;
+    }
+    w->end = i;
+    w->pos.assign(w->end - w->begin, -1);
+    if (!payloads.size()) return w;
+
+    // coalesce them into reads (in file order):
+    std::sort(payloads.begin(), payloads.end(), compare_file_offset);
+    std::vector<Planned_Read> planned;
+    std::vector<size_t> read_of_payload(payloads.size());
+    size_t gap_bytes = 0; // read but not needed. Limited to planner_window_bytes
+    size_t buf_size = 0;
+    for (size_t p=0; p<payloads.size(); ++p){
+        const Planned_Payload &pp = payloads[p];
+        int64_t pp_end = pp.offset + (int64_t)pp.len;
+        if (planned.size()){
+            Planned_Read &r = planned.back();
+            int64_t gap = std::max<int64_t>(pp.offset - r.end, 0);
+            if (r.file_idx == pp.file_idx && gap <= planner_max_gap && gap_bytes + (size_t)gap <= planner_window_bytes){
+                gap_bytes += (size_t)gap;
+                w->pos[pp.msg] = (int64_t)r.buf_pos + (pp.offset - r.offset);
+                if (pp_end > r.end){
+                    buf_size += (size_t)(pp_end - r.end);
+                    r.end = pp_end;
+                }
+                read_of_payload[p] = planned.size()-1;
+                continue;
+            }
+        }
+        Planned_Read r;
+        r.file_idx = pp.file_idx;
+        r.offset = pp.offset;
+        r.end = pp_end;
+        r.buf_pos = buf_size;
+        buf_size += pp.len;
+        w->pos[pp.msg] = (int64_t)r.buf_pos;
+        read_of_payload[p] = planned.size();
+        planned.push_back(r);
+    }
+
+    // and read them:
+    w->buf.resize(buf_size);
+    std::vector<bool> failed(planned.size(), false);
+    for (size_t r=0; r<planned.size(); ++r){
+        const Planned_Read &pr = planned[r];
+        size_t len = (size_t)(pr.end - pr.offset);
+        if (stop.load() || !read_payload_range(pr.file_idx, pr.offset, len, &w->buf[pr.buf_pos]))
+            failed[r] = true;
+        reads++;
+        bytes += (int64_t)len;
+    }
+    for (size_t p=0; p<payloads.size(); ++p)
+        if (failed[read_of_payload[p]]) w->pos[payloads[p].msg] = -1;
+    return w;
+}
@@ -0,0 +1,61 @@
+//
+//  read_planner.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_read_planner_h
+#define dlt_sort_read_planner_h
+
+#include <stddef.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "dlt-sort.h"
+#include "pipeline.h"
+
+/* reading the payloads kept in the input files (see mem_budget.h) at output:
+ The output order jumps between ECUs and files, so reading each payload on its
+ own seeks for each msg. The planner looks ahead over the output order in
+ windows, sorts the payload refs of a window by file and offset, coalesces
+ nearby ones into large sequential reads and reads them in a background
+ thread while the previous window is written. At most planner_windows_ahead
+ windows are buffered. */
+
+const size_t planner_window_bytes = 4<<20; // payload bytes per window
+const size_t planner_window_msgs = 1<<16; // max msgs per window
+const int64_t planner_max_gap = 256<<10; // read over gaps up to this size instead of seeking
+const size_t planner_windows_ahead = 2;
+
+class Payload_Planner{
+public:
+    Payload_Planner(const VEC_OF_OUT_MSGS &order, size_t begin, size_t end); // for the msgs order[begin..end)
+    ~Payload_Planner(); // stops the reads if not all payloads were used
+    const unsigned char *payload(size_t i); // of order[i] (a PAYLOAD_REF msg). i needs to increase. NULL if not readable
+    int64_t nr_reads() const { return reads.load(); }
+    int64_t bytes_read() const { return bytes.load(); }
+private:
+    Payload_Planner(const Payload_Planner&); // not copyable
+    Payload_Planner &operator=(const Payload_Planner&);
+    typedef struct{
+        size_t begin, end; // msgs of order
+        std::vector<unsigned char> buf; // the coalesced reads
+        std::vector<int64_t> pos; // of the payload of each msg in buf. -1 = none
+    } Window;
+    void prefetch(); // the background thread
+    Window *load_window(size_t begin); // plans and reads the window starting at order[begin]
+    // member vars:
+    const VEC_OF_OUT_MSGS &order;
+    size_t order_begin;
+    size_t order_end;
+    SPSC_Queue<Window *> queue;
+    Window *cur; // the window in use by payload()
+    std::atomic<bool> stop;
+    std::atomic<int64_t> reads;
+    std::atomic<int64_t> bytes;
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,177 @@
+//
+//  server.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <stdlib.h>
+#include <sstream>
+#ifndef WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+#include "server.h"
+
+using namespace std;
+
+const size_t max_request_len = 1<<16;
+const int client_timeout_secs = 5; // for reading the request and writing the reply
+
+Sort_Server::~Sort_Server()
+{
+    for (MAP_OF_CORPORA::iterator it=corpora.begin(); it!=corpora.end(); ++it)
+        delete it->second;
+}
+
+std::string Sort_Server::handle_request(std::string const &line)
+{
+    std::istringstream is(line);
+    std::vector<std::string> args;
+    std::string arg;
+    while (is >> arg) args.push_back(arg);
+    if (!args.size()) return "ERR empty request";
+    std::ostringstream reply;
+    
+    if (args[0]=="add"){
+        if (args.size()<3) return "ERR usage: add <name> <file> [<file>...]";
+        // an existing corpus keeps the files that are still in it and unchanged:
+        MAP_OF_CORPORA::iterator it = corpora.find(args[1]);
+        Sort_Context *ctx = it!=corpora.end() ? it->second : new Sort_Context;
+        if (ctx->analyse(std::vector<std::string>(args.begin()+2, args.end()), pool)){
+            if (it==corpora.end()) delete ctx;
+            return "ERR can't analyse the files of " + args[1];
+        }
+        if (it==corpora.end()) corpora[args[1]] = ctx;
+        reply << "OK " << ctx->nr_msgs() << " msgs in " << ctx->overall_lcs().size() << " overall lifecycles";
+    }else if (args[0]=="sort"){
+        if (args.size()<3) return "ERR usage: sort <name> <ofile> [ecus=ECU1,...] [from=usecs] [to=usecs] [split] [timeadjust]";
+        MAP_OF_CORPORA::iterator it = corpora.find(args[1]);
+        if (it==corpora.end()) return "ERR unknown corpus " + args[1];
+        Output_Selection sel;
+        init_Output_Selection(sel);
+        bool do_split=false, do_timeadjust=false;
+        for (size_t i=3; i<args.size(); ++i){
+            if (args[i]=="split") do_split = true;
+            else if (args[i]=="timeadjust") do_timeadjust = true;
+            else if (!args[i].compare(0, 5, "ecus=")){
+                if (!add_filter_ids(sel.ecus, args[i].c_str()+5)) return "ERR invalid " + args[i];
+            }else if (!args[i].compare(0, 5, "from="))
+                sel.usec_from = strtoll(args[i].c_str()+5, 0, 10);
+            else if (!args[i].compare(0, 3, "to="))
+                sel.usec_to = strtoll(args[i].c_str()+3, 0, 10);
+            else
+                return "ERR unknown argument " + args[i];
+        }
+        Sort_Context &ctx = *it->second;
+        int refreshed = ctx.refresh(pool);
+        if (refreshed<0){
+            delete it->second;
+            corpora.erase(it);
+            return "ERR can't analyse the files of " + args[1] + " again. Removed it";
+        }
+        int64_t nr_msgs = 0;
+        if (ctx.output(args[2], sel, do_split, do_timeadjust, pool, &nr_msgs)) return "ERR output to " + args[2] + " failed";
+        reply << "OK " << nr_msgs << " msgs" << (refreshed ? " (analysed again)" : "");
+    }else if (args[0]=="remove"){
+        if (args.size()!=2) return "ERR usage: remove <name>";
+        MAP_OF_CORPORA::iterator it = corpora.find(args[1]);
+        if (it==corpora.end()) return "ERR unknown corpus " + args[1];
+        delete it->second;
+        corpora.erase(it);
+        reply << "OK";
+    }else if (args[0]=="list"){
+        reply << "OK";
+        for (MAP_OF_CORPORA::iterator it=corpora.begin(); it!=corpora.end(); ++it)
+            reply << " " << it->first << "(" << it->second->files().size() << " files)";
+    }else if (args[0]=="shutdown"){
+        stop = true;
+        reply << "OK";
+    }else
+        return "ERR unknown request " + args[0];
+    return reply.str();
+}
+
+#ifdef WIN32
+int Sort_Server::run(std::string const &socket_path)
+{
+    cerr << "server mode is not supported on this platform!\n";
+    return -1;
+}
+#else
+int Sort_Server::run(std::string const &socket_path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.length() >= sizeof(addr.sun_path)){
+        cerr << "socket path <" << socket_path << "> too long!\n";
+        return -1;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path)-1);
+    // a socket from a previous run is replaced. Any other file is kept:
+    struct stat st;
+    if (lstat(socket_path.c_str(), &st)==0){
+        if (!S_ISSOCK(st.st_mode)){
+            cerr << "can't listen on <" << socket_path << ">! exists and is no socket.\n";
+            return -1;
+        }
+        unlink(socket_path.c_str());
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd<0){
+        cerr << "can't create socket!\n";
+        return -1;
+    }
+    signal(SIGPIPE, SIG_IGN); // a client might close the connection before reading the reply
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 8)){
+        cerr << "can't listen on <" << socket_path << ">!\n";
+        close(fd);
+        return -1;
+    }
+    if (verbose) cout << " listening on <" << socket_path << ">\n";
+    
+    stop = false;
+    while (!stop){
+        int cfd = accept(fd, 0, 0);
+        if (cfd<0) continue; // e.g. EINTR
+        // a client that doesn't send (or read) mustn't block the other ones:
+        struct timeval tv;
+        tv.tv_sec = client_timeout_secs;
+        tv.tv_usec = 0;
+        setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        std::string line;
+        char buf[4096];
+        bool complete = false;
+        while (!complete && line.length() < max_request_len){
+            ssize_t r = read(cfd, buf, sizeof(buf));
+            if (r<=0) break;
+            line.append(buf, (size_t)r);
+            complete = line.find('\n') != std::string::npos;
+        }
+        std::string reply;
+        if (complete){
+            line.erase(line.find('\n'));
+            if (verbose) cout << " request <" << line << ">\n";
+            reply = handle_request(line);
+        }else
+            reply = "ERR incomplete request";
+        reply += "\n";
+        for (size_t done=0; done<reply.length();){
+            ssize_t w = write(cfd, reply.c_str()+done, reply.length()-done);
+            if (w<=0) break;
+            done += (size_t)w;
+        }
+        close(cfd);
+    }
+    close(fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
+#endif
@@ -0,0 +1,48 @@
+//
+//  server.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_server_h
+#define dlt_sort_server_h
+
+#include <map>
+#include <string>
+#include "sort_context.h"
+#include "thread_pool.h"
+
+/* server mode (--server socket):
+ Keeps the analysed msgs of registered corpora (sets of input files) in
+ memory and answers requests on a local unix socket. Each connection sends
+ one request line and gets one reply line ("OK ..." or "ERR ...").
+ The requests are handled one after the other. A client not sending its
+ request within a few secs gets "ERR incomplete request". Requests:
+  add <name> <file> [<file>...]  analyse the files and keep them as corpus <name>
+                                 (an existing corpus parses the new and changed files only)
+  sort <name> <ofile> [ecus=ECU1,...] [from=usecs] [to=usecs] [split] [timeadjust]
+                                 output the sorted msgs (from/to in usecs since 1.1.1970 of
+                                 the lifecycle time). If a file changed it's parsed again before.
+  remove <name>
+  list
+  shutdown
+ File names can't contain spaces. */
+class Sort_Server{
+public:
+    Sort_Server(unsigned int nr_threads) : pool(nr_threads), stop(false) {}
+    ~Sort_Server();
+    std::string handle_request(std::string const &line); // returns the reply (without the newline)
+    int run(std::string const &socket_path); // until shutdown
+private:
+    Sort_Server(const Sort_Server&); // not copyable
+    Sort_Server &operator=(const Sort_Server&);
+    typedef std::map<std::string, Sort_Context *> MAP_OF_CORPORA;
+    // member vars:
+    ThreadPool pool;
+    MAP_OF_CORPORA corpora;
+    bool stop;
+};
+
+#endif
@@ -0,0 +1,376 @@
+//
+//  shard.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <iomanip>
+#include <sstream>
+#include "shard.h"
+#include "thread_pool.h"
+#include "msg_arena.h"
+#include "mem_budget.h"
+#include "payload_blocks.h"
+#include "nav_index.h"
+#include "htyp_codec.h"
+
+using namespace std;
+
+const char * const lcs_file_magic = "dlt-sort-lcs";
+const int lcs_file_version = 1;
+const size_t lc_read_buf_size = 1<<16; // per lifecycle of an overall lifecycle
+const size_t lc_write_buf_size = 1<<20;
+
+static std::string get_dir_name(std::string const &name)
+{
+    size_t pos = name.find_last_of("/\\");
+    return pos==std::string::npos ? std::string() : name.substr(0, pos+1);
+}
+
+static std::string get_base_name(std::string const &name)
+{
+    size_t pos = name.find_last_of("/\\");
+    return pos==std::string::npos ? name : name.substr(pos+1);
+}
+
+int map_dlt_files(std::vector<std::string> const &ifiles, std::string const &prefix, Sort_Stats *stats)
+{
+    if (stats) init_Sort_Stats(*stats);
+    Run_Clock run_clock(stats);
+    init_mem_budget();
+    ThreadPool pool((unsigned int)nr_jobs);
+    if (verbose) cout << " using " << pool.size() << " threads\n";
+    
+    if (analyse_ecus(ifiles, stats, pool)) return -1;
+    
+    // the lcs in the order determine_overall_lcs uses them:
+    std::vector<uint32_t> ecu_ids;
+    std::vector<Lifecycle *> lcs;
+    for (MAP_OF_ECUS::iterator it=map_ecus.begin(); it!=map_ecus.end(); ++it){
+        for (LIST_OF_LCS::iterator lit=it->second.lcs.begin(); lit!=it->second.lcs.end(); ++lit){
+            ecu_ids.push_back(it->first);
+            lcs.push_back(&(*lit));
+        }
+    }
+    std::string lc_templ = prefix + "_lc.dlt";
+    std::vector<int> errors(lcs.size(), 0);
+    {
+        Stage_Clock stage_clock(stats, STAGE_OUTPUT);
+        pool.parallel_for(lcs.size(), [&](size_t i){
+            Trace_Span span("output_lc", "task");
+            std::vector<char> buf(lc_write_buf_size);
+            std::ofstream *f = get_ofstream((int)i+1, lc_templ, &buf[0], buf.size());
+            if (!f){
+                errors[i] = 1;
+                return;
+            }
+            Payload_Block_Cache blocks;
+            for (LIST_OF_MSGS::iterator it=lcs[i]->msgs.begin(); it!=lcs[i]->msgs.end(); ++it)
+                output_message(*it, *f, ((*it)->found_serialheader & DLT_SORT_MSG_PAYLOAD_BLOCK) ? blocks.payload(**it) : 0);
+            f->close();
+            errors[i] = f->fail() ? 1 : 0;
+            delete f;
+        });
+        close_payload_files();
+    }
+    
+    std::string lcs_name = prefix + ".lcs";
+    std::ofstream f(lcs_name.c_str(), ios::out|ios::trunc);
+    if (!f.is_open()){
+        cerr << "can't open <" << lcs_name << "> for writing!\n";
+        map_ecus.clear();
+        msg_arena.release();
+        return -1;
+    }
+    int ret = 0;
+    f << lcs_file_magic << " " << lcs_file_version << "\n";
+    f << setprecision(17);
+    for (size_t i=0; i<lcs.size(); ++i){
+        const Lifecycle &lc = *lcs[i];
+        if (errors[i]){
+            cerr << "can't write <" << get_ofstream_name((int)i+1, lc_templ) << ">!\n";
+            ret = -1;
+        }
+        // the file name is relative to the .lcs file. So the maps can be moved together:
+        f << get_base_name(get_ofstream_name((int)i+1, lc_templ)) << " " << hex << ecu_ids[i] << dec;
+        f << " " << lc.usec_begin << " " << lc.usec_end << " " << lc.clock_skew << " " << lc.min_tmsp;
+        f << " " << lc.max_tmsp << " " << (lc.rel_offset_valid ? 1 : 0) << " " << lc.msgs.size() << "\n";
+        if (stats) stats->bytes_written += get_file_size(get_ofstream_name((int)i+1, lc_templ));
+    }
+    if (!f.good()) ret = -1;
+    f.close();
+    if (verbose) cout << "wrote " << lcs.size() << " lifecycles to <" << lcs_name << ">\n";
+    if (stats) stats->peak_rss_bytes = get_peak_rss();
+    
+    map_ecus.clear();
+    msg_arena.release();
+    return ret;
+}
+
+static int read_lcs_file(std::string const &name, MAP_OF_ECUS &ecus, std::vector<std::string> &lc_files, std::vector<int64_t> &lc_nr_msgs)
+{
+    std::ifstream f(name.c_str(), ios::in);
+    if (!f.is_open()){
+        cerr << "can't open <" << name << "> as file for input!\n";
+        return -1;
+    }
+    std::string magic;
+    int version = 0;
+    f >> magic >> version;
+    if (magic!=lcs_file_magic || version!=lcs_file_version){
+        cerr << "<" << name << "> is no lifecycle file of --map!\n";
+        return -1;
+    }
+    std::string line;
+    std::getline(f, line); // rest of the first line
+    while (std::getline(f, line)){
+        if (!line.length()) continue;
+        std::istringstream is(line);
+        std::string file;
+        uint32_t ecu_id;
+        Lifecycle lc;
+        int rel_offset_valid;
+        size_t nr_msgs;
+        is >> file >> hex >> ecu_id >> dec >> lc.usec_begin >> lc.usec_end >> lc.clock_skew;
+        is >> lc.min_tmsp >> lc.max_tmsp >> rel_offset_valid >> nr_msgs;
+        if (is.fail()){
+            cerr << "invalid line <" << line << "> in <" << name << ">!\n";
+            return -1;
+        }
+        if (!nr_msgs) continue;
+        lc.rel_offset_valid = rel_offset_valid!=0;
+        lc.shard_lc = (int)lc_files.size();
+        lc_files.push_back(get_dir_name(name) + file);
+        lc_nr_msgs.push_back((int64_t)nr_msgs);
+        ecus[ecu_id].lcs.push_back(lc);
+    }
+    return 0;
+}
+
+/* reads the msgs of an intermediate lifecycle file one after the other. */
+class Lc_Reader{
+public:
+    Lc_Reader(std::string const &name_, const Lifecycle &lc, int64_t nr_msgs_) : min_time(0), error(false), buf(lc_read_buf_size), name(name_), usec_begin(lc.usec_begin), clock_skew(lc.clock_skew), nr_msgs(nr_msgs_), nr_read(0) {
+        f.rdbuf()->pubsetbuf(&buf[0], buf.size());
+        f.open(name.c_str(), ios::in|ios::binary);
+        if (!f.is_open()){
+            cerr << "can't open <" << name << "> as file for input!\n";
+            error = true;
+        }
+    }
+    bool next(); // reads the next msg. false at the end of the file or on error
+    std::vector<char> msg; // the current one (from the storage header to the end of the payload)
+    int64_t min_time; // of the current msg (as LC_it::min_time)
+    char ecu[4]; // of the current msg (for the nav index)
+    char apid[4]; // of the current msg. 0 if it has no extended header
+    bool error; // can't be opened, truncated or not the nr of msgs of the .lcs file
+private:
+    Lc_Reader(const Lc_Reader&); // not copyable
+    Lc_Reader &operator=(const Lc_Reader&);
+    bool fail(const char *what);
+    std::vector<char> buf;
+    std::string name;
+    std::ifstream f;
+    int64_t usec_begin;
+    double clock_skew;
+    int64_t nr_msgs; // as in the .lcs file
+    int64_t nr_read;
+};
+
+bool Lc_Reader::fail(const char *what)
+{
+    cerr << "<" << name << "> " << what << "!\n";
+    error = true;
+    return false;
+}
+
+bool Lc_Reader::next()
+{
+    const size_t hdr_size = sizeof(DltStorageHeader) + sizeof(DltStandardHeader);
+    if (error) return false;
+    msg.resize(hdr_size);
+    if (!f.read(&msg[0], hdr_size)){
+        if (f.gcount() || !f.eof()) return fail("is truncated");
+        if (nr_read != nr_msgs) return fail("doesn't have the nr of msgs of the .lcs file");
+        return false; // the end
+    }
+    DltStandardHeader std_hdr;
+    memcpy(&std_hdr, &msg[sizeof(DltStorageHeader)], sizeof(std_hdr));
+    size_t len = DLT_BETOH_16(std_hdr.len);
+    const Htyp_Codec &codec = get_htyp_codec(std_hdr.htyp);
+    if (len < sizeof(DltStandardHeader) + codec.size) return fail("has a corrupt msg");
+    msg.resize(sizeof(DltStorageHeader) + len);
+    if (!f.read(&msg[hdr_size], msg.size()-hdr_size)) return fail("is truncated");
+    ++nr_read;
+    DltMessage m;
+    DltExtendedHeader ext;
+    m.extendedheader = &ext; // for the tmsp and the apid
+    codec.decode(&msg[hdr_size], m);
+    min_time = usec_begin + multiply(((int64_t)m.headerextra.tmsp) * usecs_per_tmsp, clock_skew);
+    if (DLT_IS_HTYP_WEID(std_hdr.htyp))
+        memcpy(ecu, m.headerextra.ecu, sizeof(ecu));
+    else
+        memcpy(ecu, ((const DltStorageHeader *)&msg[0])->ecu, sizeof(ecu));
+    if (DLT_IS_HTYP_UEH(std_hdr.htyp))
+        memcpy(apid, ext.apid, sizeof(apid));
+    else
+        memset(apid, 0, sizeof(apid));
+    return true;
+}
+
+static void write_msg(const Lc_Reader &r, bool timeadjust, std::ostream &f, Nav_Index_Writer *index)
+{
+    if (index) index->add(r.min_time, r.ecu, r.apid, r.msg.size());
+    if (timeadjust){
+        // as OverallLC::output_to_fstream (i.e. the lifecycle time):
+        DltStorageHeader sh;
+        memcpy(&sh, &r.msg[0], sizeof(sh));
+        sh.seconds = (uint32_t)(r.min_time / usecs_per_sec);
+        sh.microseconds = r.min_time % usecs_per_sec;
+        f.write((const char *)&sh, sizeof(sh));
+        f.write(&r.msg[sizeof(sh)], r.msg.size()-sizeof(sh));
+    }else
+        f.write(&r.msg[0], r.msg.size());
+}
+
+static int64_t merge_olc(const OverallLC &olc, std::vector<std::string> const &lc_files, std::vector<int64_t> const &lc_nr_msgs, bool timeadjust, std::ostream &f, Nav_Index_Writer *nav_index)
+{
+    /* the same order as OverallLC::determine_output_order but reading the
+     msgs of each lc from its file while merging. Returns the nr of msgs or
+     -1 if a lifecycle file is missing, truncated or doesn't match the .lcs file. */
+    std::vector<Lc_Reader *> readers, vec;
+    int64_t expected = 0;
+    for (LIST_OF_LCS::const_iterator it=olc.lcs.begin(); it!=olc.lcs.end(); ++it){
+        Lc_Reader *r = new Lc_Reader(lc_files[(*it).shard_lc], *it, lc_nr_msgs[(*it).shard_lc]);
+        expected += lc_nr_msgs[(*it).shard_lc];
+        readers.push_back(r);
+        if (r->next()) vec.push_back(r);
+    }
+    int64_t nr_msgs = 0;
+    Lc_Reader *index = 0; // the one with the min. time
+    Lc_Reader *next_index = 0; // the one with the min. time not from index
+    int64_t next_time = 0;
+    while (vec.size()>1){
+        while (!next_index){
+            for (size_t i=0; i<vec.size(); ++i){
+                if (index!=vec[i] && (!next_index || vec[i]->min_time < next_time)){
+                    next_time = vec[i]->min_time;
+                    next_index = vec[i];
+                }
+            }
+            if (!index){
+                index = next_index;
+                next_index = 0;
+            }
+        }
+        // output msgs from index until time > next time:
+        do{
+            write_msg(*index, timeadjust, f, nav_index);
+            ++nr_msgs;
+            if (!index->next()){
+                for (size_t i=0; i<vec.size(); ++i){
+                    if (vec[i]==index){
+                        vec.erase(vec.begin()+i);
+                        break;
+                    }
+                }
+                index = 0;
+                next_index = 0;
+            }
+        }while (index && index->min_time<=next_time);
+        index = next_index;
+        next_index = 0;
+    }
+    if (vec.size()){ // just one remaining:
+        do{
+            write_msg(*vec[0], timeadjust, f, nav_index);
+            ++nr_msgs;
+        }while (vec[0]->next());
+    }
+    bool error = nr_msgs != expected;
+    for (size_t i=0; i<readers.size(); ++i){
+        if (readers[i]->error) error = true;
+        delete readers[i];
+    }
+    return error ? -1 : nr_msgs;
+}
+
+int reduce_dlt_files(std::vector<std::string> const &lcs_files, std::string const &ofilename, bool do_split, bool do_timeadjust, Sort_Stats *stats)
+{
+    if (stats) init_Sort_Stats(*stats);
+    Run_Clock run_clock(stats);
+    ThreadPool pool((unsigned int)nr_jobs);
+    
+    MAP_OF_ECUS ecus; // with the lcs only
+    std::vector<std::string> lc_files;
+    std::vector<int64_t> lc_nr_msgs; // of each lc file as in the .lcs file
+    {
+        Stage_Clock stage_clock(stats, STAGE_PARSE, "lcs files");
+        for (size_t i=0; i<lcs_files.size(); ++i){
+            if (verbose) cout << "Reading lifecycles from " << lcs_files[i] << "\n";
+            if (read_lcs_file(lcs_files[i], ecus, lc_files, lc_nr_msgs)) return -1;
+        }
+    }
+    LIST_OF_OLCS olcs;
+    {
+        Stage_Clock stage_clock(stats, STAGE_OVERALL_LCS);
+        determine_overall_lcs(ecus, olcs);
+    }
+    if (verbose>0){
+        cout << "Overall lifecycles detected (" << olcs.size() << ")\n";
+        debug_print(olcs);
+    }
+    
+    std::vector<const OverallLC *> vec;
+    for (LIST_OF_OLCS::const_iterator it=olcs.begin(); it!=olcs.end(); ++it)
+        vec.push_back(&(*it));
+    std::vector<int64_t> nr_msgs(vec.size(), 0);
+    {
+        Stage_Clock stage_clock(stats, STAGE_OUTPUT);
+        if (do_split){
+            // as output_split each olc into its own file:
+            pool.parallel_for(vec.size(), [&](size_t i){
+                Trace_Span span("output_olc", "task");
+                std::vector<char> buf(lc_write_buf_size);
+                std::ofstream *f = get_ofstream((int)i+1, ofilename, &buf[0], buf.size());
+                if (!f){
+                    nr_msgs[i] = -1;
+                    return;
+                }
+                Nav_Index_Writer *index = use_nav_index ? new Nav_Index_Writer(get_ofstream_name((int)i+1, ofilename)) : 0;
+                nr_msgs[i] = merge_olc(*vec[i], lc_files, lc_nr_msgs, do_timeadjust, *f, index);
+                f->close();
+                if (f->fail() || (index && index->close())) nr_msgs[i] = -1;
+                delete f;
+                delete index;
+            });
+        }else{
+            std::vector<char> buf(lc_write_buf_size);
+            std::ofstream *f = get_ofstream(0, ofilename, &buf[0], buf.size());
+            if (!f) return -1;
+            Nav_Index_Writer *index = use_nav_index ? new Nav_Index_Writer(ofilename) : 0;
+            for (size_t i=0; i<vec.size(); ++i)
+                nr_msgs[i] = merge_olc(*vec[i], lc_files, lc_nr_msgs, do_timeadjust, *f, index);
+            f->close();
+            if (f->fail() || (index && index->close())) nr_msgs[0] = -1;
+            delete f;
+            delete index;
+        }
+    }
+    for (size_t i=0; i<nr_msgs.size(); ++i)
+        if (nr_msgs[i]<0) return -1;
+    if (stats){
+        stats->nr_olcs = olcs.size();
+        for (size_t i=0; i<nr_msgs.size(); ++i) stats->nr_msgs += nr_msgs[i];
+        for (size_t i=0; i<lc_files.size(); ++i) stats->bytes_read += get_file_size(lc_files[i]);
+        if (do_split){
+            for (size_t i=0; i<vec.size(); ++i)
+                stats->bytes_written += get_file_size(get_ofstream_name((int)i+1, ofilename));
+        }else
+            stats->bytes_written = get_file_size(ofilename);
+        stats->peak_rss_bytes = get_peak_rss();
+    }
+    return 0;
+}
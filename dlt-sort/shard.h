@@ -0,0 +1,28 @@
+//
+//  shard.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_shard_h
+#define dlt_sort_shard_h
+
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+
+/* sorting with multiple processes (or hosts sharing a file system):
+ map: parses a subset of the input files, runs the per ECU stages (lifecycles,
+ clock skew, merge, sort) and writes the sorted msgs of each lifecycle to
+ <prefix>_lcNNN.dlt and the lifecycles to <prefix>.lcs.
+ reduce: reads the .lcs files of all maps, determines the overall lifecycles
+ from them (no msgs needed) and streams a k-way merge of the lifecycle files
+ into the output. With one map over all files the output is the same as the
+ one of sort_dlt_files. */
+
+int map_dlt_files(std::vector<std::string> const &ifiles, std::string const &prefix, Sort_Stats *stats=0);
+int reduce_dlt_files(std::vector<std::string> const &lcs_files, std::string const &ofilename, bool do_split, bool do_timeadjust, Sort_Stats *stats=0);
+
+#endif
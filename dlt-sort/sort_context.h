@@ -0,0 +1,69 @@
+//
+//  sort_context.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_sort_context_h
+#define dlt_sort_sort_context_h
+
+#include <string>
+#include <vector>
+#include "dlt-sort.h"
+#include "msg_arena.h"
+
+typedef struct{
+    int64_t size;
+    int64_t mtime; // secs since 1.1.1970
+} File_Stamp;
+int get_file_stamp(std::string const &name, File_Stamp &stamp); // 0 on success
+
+/* the msgs to output from a Sort_Context. */
+typedef struct{
+    SET_OF_IDS ecus; // if not empty only these ECUs
+    int64_t usec_from; // lifecycle time (as used with -t) of the first msg. 0 = no limit
+    int64_t usec_to; // msgs before this time only. 0 = no limit
+} Output_Selection;
+void init_Output_Selection(Output_Selection &);
+
+/* the msgs of one input file of a Sort_Context as parsed. */
+typedef struct{
+    std::string name;
+    File_Stamp stamp; // at the parsing
+    MAP_OF_ECUS ecus; // the msgs of each ECU in the order of the file (no lcs)
+    MsgArena arena; // all msgs of this file
+} Context_File;
+
+/* the overall lifecycles (and their msgs) of a set of input files.
+ Unlike sort_dlt_files the result of the analysis is kept so that it can be
+ output multiple times without parsing the files again (see server.h).
+ The msgs of each file are kept as parsed. Analysing again (e.g. refresh)
+ parses the new and changed files only and detects the lifecycles again only
+ for the ECUs with msgs in the files added, changed or removed. */
+class Sort_Context{
+public:
+    Sort_Context() : nr_parsed(0) {}
+    ~Sort_Context() { clear(); }
+    int analyse(std::vector<std::string> const &ifiles, ThreadPool &pool); // replaces the current files. On errors the current content is kept
+    bool is_stale() const; // a file changed since the analysis
+    int refresh(ThreadPool &pool); // analyses the changed files again if stale. Returns 1 if done, 0 if not needed, <0 on error
+    int output(std::string const &ofilename, const Output_Selection &sel, bool do_split, bool do_timeadjust, ThreadPool &pool, int64_t *nr_msgs=0);
+    void clear();
+    std::vector<std::string> const &files() const { return ifiles; }
+    LIST_OF_OLCS const &overall_lcs() const { return olcs; }
+    int64_t nr_msgs() const;
+    size_t nr_files_parsed() const { return nr_parsed; } // by the last analyse/refresh
+private:
+    Sort_Context(const Sort_Context&); // not copyable
+    Sort_Context &operator=(const Sort_Context&);
+    // member vars:
+    std::vector<std::string> ifiles;
+    std::vector<Context_File *> parsed; // of ifiles
+    MAP_OF_ECUS ecus; // the lcs of each ECU
+    LIST_OF_OLCS olcs; // of ecus
+    size_t nr_parsed;
+};
+
+#endif
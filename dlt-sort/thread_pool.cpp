@@ -0,0 +1,154 @@
+//
+//  thread_pool.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include "thread_pool.h"
+
+// the pool and queue of the current thread (if it's a worker):
+static thread_local const ThreadPool *cur_pool = 0;
+static thread_local unsigned int cur_idx = 0;
+
+unsigned int get_nr_threads(int requested)
+{
+    if (requested>0) return (unsigned int)requested;
+    unsigned int hw = std::thread::hardware_concurrency();
+    return hw ? hw : 1; // hardware_concurrency might return 0 if unknown
+}
+
+void Task_Group::run(const std::function<void()> &f)
+{
+    if (pool.size()==1){
+        f();
+        return;
+    }
+    pending++;
+    pool.submit(*this, f);
+}
+
+void Task_Group::wait()
+{
+    if (pending.load()) pool.wait(*this);
+}
+
+ThreadPool::ThreadPool(unsigned int nr) : nr_threads(get_nr_threads((int)nr)), nr_queued(0), stop(false)
+{
+    for (unsigned int i=0; i<nr_threads; ++i)
+        queues.push_back(new Task_Queue);
+    // the calling thread helps (with queue 0) so we need one thread less:
+    for (unsigned int i=1; i<nr_threads; ++i)
+        threads.push_back(std::thread(&ThreadPool::worker, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stop = true;
+    }
+    cond.notify_all();
+    for (size_t i=0; i<threads.size(); ++i)
+        threads[i].join();
+    for (size_t i=0; i<queues.size(); ++i)
+        delete queues[i];
+}
+
+unsigned int ThreadPool::queue_index() const
+{
+    return cur_pool==this ? cur_idx : 0;
+}
+
+void ThreadPool::submit(Task_Group &group, const std::function<void()> &f)
+{
+    Task t;
+    t.f = f;
+    t.group = &group;
+    Task_Queue &q = *queues[queue_index()];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(t);
+    }
+    nr_queued++;
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex); // avoids a lost wakeup
+    }
+    cond.notify_all();
+}
+
+bool ThreadPool::run_one(unsigned int idx)
+{
+    if (!nr_queued.load()) return false;
+    Task t;
+    bool found = false;
+    // the newest from our own queue. It's likely related to the task we just did:
+    {
+        Task_Queue &q = *queues[idx];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.size()){
+            t = q.tasks.back();
+            q.tasks.pop_back();
+            found = true;
+        }
+    }
+    // otherwise steal the oldest from the others. It's likely the biggest one:
+    for (unsigned int i=1; !found && i<nr_threads; ++i){
+        Task_Queue &q = *queues[(idx+i)%nr_threads];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.size()){
+            t = q.tasks.front();
+            q.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+    nr_queued--;
+
+    t.f();
+
+    if (--t.group->pending == 0){
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        cond.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::wait(Task_Group &group)
+{
+    unsigned int idx = queue_index();
+    while (group.pending.load()){
+        if (run_one(idx)) continue;
+        // the remaining tasks of the group are running on other threads:
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        while (group.pending.load() && !nr_queued.load())
+            cond.wait(lock);
+    }
+}
+
+void ThreadPool::worker(unsigned int idx)
+{
+    cur_pool = this;
+    cur_idx = idx;
+    for(;;){
+        if (run_one(idx)) continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        while (!stop && !nr_queued.load())
+            cond.wait(lock);
+        if (stop) return;
+    }
+}
+
+void ThreadPool::parallel_for(size_t n, const std::function<void(size_t)> &f)
+{
+    if (n==0) return;
+    if (threads.size()==0 || n==1){
+        for (size_t i=0; i<n; ++i) f(i);
+        return;
+    }
+    Task_Group group(*this);
+    for (size_t i=0; i<n; ++i)
+        group.run([&f, i](){ f(i); });
+    group.wait();
+}
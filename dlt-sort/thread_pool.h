@@ -0,0 +1,81 @@
+//
+//  thread_pool.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_thread_pool_h
+#define dlt_sort_thread_pool_h
+
+#include <stddef.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+class ThreadPool;
+
+/* a set of tasks that can be waited for. Tasks can run further tasks
+ (e.g. an ECU task runs a sort task per lifecycle). */
+class Task_Group{
+public:
+    Task_Group(ThreadPool &p) : pool(p), pending(0) {}
+    ~Task_Group() { wait(); }
+    void run(const std::function<void()> &f); // runs f on any thread of the pool (inline if the pool has just one)
+    void wait(); // helps with any tasks of the pool until all tasks of this group are done
+private:
+    Task_Group(const Task_Group&); // not copyable
+    Task_Group &operator=(const Task_Group&);
+    friend class ThreadPool;
+    ThreadPool &pool;
+    std::atomic<size_t> pending;
+};
+
+/* work-stealing pool of worker threads.
+ The workers are kept alive for the whole run. Each thread has its own
+ queue of tasks. New tasks are added to the queue of the thread that runs
+ them. A thread takes the newest task from its own queue and if that's
+ empty it steals the oldest task from another one. So a thread that is
+ busy with a big task gets its small ones taken by the idle threads.
+ Threads outside the pool share the first queue. */
+class ThreadPool{
+public:
+    ThreadPool(unsigned int nr_threads); // 0 = number of hw threads
+    ~ThreadPool();
+    void parallel_for(size_t n, const std::function<void(size_t)> &f); // returns once f(0)..f(n-1) are done
+    unsigned int size() const { return nr_threads; } // incl. the calling thread
+private:
+    ThreadPool(const ThreadPool&); // not copyable
+    ThreadPool &operator=(const ThreadPool&);
+    friend class Task_Group;
+    typedef struct{
+        std::function<void()> f;
+        Task_Group *group;
+    } Task;
+    typedef struct{
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    } Task_Queue;
+    void submit(Task_Group &group, const std::function<void()> &f);
+    bool run_one(unsigned int idx); // runs one task (own or stolen). false if none available
+    void wait(Task_Group &group);
+    void worker(unsigned int idx);
+    unsigned int queue_index() const; // of the calling thread
+    // member vars:
+    unsigned int nr_threads;
+    std::vector<std::thread> threads;
+    std::vector<Task_Queue *> queues; // one per thread
+    std::atomic<size_t> nr_queued; // tasks in all queues
+    std::mutex sleep_mutex;
+    std::condition_variable cond; // new tasks or a group done
+    bool stop;
+};
+
+unsigned int get_nr_threads(int requested); // maps 0 (=auto) to the hw threads
+
+#endif
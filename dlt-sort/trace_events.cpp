@@ -0,0 +1,117 @@
+//
+//  trace_events.cpp
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "trace_events.h"
+
+int use_trace_events = 0; // by default disabled. see --trace_events
+
+#ifndef DLT_SORT_NO_TRACE_EVENTS
+
+typedef struct{
+    const char *name;
+    const char *cat;
+    std::string arg;
+    int64_t begin;
+    int64_t end;
+    unsigned int tid;
+} Trace_Event;
+
+static std::mutex trace_mutex;
+static std::vector<Trace_Event> trace_events;
+static std::map<std::thread::id, unsigned int> trace_tids; // small ids in order of the first event per thread
+static const std::chrono::steady_clock::time_point trace_start = std::chrono::steady_clock::now();
+
+static unsigned int trace_tid()
+{
+    // trace_mutex needs to be locked (or called during the static init)
+    std::map<std::thread::id, unsigned int>::iterator it = trace_tids.find(std::this_thread::get_id());
+    if (it == trace_tids.end())
+        it = trace_tids.insert(std::make_pair(std::this_thread::get_id(), (unsigned int)trace_tids.size()+1)).first;
+    return it->second;
+}
+static const unsigned int trace_main_tid = trace_tid(); // the main thread gets id 1
+
+int64_t trace_now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - trace_start).count();
+}
+
+void trace_add(const char *name, const char *cat, const char *arg, int64_t begin, int64_t end)
+{
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    Trace_Event e;
+    e.name = name;
+    e.cat = cat;
+    if (arg) e.arg = arg;
+    e.begin = begin;
+    e.end = end;
+    e.tid = trace_tid();
+    trace_events.push_back(e);
+}
+
+static void write_json_string(std::ofstream &f, const char *s)
+{
+    f << '"';
+    for (; *s; ++s){
+        unsigned char c = (unsigned char)*s;
+        if (c=='"' || c=='\\') f << '\\' << (char)c;
+        else if (c<0x20) f << ' ';
+        else f << (char)c;
+    }
+    f << '"';
+}
+
+#endif
+
+int write_trace_events(std::string const &name)
+{
+#ifdef DLT_SORT_NO_TRACE_EVENTS
+    std::cerr << "trace events are not supported by this build!\n";
+    (void)name;
+    return -1;
+#else
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    std::ofstream f(name.c_str(), std::ios::out|std::ios::trunc);
+    if (!f.is_open()){
+        std::cerr << "can't open <" << name << "> for writing!\n";
+        return -1;
+    }
+    f << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    f << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 1, \"args\": {\"name\": \"dlt-sort\"}}";
+    for (std::map<std::thread::id, unsigned int>::const_iterator it=trace_tids.begin(); it!=trace_tids.end(); ++it){
+        f << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << it->second << ", \"args\": {\"name\": \"";
+        if (it->second==trace_main_tid) f << "main"; else f << "thread " << it->second;
+        f << "\"}}";
+    }
+    for (size_t i=0; i<trace_events.size(); ++i){
+        const Trace_Event &e = trace_events[i];
+        f << ",\n{\"name\": ";
+        write_json_string(f, e.name);
+        f << ", \"cat\": ";
+        write_json_string(f, e.cat);
+        f << ", \"ph\": \"X\", \"ts\": " << e.begin << ", \"dur\": " << (e.end - e.begin) << ", \"pid\": 1, \"tid\": " << e.tid;
+        if (e.arg.length()){
+            f << ", \"args\": {\"detail\": ";
+            write_json_string(f, e.arg.c_str());
+            f << "}";
+        }
+        f << "}";
+    }
+    f << "\n]}\n";
+    f.close();
+    trace_events.clear();
+    return f.fail() ? -1 : 0;
+#endif
+}
@@ -0,0 +1,54 @@
+//
+//  trace_events.h
+//  dlt-sort
+//
+//  Created by Matthias Behr on 18.10.26.
+//  Copyright (c) 2026 Matthias Behr. All rights reserved.
+//
+
+#ifndef dlt_sort_trace_events_h
+#define dlt_sort_trace_events_h
+
+#include <stdint.h>
+#include <string>
+
+/* timeline of our own execution in the chrome trace event format
+ (opens in chrome://tracing and perfetto).
+ A Trace_Span records a complete event ("ph":"X") from its construction to
+ its destruction on the current thread. If use_trace_events is not set a span
+ costs just one branch. Defining DLT_SORT_NO_TRACE_EVENTS removes the
+ instrumentation completely. */
+
+extern int use_trace_events;
+
+#ifndef DLT_SORT_NO_TRACE_EVENTS
+
+int64_t trace_now(); // usecs since start
+void trace_add(const char *name, const char *cat, const char *arg, int64_t begin, int64_t end);
+
+class Trace_Span{
+public:
+    // name, cat and arg are not copied and need to be valid until the span ends. arg can be NULL.
+    Trace_Span(const char *n, const char *c, const char *a = 0) : name(n), cat(c), arg(a), begin(use_trace_events ? trace_now() : -1) {}
+    ~Trace_Span() { if (begin>=0) trace_add(name, cat, arg, begin, trace_now()); }
+private:
+    Trace_Span(const Trace_Span&); // not copyable
+    Trace_Span &operator=(const Trace_Span&);
+    const char *name;
+    const char *cat;
+    const char *arg;
+    int64_t begin; // <0 if not recorded
+};
+
+#else
+
+class Trace_Span{
+public:
+    Trace_Span(const char *, const char *, const char * = 0) {}
+};
+
+#endif
+
+int write_trace_events(std::string const &name); // 0 = success. Clears the recorded events.
+
+#endif